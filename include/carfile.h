@@ -0,0 +1,106 @@
+// carfile.h - read-only, zero-copy view of a Chasm .CAR model
+//
+// car_open() maps the file and validates every offset once; the CARFile
+// then hands out typed pointers straight into the mapping.  Nothing is
+// copied, so a view is only valid until car_close().
+//
+// Layout:
+//   0x0000  CARHeader      (animation/sound byte lengths)
+//   0x0066  CARPolygon[]   (up to 576 entries)
+//   0x4866  uint16 vertex count, polygon count, texel count
+//   0x486C  texture        (64 x N palette indices)
+//           frames         (vertex count x CARVertex per frame)
+//           sounds         (7 slots of 8-bit PCM, at the end of the file)
+
+#ifndef CARFILE_H
+#define CARFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAR_POLYGON_OFFSET   0x66
+#define CAR_COUNTS_OFFSET    0x4866
+#define CAR_TEXTURE_OFFSET   0x486C
+#define CAR_MAX_POLYGONS     ((CAR_COUNTS_OFFSET - CAR_POLYGON_OFFSET) / 32)
+#define CAR_TEX_WIDTH        64
+#define CAR_ANIMS            20
+#define CAR_SOUNDS           7
+
+#pragma pack(push,1)
+typedef struct {
+    uint16_t animations[CAR_ANIMS];
+    uint16_t submodels_animations[3][2];
+    uint16_t unknown0[9];
+    uint16_t sounds[CAR_SOUNDS];
+    uint16_t unknown1[9];
+} CARHeader;
+
+typedef struct {
+    uint16_t vertices_indices[4];
+    uint16_t uv[4][2];
+    uint8_t unknown0[4];
+    uint8_t group_id, flags;
+    uint16_t v_offset;
+} CARPolygon;
+
+typedef struct { int16_t xyz[3]; } CARVertex;
+#pragma pack(pop)
+
+typedef struct { size_t start, count; } CARSpan;   // in frames
+
+typedef struct {
+    const uint8_t    *data;           // whole mapped file
+    size_t            size;
+
+    const CARHeader  *header;
+    const CARPolygon *polygons;
+    size_t            polygon_count;
+    size_t            vertex_count;
+
+    const uint8_t    *texture;        // tex_width x tex_height indices
+    size_t            texture_size;
+    int               tex_width, tex_height;
+
+    const CARVertex  *frames;         // frame_count x vertex_count
+    size_t            frame_count;
+    CARSpan           anims[CAR_ANIMS];
+
+    const uint8_t    *sounds[CAR_SOUNDS];
+    size_t            sound_len[CAR_SOUNDS];
+    size_t            sound_offset;   // file offset of slot 0
+
+    const char       *error;          // set when car_open()/car_view() fail
+
+    void             *map;            // platform mapping state
+    uint8_t          *copy;           // heap copy replacing the mapping, if any
+} CARFile;
+
+// byte range to substitute when writing a modified copy
+typedef struct {
+    size_t         offset;
+    const uint8_t *data;
+    size_t         len;
+} CARPatch;
+
+// map and validate; returns 1 on success, 0 with car->error set
+int  car_open(CARFile *car, const char *path);
+// validate a caller-owned buffer instead of a file (no mapping)
+int  car_view(CARFile *car, const uint8_t *data, size_t size);
+void car_close(CARFile *car);
+
+// writes the model to path with the patches applied (any order, must not
+// overlap) through <path>.tmp, so path may be the file car was opened
+// from; returns 1 on success, 0 with car->error set.  On Windows that
+// case moves car onto a heap copy, so earlier pointers into it go stale.
+int  car_write_patched(CARFile *car, const char *path,
+                       const CARPatch *patches, int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CARFILE_H
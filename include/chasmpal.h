@@ -0,0 +1,30 @@
+// chasmpal.h - the Chasm palette, compiled in
+//
+// The tools used to fopen chasmpalette.act from the working directory on
+// every run and gave up without it.  The palette never changes, so it now
+// lives in the binary together with the alpha table for the #040404 key
+// colour that the viewers and exporters derive from it.
+// palio_load(NULL, ...) hands it out as a Palette; "-palette <file>" still
+// replaces it (see palio.h).
+//
+// Nearest-colour lookups stay with palquant: its candidate lists for this
+// palette come to ~160 KB, more than is worth carrying in every binary,
+// and they are built lazily per cell anyway.
+
+#ifndef CHASMPAL_H
+#define CHASMPAL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern const uint8_t chasmpal_rgb[256][3];     // 8-bit, as chasmpalette.act
+extern const uint8_t chasmpal_alpha[256];      // 0 at entry 0, the only #040404
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CHASMPAL_H
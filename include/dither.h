@@ -0,0 +1,78 @@
+// dither.h - palette dithering shared by the PNG -> indexed tools
+//
+// Every mode maps an RGBA image onto a PalQuant palette and comes in two
+// shapes that give identical output:
+//
+//   dither_begin() / dither_row() / dither_end() stream one row at a time
+//   and only keep O(width) state, for tools that convert as they read.
+//
+//   dither_image() converts a whole image in place on the workpool.
+//
+// Error diffusion keeps its error in integer fractions of a level (1/16,
+// 1/8 or 1/4 depending on the kernel), so the sum a pixel receives does
+// not depend on the order its neighbours finished in.  dither_image()
+// uses that to run rows in parallel as a wavefront: each row trails the
+// ones above it by one DITHER_TILE-wide step, and the output matches a
+// single raster scan exactly.  Ordered and noise modes depend only on the
+// pixel position, so their rows are simply independent.
+
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <stdint.h>
+#include "palquant.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DITHER_TILE 64
+
+typedef enum {
+    DITHER_NONE = 0,
+    DITHER_FS,              // Floyd-Steinberg
+    DITHER_SL,              // Sierra Lite
+    DITHER_BAYER4,
+    DITHER_BAYER8,
+    DITHER_NOISE,
+    DITHER_ATKINSON,
+    DITHER_COUNT
+} DitherMode;
+
+typedef struct {
+    PalQuant   *q;
+    DitherMode  mode;
+    int         W;
+    int         alpha_cut;  // alpha below this: index `clear`, pixel left as
+    uint8_t     clear;      //   is and skipped by diffusion (0 = all opaque)
+    uint32_t    seed;       // DITHER_NOISE pattern
+
+    // private
+    int         y, ring, reach;
+    const void *kernel;
+    int32_t   (*acc)[3];    // ring x W pending error
+} DitherStream;
+
+// short option name ("none", "fs", "sierra", "bayer4", "bayer8", "noise",
+// "atkinson") and back; dither_parse() returns -1 for an unknown name
+const char *dither_name(DitherMode mode);
+int         dither_parse(const char *name);
+
+// returns 1 on success, 0 on allocation failure or a bad mode/width.
+// alpha_cut, clear and seed may be changed before the first row.
+int  dither_begin(DitherStream *ds, PalQuant *q, DitherMode mode, int W);
+// converts the next row: the chosen colour is written back into rgba and
+// its index into idx (may be NULL)
+void dither_row(DitherStream *ds, uint8_t *rgba, uint8_t *idx);
+void dither_end(DitherStream *ds);
+
+// whole opaque image, same output as streaming it row by row.
+// threads: 0 = one per CPU.  Returns 1 on success, 0 on allocation failure.
+int  dither_image(PalQuant *q, DitherMode mode, uint8_t *rgba, uint8_t *idx,
+                  int W, int H, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DITHER_H
@@ -0,0 +1,40 @@
+// filelist.h - input gathering for the batch / gallery modes
+//
+// Tools that take "<dir|list.txt|file> [...]" collect their inputs here:
+// directories are walked recursively for one extension, list files give
+// one path per line.  Symlinked directories met during the walk are not
+// followed (a link loop would otherwise recurse forever); a directory
+// named on the command line is, since the user asked for it.
+
+#ifndef FILELIST_H
+#define FILELIST_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    char  **path;
+    size_t  count, cap;
+} FileList;
+
+// all return 1 on success and 0 when out of memory; unreadable
+// directories and lists are reported with perror() and skipped
+int  filelist_add(FileList *l, const char *path);
+int  filelist_scan_dir(FileList *l, const char *dir, const char *ext);
+int  filelist_read_list(FileList *l, const char *list);
+
+// one command-line argument: a directory, a file ending in ext, or a list
+int  filelist_add_arg(FileList *l, const char *arg, const char *ext);
+
+int  filelist_is_dir(const char *path);     // follows symlinks
+int  filelist_endswith(const char *s, const char *suffix);  // ignores case
+void filelist_free(FileList *l);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILELIST_H
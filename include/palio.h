@@ -0,0 +1,72 @@
+// palio.h - palette loading shared by the tools
+//
+// One loader for every palette format the toolkit writes or meets:
+// 768-byte binary (.act/.lmp/raw .PAL, 772-byte ACT), JASC-PAL, GIMP .gpl,
+// pal2all's Txt grid and Raw3/Raw4 hex lists, ACO v1, C headers, 16x16
+// PNG/BMP/GIF previews and cubegen's binary .lut.  The format is taken
+// from the content, not the extension, and everything is parsed from a
+// memory buffer, so a file is read once and can come from anywhere.
+//
+// palio_load() keeps what it loaded by path and only re-reads a file when
+// its size or modification time changed; tools that look the palette up
+// from several places (or several threads) pay for one parse.
+//
+// Values come out 8-bit.  Sources whose entries all fit in 0..63 are
+// taken as VGA 6-bit and scaled by 4, as the tools always did.
+//
+// A NULL path means the built-in Chasm palette (chasmpal.h), so a tool
+// that isn't given -palette does no palette I/O at all.  The image
+// previews need stb_image.h on the include path; without it palio still
+// builds and reports them as unreadable.
+
+#ifndef PALIO_H
+#define PALIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PALIO_UNKNOWN = 0,
+    PALIO_RAW,          // 768 bytes RGB (772-byte ACT trailer ignored)
+    PALIO_JASC,
+    PALIO_GPL,
+    PALIO_TXTGRID,      // "ROWS 16" ... "R: 000, G: 000, B: 000"
+    PALIO_RAW3,         // 0xRRGGBB per line
+    PALIO_RAW4,         // 0xRRGGBBAA per line
+    PALIO_ACO,
+    PALIO_CHEADER,      // first 768 numbers after '{'
+    PALIO_IMAGE,        // 16x16 preview, one entry per pixel
+    PALIO_CLUT          // cubegen .lut
+} PalioFormat;
+
+typedef struct {
+    uint8_t     rgb[256][3];
+    PalioFormat format;
+    int         scaled;     // 1 if 6-bit values were scaled to 8-bit
+} Palette;
+
+// what the buffer looks like; PALIO_UNKNOWN if nothing matches
+PalioFormat palio_detect(const void *data, size_t len);
+const char *palio_format_name(PalioFormat f);
+
+// returns 1 on success
+int palio_parse(const void *data, size_t len, Palette *out);
+int palio_load(const char *path, Palette *out);     // path NULL: built-in
+
+// removes "-palette <file>" from argv and returns <file>, or def if the
+// option isn't there; tools pass NULL to default to the built-in palette.
+// A trailing "-palette" with no file is a usage error: reported, then exit(1).
+const char *palio_option(int *argc, char **argv, const char *def);
+
+// one-line list of the accepted formats for usage texts
+#define PALIO_FORMATS ".act .lmp .pal .gpl .txt .aco .h .png .lut (detected from content)"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PALIO_H
@@ -0,0 +1,87 @@
+// palquant.h - shared nearest-palette-colour lookup for the PNG -> indexed tools
+//
+// Results are identical to the classic 256-entry scan used across the
+// toolkit: squared Euclidean RGB distance, lowest palette index wins ties.
+//
+// The RGB cube is split into 32x32x32 cells (5:5:5).  Each cell keeps the
+// short, ascending list of palette entries that can be nearest to *some*
+// colour inside it, so a lookup only scans a handful of candidates.  Cells
+// are filled on first use, which keeps start-up cheap for small images;
+// call palquant_prepare() before sharing one table between threads.
+//
+// Cell fills and palquant_search() run on an AVX2 / SSE4.1 / scalar kernel
+// picked at palquant_init() from the running CPU; all three give
+// bit-identical answers.
+
+#ifndef PALQUANT_H
+#define PALQUANT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PALQUANT_CELLS (32*32*32)
+
+typedef struct {
+    uint32_t off;   // first candidate in PalQuant.cand
+    uint16_t n;     // candidate count, 0 = cell not built yet
+} PalQuantCell;
+
+typedef struct PalQuant PalQuant;
+
+struct PalQuant {
+    uint8_t       pal[256][3];
+    uint8_t       dup[256];       // 1 if an earlier entry has the same RGB
+    int16_t       rg[256][2];     // planar copy for the SIMD kernels:
+    int16_t       bz[256][2];     //   (r,g) pairs and (b,0) pairs
+    PalQuantCell  cell[PALQUANT_CELLS];
+    uint8_t      *cand;
+    size_t        cand_len, cand_cap;
+    const char   *isa;            // "avx2", "sse4.1" or "scalar"
+    int  (*search)(const PalQuant *q, int r, int g, int b);
+    void (*box)(const PalQuant *q, const int lo[3], const int hi[3],
+                int32_t dmin[256], int32_t dmax[256]);
+};
+
+// returns 1 on success, 0 on allocation failure
+int  palquant_init(PalQuant *q, const uint8_t pal[256][3]);
+void palquant_free(PalQuant *q);
+
+// build every cell up front (read-only afterwards, safe for threads)
+int  palquant_prepare(PalQuant *q);
+
+// fills one cell; used by palquant_nearest() on a miss
+int  palquant_build_cell(PalQuant *q, unsigned cell);
+
+// full 256-entry scan without the table (same result as palquant_nearest)
+static inline int palquant_search(const PalQuant *q, int r, int g, int b) {
+    return q->search(q, r, g, b);
+}
+
+static inline int palquant_nearest(PalQuant *q, int r, int g, int b) {
+    unsigned ci = ((unsigned)(r >> 3) << 10) | ((unsigned)(g >> 3) << 5) | (unsigned)(b >> 3);
+    if (!q->cell[ci].n && !palquant_build_cell(q, ci)) return 0;
+    const uint8_t *c = q->cand + q->cell[ci].off;
+    const uint8_t *e = c + q->cell[ci].n;
+    int best = *c;
+    if (c + 1 == e) return best;
+    int bd = INT_MAX;
+    for (; c < e; c++) {
+        int dr = r - q->pal[*c][0];
+        int dg = g - q->pal[*c][1];
+        int db = b - q->pal[*c][2];
+        int d = dr*dr + dg*dg + db*db;
+        if (d < bd) { bd = d; best = *c; if (d == 0) break; }
+    }
+    return best;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PALQUANT_H
@@ -0,0 +1,86 @@
+// paltex.h - palette-indexed textures for the OpenGL viewers
+//
+// Chasm art is 8-bit, so instead of expanding every texture to RGBA the
+// viewers upload each one once as a GL_LUMINANCE8 index map and keep the
+// palette in one shared 256x1 RGBA texture that a fragment shader looks
+// the colour up in.  Changing the palette, the background entry or which
+// entries are transparent is then a single 1 KB upload, and textures take
+// a quarter of the memory.
+//
+// The lookup needs OpenGL 2.0.  Without it paltex_init() returns 0 and the
+// same calls keep plain RGBA textures that are re-expanded on the CPU when
+// the palette changes, so callers don't need a second code path.
+//
+// The index map is bound to texture unit 0 and the palette to unit 1.  A
+// viewer with its own shader pastes PALTEX_GLSL into its fragment source,
+// samples with paltex(uv) instead of texture2D() and binds through
+// paltex_bind_program().
+
+#ifndef PALTEX_H
+#define PALTEX_H
+
+#include <stdint.h>
+#include <GL/glew.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GLSL 1.10 source for vec4 paltex(vec2 uv).  Index maps are never filtered
+// by GL (that would blend index numbers); linear filtering is done here on
+// the looked-up colours instead.
+#define PALTEX_GLSL \
+    "uniform sampler2D palIndex;\n" \
+    "uniform sampler2D palColors;\n" \
+    "uniform vec2  palSize;\n" \
+    "uniform float palLinear;\n" \
+    "vec4 palLookup(vec2 t){\n" \
+    "    float i = texture2D(palIndex, t).r;\n" \
+    "    return texture2D(palColors, vec2((i*255.0 + 0.5)/256.0, 0.5));\n" \
+    "}\n" \
+    "vec4 paltex(vec2 uv){\n" \
+    "    if(palLinear < 0.5) return palLookup(uv);\n" \
+    "    vec2 p = uv*palSize - 0.5;\n" \
+    "    vec2 f = fract(p);\n" \
+    "    vec2 d = 1.0/palSize;\n" \
+    "    vec2 b = (floor(p) + 0.5)*d;\n" \
+    "    return mix(mix(palLookup(b),                palLookup(b + vec2(d.x, 0.0)), f.x),\n" \
+    "               mix(palLookup(b + vec2(0.0, d.y)), palLookup(b + d),            f.x), f.y);\n" \
+    "}\n"
+
+typedef struct PalTex {
+    GLuint          tex;
+    int             w, h;
+    int             linear;     // filter the looked-up colours
+    uint8_t        *idx;        // CPU copy, fallback path only
+    struct PalTex  *next;       // fallback textures to re-expand
+} PalTex;
+
+// after glewInit(); returns 1 when the shader lookup is in use
+int  paltex_init(void);
+int  paltex_active(void);
+
+// rgb: the 256 entries; alpha: one per entry, or NULL for all opaque.
+// Call once before the first paltex_create() and again on every change.
+void paltex_palette(const uint8_t rgb[256][3], const uint8_t *alpha);
+
+// idx is w x h tightly packed.  Returns 1 on success.
+int  paltex_create(PalTex *t, const uint8_t *idx, int w, int h);
+// replace the w x h rectangle at (x, y); idx tightly packed
+void paltex_update(PalTex *t, const uint8_t *idx, int x, int y, int w, int h);
+void paltex_filter(PalTex *t, int linear);
+void paltex_free(PalTex *t);
+
+// bind t with the built-in program (fixed-function vertex path,
+// colour = paltex(gl_TexCoord[0]) * gl_Color)
+void paltex_bind(const PalTex *t);
+// bind t for a caller program that includes PALTEX_GLSL; leaves prog in use
+void paltex_bind_program(const PalTex *t, GLuint prog);
+// back to the fixed-function pipeline
+void paltex_unbind(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PALTEX_H
@@ -0,0 +1,44 @@
+// pngidx.h - 8-bit indexed PNG writer
+//
+// Chasm art is already palettized, so the exporters write it as colour
+// type 3 (PLTE + optional tRNS) instead of expanding it to 24/32-bit RGB(A):
+// a quarter of the pixel data before compression, and the files still
+// load as RGBA in stb_image and every editor.
+//
+// IDAT is real deflate (stb_image_write's compressor, so no extra
+// dependency).  Each image is filtered twice - all rows unfiltered, and
+// per row the filter with the smallest sum of absolute deltas - and the
+// smaller stream is kept; index data usually prefers no filter, smooth
+// gradients don't.  PLTE always holds all 256 entries; tRNS is trimmed
+// to the last non-opaque entry in use.
+// Chunk CRCs are slice-by-8.  Safe to call from several threads.
+
+#ifndef PNGIDX_H
+#define PNGIDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// idx: w x h indices, rows `stride` bytes apart.  pal: 256 RGB entries.
+// alpha: one per entry (0 = transparent), or NULL for all opaque.
+// Returns the PNG file in a malloc'ed buffer, or NULL on failure.
+uint8_t *pngidx_encode(const uint8_t *idx, int w, int h, int stride,
+                       const uint8_t pal[256][3], const uint8_t *alpha,
+                       size_t *len);
+
+// encode and write with a single fwrite; returns 1 on success
+int pngidx_write(const char *fn, const uint8_t *idx, int w, int h, int stride,
+                 const uint8_t pal[256][3], const uint8_t *alpha);
+
+// zlib/PNG CRC-32; pass 0 to start
+uint32_t pngidx_crc32(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PNGIDX_H
@@ -0,0 +1,27 @@
+// workpool.h - minimal parallel-for used by the batch / threaded tools
+//
+// workpool_run() calls fn(ctx, i, worker) for every i in [0, count) on up
+// to `threads` workers (0 = one per CPU) and returns when all are done.
+// Items are handed out one at a time from a shared counter, so uneven
+// work (big and small files, busy and empty tiles) balances itself.
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*WorkFn)(void *ctx, size_t item, int worker);
+
+int  workpool_cpu_count(void);
+// returns the number of workers actually used
+int  workpool_run(size_t count, int threads, WorkFn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WORKPOOL_H
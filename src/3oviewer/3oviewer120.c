@@ -25,15 +25,22 @@
 // • Top‐left controls each on its own line
 // • F1 toggles all on‐screen text overlays
 // • All prior functionality retained
-// • x86_64-w64-mingw32-gcc -std=c99 -O2 -I./ -L./lib -o 3oviewer.exe viewer120.c -lfreeglut -lopengl32 -lglu32 -lwinmm
+// • x86_64-w64-mingw32-gcc -std=c99 -O2 -I./ -L./lib -o 3oviewer.exe viewer120.c ../paltex/paltex.c ../palio/palio.c ../chasmpal/chasmpal.c -I../../include -lfreeglut -lglew32 -lopengl32 -lglu32 -lwinmm
+// • With OpenGL 2.0 all frames live on the GPU and a vertex shader lerps
+//   them; older drivers fall back to the immediate-mode path
+// • Palette is built in; -palette <file> replaces it
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <limits.h>
 #include <math.h>
+#include <GL/glew.h>
 #include <GL/freeglut.h>
+#include "paltex.h"
+#include "palio.h"
 
 #ifndef GL_CLAMP_TO_EDGE
 #define GL_CLAMP_TO_EDGE GL_CLAMP
@@ -71,7 +78,7 @@ static size_t   size3o, sizeAni;
 
 // Palette & texture
 static uint8_t  palette[256][3];
-static GLuint   texID;
+static PalTex   skin;    // index map; palette looked up on the GPU
 static uint16_t skinH;
 static size_t   skinPixels;
 
@@ -85,6 +92,51 @@ static int      totalFrames = 0;
 // Model center
 static float centerX, centerY, centerZ;
 
+// GPU animation: per-corner frames + flat normals, lerped in the shader
+typedef struct { int8_t n[4]; } NORM;
+// NVIDIA aliases generic slots 2/3 to gl_Normal/gl_Color (and the shader
+// reads gl_Color), so the normals go to slots nothing built-in uses
+#define ATTR_NRM0 6
+#define ATTR_NRM1 7
+static bool     gpuAnim = false;
+static GLuint   progAnim, vboPos, vboNrm, vboUV, vboCol, iboTris;
+static GLint    uAlpha, uLighting;
+static int      triCount = 0, nFrames = 0;
+static uint16_t *triPoly = NULL;       // source polygon of each triangle
+static int      opaqueTris = 0, transTris = 0, builtFilter = -2;
+
+static const char *animVS =
+    "#version 110\n"
+    "uniform float alpha;\n"
+    "uniform float scale;\n"
+    "uniform vec3 center;\n"
+    "uniform bool lighting;\n"
+    "attribute vec3 pos0;\n"
+    "attribute vec3 pos1;\n"
+    "attribute vec3 nrm0;\n"
+    "attribute vec3 nrm1;\n"
+    "void main(){\n"
+    "    vec3 p = (mix(pos0, pos1, alpha) - center).xzy * scale;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    if(lighting){\n"
+    "        vec3 n = gl_NormalMatrix * mix(nrm0, nrm1, alpha);\n"
+    "        if(dot(n, n) > 0.0) n = normalize(n);\n"
+    "        float d = max(dot(n, normalize(gl_LightSource[0].position.xyz)), 0.0);\n"
+    "        vec3 c = gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb\n"
+    "               + gl_LightSource[0].diffuse.rgb * d;\n"
+    "        gl_FrontColor = vec4(clamp(gl_Color.rgb * c, 0.0, 1.0), gl_Color.a);\n"
+    "    } else {\n"
+    "        gl_FrontColor = gl_Color;\n"
+    "    }\n"
+    "}\n";
+static const char *animFS =
+    "#version 110\n"
+    PALTEX_GLSL
+    "void main(){\n"
+    "    gl_FragColor = paltex(gl_TexCoord[0].st) * gl_Color;\n"
+    "}\n";
+
 // View state
 static bool playing      = true;
 static bool doCull       = false;
@@ -137,20 +189,21 @@ static inline bool skipPoly(uint8_t flags, bool needTrans){
     return needTrans ? !isT : isT;
 }
 
-// Load palette (.act)
+// Load palette (built in when fn is NULL)
 static void loadPalette(const char *fn){
-    FILE *f = fopen(fn,"rb"); if(!f){ perror(fn); exit(1); }
-    fseek(f,0,SEEK_END); long sz = ftell(f);
-    fseek(f,sz-768,SEEK_SET);
-    fread(palette,1,768,f);
-    fclose(f);
+    Palette pal;
+    if(!palio_load(fn,&pal)){ fprintf(stderr,"Bad palette %s\n",fn); exit(1); }
+    memcpy(palette,pal.rgb,sizeof(palette));
+}
+// Entry 4 is see-through
+static void uploadPalette(){
+    uint8_t alpha[256];
+    for(int i=0;i<256;i++) alpha[i] = (i==4?0:255);
+    paltex_palette(palette, alpha);
 }
 // Update texture filtering
 static void updateFilter(){
-    glBindTexture(GL_TEXTURE_2D, texID);
-    GLint f = useLinear ? GL_LINEAR : GL_NEAREST;
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,f);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,f);
+    paltex_filter(&skin, useLinear);
 }
 
 // Load .3O mesh + skin
@@ -180,31 +233,22 @@ static void load3O(const char *fn){
 
     // Dominant BG color
     int hist[256] = {0};
-    uint8_t *skin = raw3o + OFF_SKIN;
+    uint8_t *skinIdx = raw3o + OFF_SKIN;
     for(size_t i=0;i<skinPixels;i++){
-        hist[skin[i]]++;
+        hist[skinIdx[i]]++;
     }
     bgIndex = 0;
     for(int i=1;i<256;i++) if(hist[i]>hist[bgIndex]) bgIndex = i;
     defaultBgIndex = bgIndex;
 
-    // Build RGBA skin texture
-    uint8_t *rgba = malloc(skinPixels*4);
-    for(size_t i=0;i<skinPixels;i++){
-        uint8_t c = skin[i];
-        rgba[4*i+0] = palette[c][0];
-        rgba[4*i+1] = palette[c][1];
-        rgba[4*i+2] = palette[c][2];
-        rgba[4*i+3] = (c==4?0:255);
+    // Skin as an index map
+    if(!paltex_create(&skin, skinIdx, SKIN_W, skinH)){
+        fprintf(stderr,"%s: out of memory\n",fn); exit(1);
     }
-    glGenTextures(1,&texID);
-    glBindTexture(GL_TEXTURE_2D,texID);
-    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+    glBindTexture(GL_TEXTURE_2D,skin.tex);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
     glTexEnvf(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_MODULATE);
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,SKIN_W,skinH,0,GL_RGBA,GL_UNSIGNED_BYTE,rgba);
-    free(rgba);
 
     polys     = (POLY*)(raw3o + OFF_POLY);
     baseVerts = (VERT*)(raw3o + OFF_VERT);
@@ -221,6 +265,174 @@ static void loadANI(const char *fn){
     animVerts   = (VERT*)(rawAni + off);
 }
 
+// Triangle corners of polygon P: (0,1,2) and, for quads, (2,3,0)
+static int polyTris(const POLY *P, int corner[2][3]){
+    static const int tri[2][3] = {{0,1,2},{2,3,0}};
+    int n = P->vi[3]<vcount ? 2 : 1;
+    for(int t=0;t<n;t++) for(int k=0;k<3;k++) corner[t][k] = tri[t][k];
+    return n;
+}
+
+static GLuint compileShader(GLenum type, const char *src){
+    GLuint s = glCreateShader(type);
+    glShaderSource(s,1,&src,NULL);
+    glCompileShader(s);
+    GLint ok = 0; glGetShaderiv(s,GL_COMPILE_STATUS,&ok);
+    if(!ok){
+        char log[512]; glGetShaderInfoLog(s,sizeof(log),NULL,log);
+        fprintf(stderr,"Shader compile failed: %s\n",log);
+        glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+// Upload every frame once; false keeps the immediate-mode path
+static bool buildGpuAnim(){
+    if(!paltex_active()) return false;
+    GLuint vs = compileShader(GL_VERTEX_SHADER, animVS);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, animFS);
+    if(!vs || !fs){ glDeleteShader(vs); glDeleteShader(fs); return false; }
+    progAnim = glCreateProgram();
+    glAttachShader(progAnim,vs); glAttachShader(progAnim,fs);
+    glBindAttribLocation(progAnim,0,"pos0");
+    glBindAttribLocation(progAnim,1,"pos1");
+    glBindAttribLocation(progAnim,ATTR_NRM0,"nrm0");
+    glBindAttribLocation(progAnim,ATTR_NRM1,"nrm1");
+    glLinkProgram(progAnim);
+    glDeleteShader(vs); glDeleteShader(fs);
+    GLint ok = 0; glGetProgramiv(progAnim,GL_LINK_STATUS,&ok);
+    if(!ok){ glDeleteProgram(progAnim); progAnim = 0; return false; }
+
+    triCount = 0;
+    for(int i=0;i<pcount;i++){ int c[2][3]; triCount += polyTris(&polys[i],c); }
+    nFrames = totalFrames ? totalFrames : 1;
+    const VERT *frames = totalFrames ? animVerts : baseVerts;
+    size_t corners = (size_t)triCount*3;
+
+    VERT   *pos = malloc(nFrames*corners*sizeof(VERT));
+    NORM   *nrm = malloc(nFrames*corners*sizeof(NORM));
+    float  *uv  = malloc(corners*2*sizeof(float));
+    float  *col = malloc(corners*4*sizeof(float));
+    triPoly = malloc(triCount*sizeof(uint16_t));
+    if(!pos || !nrm || !uv || !col || !triPoly){
+        free(pos); free(nrm); free(uv); free(col);
+        glDeleteProgram(progAnim); progAnim = 0;
+        return false;
+    }
+
+    size_t c = 0;
+    int t = 0;
+    for(int i=0;i<pcount;i++){
+        const POLY *P = &polys[i];
+        float a = (P->flags & 12) ? ((P->flags & 4) ? 0.2f : 0.6f) : 1.0f;
+        int tri[2][3], n = polyTris(P,tri);
+        for(int j=0;j<n;j++,t++){
+            triPoly[t] = (uint16_t)i;
+            for(int k=0;k<3;k++,c++){
+                int vi = tri[j][k];
+                uv[2*c+0] = P->uv[vi][0]/(float)SKIN_W;
+                uv[2*c+1] = clampi(P->uv[vi][1]+P->uv_off,0,skinH-1)/(float)skinH;
+                col[4*c+0] = col[4*c+1] = col[4*c+2] = 1; col[4*c+3] = a;
+            }
+            for(int f=0;f<nFrames;f++){
+                const VERT *fv = frames + (size_t)f*vcount;
+                float p[3][3], nv[3];
+                for(int k=0;k<3;k++){
+                    const VERT *v = &fv[P->vi[tri[j][k]]];
+                    p[k][0] = (v->x-centerX)*SCALE3O;
+                    p[k][1] = (v->z-centerZ)*SCALE3O;
+                    p[k][2] = (v->y-centerY)*SCALE3O;
+                }
+                computeNormal(p[0],p[1],p[2],nv);
+                size_t base = (size_t)f*corners + c-3;
+                for(int k=0;k<3;k++){
+                    pos[base+k] = fv[P->vi[tri[j][k]]];
+                    for(int e=0;e<3;e++) nrm[base+k].n[e] = (int8_t)lrintf(nv[e]*127.0f);
+                    nrm[base+k].n[3] = 0;
+                }
+            }
+        }
+    }
+
+    GLuint vbo[4];
+    glGenBuffers(4,vbo);
+    vboPos = vbo[0]; vboNrm = vbo[1]; vboUV = vbo[2]; vboCol = vbo[3];
+    glBindBuffer(GL_ARRAY_BUFFER,vboPos);
+    glBufferData(GL_ARRAY_BUFFER,nFrames*corners*sizeof(VERT),pos,GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,vboNrm);
+    glBufferData(GL_ARRAY_BUFFER,nFrames*corners*sizeof(NORM),nrm,GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,vboUV);
+    glBufferData(GL_ARRAY_BUFFER,corners*2*sizeof(float),uv,GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,vboCol);
+    glBufferData(GL_ARRAY_BUFFER,corners*4*sizeof(float),col,GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glGenBuffers(1,&iboTris);
+    free(pos); free(nrm); free(uv); free(col);
+
+    glUseProgram(progAnim);
+    glUniform1f(glGetUniformLocation(progAnim,"scale"),SCALE3O);
+    glUniform3f(glGetUniformLocation(progAnim,"center"),centerX,centerY,centerZ);
+    uAlpha    = glGetUniformLocation(progAnim,"alpha");
+    uLighting = glGetUniformLocation(progAnim,"lighting");
+    glUseProgram(0);
+    return true;
+}
+
+// Opaque triangles first, then translucent; only rebuilt when the bit filter changes
+static void updateGpuIndices(){
+    if(builtFilter==filterBit) return;
+    builtFilter = filterBit;
+    GLuint *idx = malloc((size_t)triCount*3*sizeof(GLuint));
+    if(!idx) return;
+    size_t n = 0;
+    for(int pass=0;pass<2;pass++){
+        for(int t=0;t<triCount;t++){
+            if(skipPoly(polys[triPoly[t]].flags, pass==1)) continue;
+            for(int k=0;k<3;k++) idx[n++] = (GLuint)(3*t+k);
+        }
+        if(pass==0) opaqueTris = (int)(n/3);
+    }
+    transTris = (int)(n/3) - opaqueTris;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,iboTris);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,n*sizeof(GLuint),idx,GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    free(idx);
+}
+
+static void drawGpuPass(bool isTrans, int f0, int f1, float alpha){
+    int first = isTrans ? opaqueTris : 0;
+    int count = isTrans ? transTris : opaqueTris;
+    if(!count) return;
+    size_t corners = (size_t)triCount*3;
+    paltex_bind_program(&skin, progAnim);
+    glUniform1f(uAlpha,alpha);
+    glUniform1i(uLighting,shading);
+    glBindBuffer(GL_ARRAY_BUFFER,vboPos);
+    glEnableVertexAttribArray(0); glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0,3,GL_SHORT,GL_FALSE,0,(void*)(f0*corners*sizeof(VERT)));
+    glVertexAttribPointer(1,3,GL_SHORT,GL_FALSE,0,(void*)(f1*corners*sizeof(VERT)));
+    glBindBuffer(GL_ARRAY_BUFFER,vboNrm);
+    glEnableVertexAttribArray(ATTR_NRM0); glEnableVertexAttribArray(ATTR_NRM1);
+    glVertexAttribPointer(ATTR_NRM0,3,GL_BYTE,GL_TRUE,sizeof(NORM),(void*)(f0*corners*sizeof(NORM)));
+    glVertexAttribPointer(ATTR_NRM1,3,GL_BYTE,GL_TRUE,sizeof(NORM),(void*)(f1*corners*sizeof(NORM)));
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,vboUV);
+    glTexCoordPointer(2,GL_FLOAT,0,(void*)0);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,vboCol);
+    glColorPointer(4,GL_FLOAT,0,(void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,iboTris);
+    glDrawElements(GL_TRIANGLES,count*3,GL_UNSIGNED_INT,(void*)(first*3*sizeof(GLuint)));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableVertexAttribArray(0); glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(ATTR_NRM0); glDisableVertexAttribArray(ATTR_NRM1);
+    glUseProgram(0);
+}
+
 static void display(){
     // Clear
     glClearColor(
@@ -257,7 +469,6 @@ static void display(){
 
     // Bind texture
     glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, texID);
 
     // Interpolate frames
     int f0 = totalFrames ? curFrame % totalFrames : 0;
@@ -266,6 +477,7 @@ static void display(){
                   ? accTime/frameDur : 0;
     VERT *v0 = totalFrames ? animVerts + f0*vcount : baseVerts;
     VERT *v1 = totalFrames ? animVerts + f1*vcount : baseVerts;
+    if(gpuAnim) updateGpuIndices();
 
     // Two passes
     for(int pass=0; pass<2; pass++){
@@ -277,7 +489,9 @@ static void display(){
             glDisable(GL_BLEND);
         }
         glPolygonMode(GL_FRONT_AND_BACK, wireframe?GL_LINE:GL_FILL);
+        if(gpuAnim){ drawGpuPass(isTrans,f0,f1,alpha); continue; }
 
+        paltex_bind(&skin);
         glBegin(GL_TRIANGLES);
         for(int i=0;i<pcount;i++){
             POLY *P = &polys[i];
@@ -333,6 +547,7 @@ static void display(){
             }
         }
         glEnd();
+        paltex_unbind();
     }
     glDisable(GL_BLEND);
     glDisable(GL_TEXTURE_2D);
@@ -342,7 +557,7 @@ static void display(){
         glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
         gluOrtho2D(0,winW,0,winH);
         glMatrixMode(GL_MODELVIEW);  glPushMatrix(); glLoadIdentity();
-        glEnable(GL_TEXTURE_2D); glBindTexture(GL_TEXTURE_2D,texID);
+        glEnable(GL_TEXTURE_2D); paltex_bind(&skin);
         float x0=winW-SKIN_W, y0=winH-skinH, x1=winW, y1=winH;
         glBegin(GL_QUADS);
           glTexCoord2f(0,1); glVertex2f(x0,y0);
@@ -350,6 +565,7 @@ static void display(){
           glTexCoord2f(1,0); glVertex2f(x1,y1);
           glTexCoord2f(0,0); glVertex2f(x0,y1);
         glEnd();
+        paltex_unbind();
         glDisable(GL_TEXTURE_2D);
         glMatrixMode(GL_PROJECTION); glPopMatrix();
         glMatrixMode(GL_MODELVIEW);  glPopMatrix();
@@ -512,18 +728,23 @@ static void special(int k,int x,int y){
 }
 
 int main(int argc,char**argv){
+    const char *palFile = palio_option(&argc,argv,NULL);
     if(argc<2||argc>3){
-        fprintf(stderr,"Usage: %s <model.3o> [model.ani]\n",argv[0]);
+        fprintf(stderr,"Usage: %s <model.3o> [model.ani] [-palette <file>]\n",argv[0]);
         return 1;
     }
-    loadPalette("chasmpalette.act");
+    loadPalette(palFile);
     glutInit(&argc,argv);
     glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGBA|GLUT_DEPTH);
     glutInitWindowSize(winW,winH);
     glutCreateWindow("Chasm The Rift 3O+ANI Viewer v1.2.0 by SMR9000");
     glEnable(GL_DEPTH_TEST);
+    bool haveGlew = glewInit()==GLEW_OK;
+    if(haveGlew) paltex_init();
+    uploadPalette();
     load3O(argv[1]);
     if(argc==3) loadANI(argv[2]);
+    gpuAnim = haveGlew && buildGpuAnim();
     glutDisplayFunc(display);
     glutIdleFunc(idle);
     glutReshapeFunc(reshape);
@@ -1,96 +1,146 @@
-// x86_64-w64-mingw32-gcc -std=c99 -O2 -o carextractpng.exe carextractpng.c
-// carextractpng.exe test.car
+// x86_64-w64-mingw32-gcc -std=c99 -O2 -o carextractpng.exe carextractpng.c ../carfile/carfile.c ../workpool/workpool.c ../filelist/filelist.c ../pngidx/pngidx.c ../palio/palio.c ../chasmpal/chasmpal.c -I../../include
+// carextractpng.exe test.car [-palette pal]
+// carextractpng.exe -batch <dir|list.txt|file.car> [...] [-threads N] [-palette pal]
 
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
-#define TEXTURE_WIDTH           64
-#define TEXTURE_OFFSET_BYTES    0x486Au
-#define TEXTURE_OFFSET          0x486Cu
+#include "carfile.h"
+#include "workpool.h"
+#include "filelist.h"
+#include "pngidx.h"
+#include "palio.h"
+#include "chasmpal.h"
 
 // Transparent color (#040404)
 static const uint8_t TRANSPARENT_R = 0x04;
 static const uint8_t TRANSPARENT_G = 0x04;
 static const uint8_t TRANSPARENT_B = 0x04;
 
-static void write_png_rgba(const char *filename, int w, int h, uint8_t *rgba_data)
+static uint8_t palette[256][3];
+static uint8_t alpha[256];      // 0 for every entry that is TRANSPARENT_*
+
+static int load_palette(const char *pal_file)
 {
-    int stride = w * 4;
-    if (!stbi_write_png(filename, w, h, 4, rgba_data, stride)) {
-        fprintf(stderr, "Failed to write PNG \"%s\"\n", filename);
-        exit(EXIT_FAILURE);
+    Palette pal;
+    if (!palio_load(pal_file, &pal)) {
+        fprintf(stderr, "Error reading palette %s\n", pal_file);
+        return 0;
+    }
+    memcpy(palette, pal.rgb, sizeof(palette));
+    if (!pal_file) {            // built-in palette: its table is compiled in
+        memcpy(alpha, chasmpal_alpha, sizeof(alpha));
+        return 1;
     }
+    for (int i = 0; i < 256; i++)
+        alpha[i] = (palette[i][0] == TRANSPARENT_R && palette[i][1] == TRANSPARENT_G &&
+                    palette[i][2] == TRANSPARENT_B) ? 0 : 255;
+    return 1;
 }
 
-int main(int argc, char *argv[])
+// CAR -> <car>.texture.png; on failure returns 0 with a message in err
+static int extract_texture(const char *car_file, char *err, size_t errlen)
 {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <input.car>\n", argv[0]);
-        return EXIT_FAILURE;
+    // --- map .CAR file ---
+    CARFile car;
+    if (!car_open(&car, car_file)) {
+        snprintf(err, errlen, "%s", car.error);
+        return 0;
     }
-    const char *car_file = argv[1];
-    const char *act_file = "chasmpalette.act";
-
-    // --- load .CAR file into memory ---
-    FILE *cf = fopen(car_file, "rb");
-    if (!cf) { perror("Opening .CAR"); return EXIT_FAILURE; }
-    fseek(cf, 0, SEEK_END);
-    long file_size = ftell(cf);
-    rewind(cf);
-    uint8_t *car_data = malloc(file_size);
-    if (!car_data || fread(car_data, 1, file_size, cf) != file_size) {
-        fprintf(stderr, "Error reading %s\n", car_file);
-        return EXIT_FAILURE;
+
+    // --- extract first 64×N texture as an indexed PNG ---
+    char out_file[512];
+    snprintf(out_file, sizeof(out_file), "%s.texture.png", car_file);
+    int ok = pngidx_write(out_file, car.texture, car.tex_width, car.tex_height,
+                          car.tex_width, palette, alpha);
+    if (!ok) snprintf(err, errlen, "failed to write PNG");
+
+    car_close(&car);
+    return ok;
+}
+
+//―――― Batch mode ―――――――――――――――――――――――――
+
+typedef struct {
+    FileList *files;
+    char    (*errors)[256];
+    int      *ok;
+} BatchJob;
+
+static void batch_item(void *ctx, size_t i, int worker)
+{
+    BatchJob *job = ctx;
+    const char *car_file = job->files->path[i];
+    job->ok[i] = extract_texture(car_file, job->errors[i], sizeof(job->errors[i]));
+    if (job->ok[i]) printf("%s.texture.png\n", car_file);
+}
+
+static int run_batch(int argc, char *argv[])
+{
+    FileList files = { 0 };
+    int threads = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!filelist_add_arg(&files, argv[i], ".car")) {
+            fprintf(stderr, "Out of memory\n");
+            filelist_free(&files);
+            return EXIT_FAILURE;
+        }
     }
-    fclose(cf);
-
-    // --- load chasmpalette.act (768 bytes: R, G, B × 256) ---
-    FILE *af = fopen(act_file, "rb");
-    if (!af) { perror("Opening chasmpalette.act"); return EXIT_FAILURE; }
-    uint8_t palette[256][3];
-    if (fread(palette, 1, 256*3, af) != 256*3) {
-        fprintf(stderr, "Error reading %s\n", act_file);
+    if (!files.count) {
+        fprintf(stderr, "No .car files found\n");
         return EXIT_FAILURE;
     }
-    fclose(af);
-
-    // --- extract first 64×N texture ---
-    uint16_t tex_size;
-    memcpy(&tex_size, car_data + TEXTURE_OFFSET_BYTES, sizeof(tex_size));
-    int tex_h = tex_size / TEXTURE_WIDTH;
-    uint8_t *tex_idx = car_data + TEXTURE_OFFSET;
 
-    size_t tex_pixels = (size_t)TEXTURE_WIDTH * tex_h;
-    uint8_t *tex_rgba = malloc(tex_pixels * 4);
-    if (!tex_rgba) {
+    BatchJob job = { &files, calloc(files.count, sizeof(*job.errors)), calloc(files.count, sizeof(int)) };
+    if (!job.errors || !job.ok) {
         fprintf(stderr, "Out of memory\n");
+        filelist_free(&files);
+        free(job.errors);
+        free(job.ok);
         return EXIT_FAILURE;
     }
+    int used = workpool_run(files.count, threads, batch_item, &job);
 
-    for (size_t i = 0; i < tex_pixels; i++) {
-        uint8_t idx = tex_idx[i];
-        uint8_t r = palette[idx][0];
-        uint8_t g = palette[idx][1];
-        uint8_t b = palette[idx][2];
-        size_t base = i * 4;
-        tex_rgba[base + 0] = r;
-        tex_rgba[base + 1] = g;
-        tex_rgba[base + 2] = b;
-        tex_rgba[base + 3] = (r == TRANSPARENT_R && g == TRANSPARENT_G && b == TRANSPARENT_B) ? 0 : 255;
+    size_t failed = 0;
+    for (size_t i = 0; i < files.count; i++) {
+        if (!job.ok[i]) {
+            fprintf(stderr, "Error: %s: %s\n", files.path[i], job.errors[i]);
+            failed++;
+        }
     }
+    printf("Extracted %zu of %zu textures (%d threads)\n",
+           files.count - failed, files.count, used);
 
-    char out_file[512];
-    snprintf(out_file, sizeof(out_file), "%s.texture.png", car_file);
-    write_png_rgba(out_file, TEXTURE_WIDTH, tex_h, tex_rgba);
+    filelist_free(&files);
+    free(job.errors);
+    free(job.ok);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-    free(tex_rgba);
-    free(car_data);
+int main(int argc, char *argv[])
+{
+    const char *pal_file = palio_option(&argc, argv, NULL);
+    int batch = argc >= 3 && !strcmp(argv[1], "-batch");
+    if (argc != 2 && !batch) {
+        fprintf(stderr, "Usage: %s <input.car>\n"
+                        "       %s -batch <dir|list.txt|file.car> [...] [-threads N]\n"
+                        "Options: -palette <file>  instead of the built-in palette (" PALIO_FORMATS ")\n",
+                argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // --- built-in palette, or -palette ---
+    if (!load_palette(pal_file)) return EXIT_FAILURE;
 
+    if (batch) return run_batch(argc, argv);
+
+    char err[256];
+    if (!extract_texture(argv[1], err, sizeof(err))) {
+        fprintf(stderr, "Error reading %s: %s\n", argv[1], err);
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
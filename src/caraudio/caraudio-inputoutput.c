@@ -17,28 +17,19 @@
 //
 // Compile under WSL/MinGW:
 //   sudo apt update && sudo apt install mingw-w64
-//   x86_64-w64-mingw32-gcc -std=c11 -O2 -Wall -static -o caraudio-io.exe caraudio-io.c
+//   x86_64-w64-mingw32-gcc -std=c11 -O2 -Wall -static -o caraudio-io.exe caraudio-io.c ../carfile/carfile.c -I../../include
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <strings.h>  // strcasecmp()
+#include "carfile.h"
 
 #ifdef _WIN32
   #include <windows.h>
 #endif
 
-#pragma pack(push,1)
-typedef struct {
-    uint16_t animations[20];
-    uint16_t submodels_animations[3][2];
-    uint16_t unknown0[9];
-    uint16_t sounds[7];
-    uint16_t unknown1[9];
-} CARHeader;
-#pragma pack(pop)
-
 typedef enum { MODE_EXPORT, MODE_IMPORT } ProgramMode;
 typedef enum { OUT_RAW, OUT_WAV } ExportFormat;
 
@@ -153,25 +144,12 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    // Read .car into memory
-    FILE *f = fopen(in_path, "rb");
-    if (!f) { perror(in_path); return 1; }
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    rewind(f);
-    uint8_t *car = malloc(file_size);
-    if (!car) { fclose(f); return 1; }
-    if (fread(car,1,file_size,f) != (size_t)file_size) {
-        free(car);
-        fclose(f);
+    // Map .car (read only)
+    CARFile car;
+    if (!car_open(&car, in_path)) {
+        fprintf(stderr, "%s: %s\n", in_path, car.error);
         return 1;
     }
-    fclose(f);
-
-    CARHeader *hdr = (CARHeader*)car;
-    uint32_t total = 0;
-    for (int i = 0; i < 7; ++i) total += hdr->sounds[i];
-    long audio_off = file_size - total;
 
     if (mode == MODE_EXPORT) {
         // Parse export args
@@ -205,9 +183,8 @@ int main(int argc, char *argv[]) {
         const uint32_t br = rate * ch * (bits/8);
         const uint16_t align = ch * (bits/8);
 
-        uint32_t off = audio_off;
-        for (int i = 0; i < 7; ++i) {
-            uint16_t len = hdr->sounds[i];
+        for (int i = 0; i < CAR_SOUNDS; ++i) {
+            uint16_t len = car.sound_len[i];
             if (!len) continue;
 
             char outname[260];
@@ -217,7 +194,7 @@ int main(int argc, char *argv[]) {
                 snprintf(outname, sizeof(outname), "%s_%d.wav", prefix_buf, i);
 
             FILE *o = fopen(outname, "wb");
-            if (!o) { off += len; continue; }
+            if (!o) continue;
 
             if (fmt == OUT_WAV) {
                 uint32_t ds = len, ck = 36 + ds;
@@ -231,20 +208,20 @@ int main(int argc, char *argv[]) {
                 fwrite(&ds,4,1,o);
             }
 
-            fwrite(car + off, 1, len, o);
+            fwrite(car.sounds[i], 1, len, o);
             printf("Wrote %s (%u bytes%s)\n",
                 outname, (unsigned)len,
                 fmt==OUT_WAV ? " of 8-bit @ 11025 Hz" : "");
             fclose(o);
-            off += len;
         }
 
     } else {
         // IMPORT mode
         const char *out_path = argv[3];
-        Replacement reps[7];
+        Replacement reps[CAR_SOUNDS];
+        uint8_t *bufs[CAR_SOUNDS] = { NULL };
         int rc = 0;
-        for (int i = 4; i < argc; ++i) {
+        for (int i = 4; i < argc && rc < CAR_SOUNDS; ++i) {
             if (endswith(argv[i], ".raw") || endswith(argv[i], ".wav")) {
                 const char *p = strrchr(argv[i], '_');
                 if (!p) continue;
@@ -255,7 +232,7 @@ int main(int argc, char *argv[]) {
         }
         for (int r = 0; r < rc; ++r) {
             int s = reps[r].slot;
-            uint16_t orig_len = hdr->sounds[s];
+            uint16_t orig_len = car.sound_len[s];
             uint32_t newlen = 0;
             uint8_t *buf = reps[r].is_wav
                          ? load_wav(reps[r].path, &newlen)
@@ -268,19 +245,22 @@ int main(int argc, char *argv[]) {
                 free(buf);
                 continue;
             }
-            uint32_t off = audio_off;
-            for (int j = 0; j < s; ++j) off += hdr->sounds[j];
-            memcpy(car + off, buf, newlen);
+            free(bufs[s]);  // a later file for the same slot wins
+            bufs[s] = buf;
             printf("Replaced slot %d with %s\n", s, reps[r].path);
-            free(buf);
         }
-        FILE *o = fopen(out_path, "wb");
-        if (!o) { perror(out_path); free(car); return 1; }
-        fwrite(car, 1, file_size, o);
-        fclose(o);
+        // write the mapped original with the new slots spliced in
+        CARPatch patches[CAR_SOUNDS];
+        int pc = 0;
+        for (int s = 0; s < CAR_SOUNDS; ++s)
+            if (bufs[s])
+                patches[pc++] = (CARPatch){ (size_t)(car.sounds[s] - car.data), bufs[s], car.sound_len[s] };
+        int ok = car_write_patched(&car, out_path, patches, pc);
+        for (int s = 0; s < CAR_SOUNDS; ++s) free(bufs[s]);
+        if (!ok) { fprintf(stderr, "%s: %s\n", out_path, car.error); car_close(&car); return 1; }
         printf("Wrote updated car to %s\n", out_path);
     }
 
-    free(car);
+    car_close(&car);
     return 0;
 }
@@ -0,0 +1,205 @@
+// carfile.c - read-only, zero-copy .CAR model access (see include/carfile.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "carfile.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+static int fail(CARFile *car, const char *msg) {
+    car->error = msg;
+    return 0;
+}
+
+int car_view(CARFile *car, const uint8_t *data, size_t size) {
+    memset(car, 0, sizeof(*car));
+    car->data = data;
+    car->size = size;
+
+    if (size < CAR_TEXTURE_OFFSET) return fail(car, "file too small for a CAR header");
+    car->header = (const CARHeader*)data;
+
+    uint16_t counts[3];
+    memcpy(counts, data + CAR_COUNTS_OFFSET, sizeof(counts));
+    car->vertex_count  = counts[0];
+    car->polygon_count = counts[1];
+    car->texture_size  = counts[2];
+    if (car->polygon_count > CAR_MAX_POLYGONS) return fail(car, "polygon count out of range");
+    if (!car->vertex_count) return fail(car, "model has no vertices");
+
+    car->polygons = (const CARPolygon*)(data + CAR_POLYGON_OFFSET);
+    for (size_t i = 0; i < car->polygon_count; i++)
+        for (int v = 0; v < 3; v++)
+            if (car->polygons[i].vertices_indices[v] >= car->vertex_count)
+                return fail(car, "polygon references a missing vertex");
+
+    size_t tex_end = CAR_TEXTURE_OFFSET + car->texture_size;
+    if (tex_end > size) return fail(car, "texture runs past end of file");
+    car->texture    = data + CAR_TEXTURE_OFFSET;
+    car->tex_width  = CAR_TEX_WIDTH;
+    car->tex_height = (int)(car->texture_size / CAR_TEX_WIDTH);
+
+    size_t sound_total = 0;
+    for (int i = 0; i < CAR_SOUNDS; i++) sound_total += car->header->sounds[i];
+    if (sound_total > size - tex_end) return fail(car, "sound data overlaps texture");
+    car->sound_offset = size - sound_total;
+    size_t off = car->sound_offset;
+    for (int i = 0; i < CAR_SOUNDS; i++) {
+        car->sound_len[i] = car->header->sounds[i];
+        car->sounds[i]    = car->sound_len[i] ? data + off : NULL;
+        off += car->sound_len[i];
+    }
+
+    size_t frame_bytes = car->vertex_count * sizeof(CARVertex);
+    car->frames      = (const CARVertex*)(data + tex_end);
+    car->frame_count = (car->sound_offset - tex_end) / frame_bytes;
+
+    size_t first = 0;
+    for (int i = 0; i < CAR_ANIMS; i++) {
+        size_t n = car->header->animations[i] / frame_bytes;
+        if (first + n > car->frame_count) return fail(car, "animation runs past frame data");
+        car->anims[i].start = first;
+        car->anims[i].count = n;
+        first += n;
+    }
+    return 1;
+}
+
+int car_open(CARFile *car, const char *path) {
+    memset(car, 0, sizeof(*car));
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) return fail(car, "cannot open file");
+    LARGE_INTEGER sz;
+    if (!GetFileSizeEx(fh, &sz) || sz.QuadPart == 0) {
+        CloseHandle(fh);
+        return fail(car, "cannot read file size");
+    }
+    HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(fh);
+    if (!mh) return fail(car, "cannot map file");
+    const uint8_t *data = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mh);
+    if (!data) return fail(car, "cannot map file");
+    void *map = (void*)data;
+    size_t size = (size_t)sz.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return fail(car, "cannot open file");
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        return fail(car, "cannot read file size");
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return fail(car, "cannot map file");
+    void *map = data;
+    size_t size = (size_t)st.st_size;
+#endif
+    int ok = car_view(car, data, size);
+    car->map = map;
+    if (!ok) {
+        const char *err = car->error;
+        car_close(car);
+        car->error = err;
+        return 0;
+    }
+    return 1;
+}
+
+void car_close(CARFile *car) {
+    if (car->map) {
+#ifdef _WIN32
+        UnmapViewOfFile(car->map);
+#else
+        munmap(car->map, car->size);
+#endif
+    }
+    free(car->copy);
+    memset(car, 0, sizeof(*car));
+}
+
+#ifdef _WIN32
+// Windows won't replace a file while a view of it is mapped, and the output
+// may be the very file car was opened from: move car onto a heap copy
+static int car_detach(CARFile *car) {
+    if (!car->map) return 0;
+    uint8_t *copy = malloc(car->size);
+    if (!copy) return 0;
+    memcpy(copy, car->data, car->size);
+    UnmapViewOfFile(car->map);
+    car_view(car, copy, car->size);     // same bytes, so it validates again
+    car->copy = copy;
+    return 1;
+}
+#endif
+
+static int cmp_patch(const void *a, const void *b) {
+    const CARPatch *pa = a, *pb = b;
+    return pa->offset < pb->offset ? -1 : pa->offset > pb->offset;
+}
+
+int car_write_patched(CARFile *car, const char *path,
+                      const CARPatch *patches, int count) {
+    if (count < 0) return fail(car, "negative patch count");
+    CARPatch *sorted = malloc((count ? count : 1) * sizeof(CARPatch));
+    if (!sorted) return fail(car, "out of memory");
+    memcpy(sorted, patches, count * sizeof(CARPatch));
+    qsort(sorted, count, sizeof(CARPatch), cmp_patch);
+
+    size_t pos = 0;
+    for (int i = 0; i < count; i++) {
+        if (sorted[i].offset < pos || sorted[i].offset + sorted[i].len > car->size) {
+            free(sorted);
+            return fail(car, "patches overlap or run past the end of the file");
+        }
+        pos = sorted[i].offset + sorted[i].len;
+    }
+
+    // path may be the file car is mapped from, so never truncate it:
+    // write <path>.tmp and rename it over
+    char tmp[1024];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        free(sorted);
+        return fail(car, "output path too long");
+    }
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { free(sorted); return fail(car, strerror(errno)); }
+    errno = 0;
+    pos = 0;
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++) {
+        ok = fwrite(car->data + pos, 1, sorted[i].offset - pos, f) == sorted[i].offset - pos
+          && fwrite(sorted[i].data, 1, sorted[i].len, f) == sorted[i].len;
+        pos = sorted[i].offset + sorted[i].len;
+    }
+    if (ok) ok = fwrite(car->data + pos, 1, car->size - pos, f) == car->size - pos;
+    if (fclose(f)) ok = 0;
+    free(sorted);
+    if (!ok) {
+        const char *err = errno ? strerror(errno) : "write failed";
+        remove(tmp);
+        return fail(car, err);
+    }
+#ifdef _WIN32
+    if (remove(path) && errno != ENOENT && car_detach(car)) remove(path);
+#endif
+    if (rename(tmp, path)) {
+        const char *err = strerror(errno);
+        remove(tmp);
+        return fail(car, err);
+    }
+    return 1;
+}
@@ -4,8 +4,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "palquant.h"
+#include "dither.h"
+#include "carfile.h"
 
-#define TEXTURE_OFFSET 0x486c
 #define VERSION "1.1.0"
 
 // Function to load ACT palette file
@@ -43,29 +45,11 @@ int load_act_palette(const char* filename, unsigned char palette[256][3]) {
     return 256;
 }
 
-// Function to find closest color in palette
-int find_color_in_palette(unsigned char palette[256][3], unsigned char r, unsigned char g, unsigned char b) {
-    int closest = 0;
-    int min_dist = 255*255*3;
-    
-    for (int p = 0; p < 256; p++) {
-        int dr = r - palette[p][0];
-        int dg = g - palette[p][1];
-        int db = b - palette[p][2];
-        int dist = dr*dr + dg*dg + db*db;
-        
-        if (dist < min_dist) {
-            min_dist = dist;
-            closest = p;
-            if (min_dist == 0) break; // exact match
-        }
-    }
-    return closest;
-}
+static PalQuant quant;
 
 // Function to convert PNG to RAW with palette support
 unsigned char* png_to_raw(const char* png_filename, const char* palette_filename, 
-                         int* width, int* height, int* raw_size) {
+                         DitherMode dither, int* width, int* height, int* raw_size) {
     // Load image with alpha channel
     int channels;
     unsigned char *image = stbi_load(png_filename, width, height, &channels, STBI_rgb_alpha);
@@ -82,12 +66,12 @@ unsigned char* png_to_raw(const char* png_filename, const char* palette_filename
     
     if (palette_filename) {
         int colors_loaded = load_act_palette(palette_filename, palette);
-        if (colors_loaded > 0) {
+        if (colors_loaded > 0 && palquant_init(&quant, palette)) {
             use_palette = 1;
             printf("Loaded ACT palette with %d colors\n", colors_loaded);
             
             // Find #040404 in palette (RGB 4,4,4)
-            transparent_color_index = find_color_in_palette(palette, 4, 4, 4);
+            transparent_color_index = palquant_search(&quant, 4, 4, 4);
             printf("Using palette index %d for transparent pixels (RGB %d,%d,%d)\n",
                    transparent_color_index,
                    palette[transparent_color_index][0],
@@ -108,7 +92,23 @@ unsigned char* png_to_raw(const char* png_filename, const char* palette_filename
     }
 
     // Process image
-    for (int i = 0; i < *width * *height; i++) {
+    if (use_palette) {
+        // Closest palette colors, dithered; transparent pixels use #040404
+        DitherStream ds;
+        if (!dither_begin(&ds, &quant, dither, *width)) {
+            stbi_image_free(image);
+            free(raw_data);
+            palquant_free(&quant);
+            printf("Memory allocation error for dithering\n");
+            return NULL;
+        }
+        ds.alpha_cut = 255;
+        ds.clear     = (uint8_t)transparent_color_index;
+        for (int y = 0; y < *height; y++)
+            dither_row(&ds, image + (size_t)y * *width * 4, raw_data + (size_t)y * *width);
+        dither_end(&ds);
+    }
+    else for (int i = 0; i < *width * *height; i++) {
         unsigned char pixel;
         int alpha = channels == 4 ? image[i*channels + 3] : 255;
         
@@ -116,13 +116,6 @@ unsigned char* png_to_raw(const char* png_filename, const char* palette_filename
             // Transparent pixel - use #040404 from palette
             pixel = transparent_color_index;
         }
-        else if (use_palette) {
-            // Find closest palette color
-            int r = image[i*channels];
-            int g = channels > 1 ? image[i*channels+1] : r;
-            int b = channels > 2 ? image[i*channels+2] : r;
-            pixel = find_color_in_palette(palette, r, g, b);
-        }
         else if (channels >= 3) {
             // Grayscale conversion
             pixel = (unsigned char)(0.299f * image[i*channels] + 
@@ -137,57 +130,40 @@ unsigned char* png_to_raw(const char* png_filename, const char* palette_filename
     }
 
     stbi_image_free(image);
+    if (use_palette) palquant_free(&quant);
     return raw_data;
 }
 
 // Function to replace the texture data in CAR file
 void replace_texture(const char *car_filename, unsigned char *raw_data, long raw_size, const char *output_filename) {
-    // Open the car file (read mode)
-    FILE *car_file = fopen(car_filename, "rb");
-    if (car_file == NULL) {
-        perror("Error opening car file");
+    // Map the car file (read only, no copy)
+    CARFile car;
+    if (!car_open(&car, car_filename)) {
+        printf("Error opening car file %s: %s\n", car_filename, car.error);
         free(raw_data);
         exit(1);
     }
 
-    // Allocate buffer for the entire car file content
-    fseek(car_file, 0, SEEK_END);
-    long car_size = ftell(car_file);
-    fseek(car_file, 0, SEEK_SET);
-
-    unsigned char *car_data = (unsigned char *)malloc(car_size);
-    if (car_data == NULL) {
-        perror("Memory allocation error for car data");
+    if ((size_t)raw_size > car.texture_size) {
+        printf("Error: texture is %ld bytes but %s holds %zu (64x%d)\n",
+               raw_size, car_filename, car.texture_size, car.tex_height);
+        car_close(&car);
         free(raw_data);
-        fclose(car_file);
         exit(1);
     }
 
-    // Read the entire car file content into memory
-    fread(car_data, 1, car_size, car_file);
-    fclose(car_file);  // Close the car file after reading
-
-    // Replace the texture data in the car data at the specified offset
-    for (long i = 0; i < raw_size; i++) {
-        car_data[TEXTURE_OFFSET + i] = raw_data[i];
-    }
-
-    // Open the output file to write the modified content
-    FILE *output_file = fopen(output_filename, "wb");
-    if (output_file == NULL) {
-        perror("Error opening output file");
+    // Write the original file with the texture bytes swapped in
+    CARPatch patch = { CAR_TEXTURE_OFFSET, raw_data, (size_t)raw_size };
+    if (!car_write_patched(&car, output_filename, &patch, 1)) {
+        fprintf(stderr, "Error writing %s: %s\n", output_filename, car.error);
+        car_close(&car);
         free(raw_data);
-        free(car_data);
         exit(1);
     }
 
-    // Write the modified car data to the new file
-    fwrite(car_data, 1, car_size, output_file);
-
     // Clean up
-    fclose(output_file);
+    car_close(&car);
     free(raw_data);
-    free(car_data);
 }
 
 void show_help() {
@@ -200,6 +176,8 @@ void show_help() {
     printf("Options:\n");
     printf("  -palette <file.act>  Use specified ACT palette file for conversion\n");
     printf("  -output <file.car>   Specify output filename (default: output.car)\n");
+    printf("  -dither <mode>       none, fs, sierra, bayer4, bayer8, noise or atkinson\n");
+    printf("                       (default: none, needs -palette)\n");
     printf("  -help                Display this help message\n");
     printf("\n");
     printf("TIPS:\n");
@@ -225,6 +203,7 @@ int main(int argc, char *argv[]) {
     const char *png_filename = NULL;
     const char *palette_filename = NULL;
     const char *output_filename = "output.car";
+    DitherMode dither = DITHER_NONE;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -250,6 +229,15 @@ int main(int argc, char *argv[]) {
                 return 1;
             }
         }
+        else if (strcmp(argv[i], "-dither") == 0) {
+            int mode = i+1 < argc ? dither_parse(argv[++i]) : -1;
+            if (mode < 0) {
+                printf("Error: -dither option requires a mode\n");
+                show_help();
+                return 1;
+            }
+            dither = (DitherMode)mode;
+        }
         else if (!car_filename) {
             car_filename = argv[i];
         }
@@ -274,7 +262,7 @@ int main(int argc, char *argv[]) {
     if (car_filename && png_filename) {
         // Convert PNG to RAW
         int width, height, raw_size;
-        unsigned char *raw_data = png_to_raw(png_filename, palette_filename, &width, &height, &raw_size);
+        unsigned char *raw_data = png_to_raw(png_filename, palette_filename, dither, &width, &height, &raw_size);
         if (!raw_data) {
             return 1;
         }
@@ -1,12 +1,19 @@
-// x86_64-w64-mingw32-gcc source2.0FINAL.c -o carviewer.exe -Iinclude -Llib -lfreeglut -lopengl32 -lglu32 -lwinmm carviewer.res chasmpalette.o
+// x86_64-w64-mingw32-gcc source2.0FINAL.c ../carfile/carfile.c ../paltex/paltex.c ../palio/palio.c ../chasmpal/chasmpal.c ../filelist/filelist.c -o carviewer.exe -Iinclude -I../../include -Llib -lfreeglut -lglew32 -lopengl32 -lglu32 -lwinmm carviewer.res
+// carviewer.exe <model.car> | -gallery <dir|list.txt|file.car> [...]  [-palette <file>]
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <strings.h>
-#include <GL/gl.h>
+#include <math.h>
+#include <GL/glew.h>
 #include <GL/freeglut.h>
+#include "carfile.h"
+#include "paltex.h"
+#include "palio.h"
+#include "filelist.h"
+#include "chasmpal.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -15,38 +22,13 @@
 #endif
 
 #define SCALE (1.0f/2048.0f)
-#define TEX_WIDTH 64
 #define VOLUME_FACTOR 0.4f
 
-#pragma pack(push,1)
-typedef struct {
-    uint16_t animations[20];
-    uint16_t submodels_animations[3][2];
-    uint16_t unknown0[9];
-    uint16_t sounds[7];
-    uint16_t unknown1[9];
-} CARHeader;
-
-typedef struct {
-    uint16_t vertices_indices[4];
-    uint16_t uv[4][2];
-    uint8_t unknown0[4];
-    uint8_t group_id, flags;
-    uint16_t v_offset;
-} CARPolygon;
-
-typedef struct { int16_t xyz[3]; } Vertex;
-#pragma pack(pop)
-
-extern unsigned char _binary_chasmpalette_act_start[];
-extern unsigned char _binary_chasmpalette_act_end[];
-
-static uint8_t *rawData = NULL;
-static size_t rawSize = 0;
+static CARFile car;
 static uint8_t paletteRGB[256][3];
-static uint8_t *textureRGBA = NULL;
+static const uint8_t *paletteAlpha;     // chasmpal_alpha for the built-in palette
 static uint16_t texWidth, texHeight;
-static Vertex *animationFrames = NULL;
+static const CARVertex *animationFrames = NULL;
 static size_t vertexCount = 0, polygonCount = 0, frameCount = 0;
 static float animationTime = 0.0f, frameDuration = 0.1f;
 static int animating = 0;
@@ -55,8 +37,43 @@ typedef struct { size_t start, count; } AnimInfo;
 static AnimInfo anims[20];
 static int animCount = 0, currentAnim = 0;
 static size_t animFrameIdx = 0;
-static CARPolygon *polygons = NULL;
-static GLuint texID;
+static const CARPolygon *polygons = NULL;
+static PalTex skin;                     // index map, palette looked up on the GPU
+
+// mesh topology and UVs are baked once; only positions change per frame
+static GLuint vboUV, vboPos, iboMesh;
+static GLsizei meshIndexCount = 0;
+static uint16_t *cornerVertex = NULL;   // model vertex behind each baked corner
+static size_t cornerCount = 0;
+static float *framePos = NULL;          // interpolated model vertices
+static float *cornerPos = NULL;         // per-corner positions for upload
+static size_t lastF0 = (size_t)-1, lastF1 = (size_t)-1;
+static float lastAlpha = -1.0f;
+
+// with GLSL every frame is uploaded once and the shader does the lerp;
+// the CPU path above is only the fallback for pre-2.0 drivers
+static int gpuLerp = 0;
+static GLuint progLerp, vboFrames;
+static GLint uAlpha;
+
+static const char *lerpVS =
+    "#version 110\n"
+    "uniform float alpha;\n"
+    "uniform float scale;\n"
+    "attribute vec3 pos0;\n"
+    "attribute vec3 pos1;\n"
+    "void main(){\n"
+    "    vec3 p = mix(pos0, pos1, alpha) * scale;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "}\n";
+static const char *lerpFS =
+    "#version 110\n"
+    PALTEX_GLSL
+    "void main(){\n"
+    "    gl_FragColor = paltex(gl_TexCoord[0].st) * gl_Color;\n"
+    "}\n";
 
 static float bgColor[3] = {0.2f,0.2f,0.3f};
 static int initBgPaletteIndex=0, currentBgPaletteIndex=0;
@@ -76,77 +93,67 @@ static int endswith(const char *s, const char *suffix) {
     return (sl>=su && strcasecmp(s+sl-su, suffix)==0);
 }
 
-void load_palette_embedded(void) {
-    unsigned char *p = _binary_chasmpalette_act_start;
-    size_t len = _binary_chasmpalette_act_end - p;
-    if (len != 256*3) { fprintf(stderr,"Bad palette\n"); exit(1); }
-    for (int i = 0; i < 256; i++) {
-        paletteRGB[i][0]=p[3*i+0];
-        paletteRGB[i][1]=p[3*i+1];
-        paletteRGB[i][2]=p[3*i+2];
-    }
+// built-in palette unless -palette names a file
+void load_palette(const char *path) {
+    Palette pal;
+    if (!palio_load(path, &pal)) { fprintf(stderr,"Bad palette %s\n",path); exit(1); }
+    memcpy(paletteRGB, pal.rgb, sizeof(paletteRGB));
+    paletteAlpha = path ? NULL : chasmpal_alpha;
 }
 
-void load_car_model(const char *fn) {
-    FILE *f = fopen(fn,"rb");
-    if (!f) { perror(fn); exit(1); }
-    fseek(f,0,SEEK_END); rawSize=ftell(f); fseek(f,0,SEEK_SET);
-    rawData=malloc(rawSize); fread(rawData,1,rawSize,f); fclose(f);
-
-    vertexCount  = *(uint16_t*)(rawData+0x4866);
-    polygonCount = *(uint16_t*)(rawData+0x4868);
-    uint16_t texels = *(uint16_t*)(rawData+0x486A);
-    texWidth=TEX_WIDTH; texHeight=texels/TEX_WIDTH;
-
-    size_t texOffset=0x486C;
-    uint8_t *indices=rawData+texOffset;
-    textureRGBA=malloc(texWidth*texHeight*4);
-    for(size_t i=0;i<texWidth*texHeight;i++){
-        uint8_t idx=indices[i];
-        textureRGBA[4*i+0]=paletteRGB[idx][0];
-        textureRGBA[4*i+1]=paletteRGB[idx][1];
-        textureRGBA[4*i+2]=paletteRGB[idx][2];
-        textureRGBA[4*i+3]=(paletteRGB[idx][0]==4 && paletteRGB[idx][1]==4 && paletteRGB[idx][2]==4)?0:255;
-    }
-    glGenTextures(1,&texID);
-    glBindTexture(GL_TEXTURE_2D,texID);
-    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,texWidth,texHeight,0,GL_RGBA,GL_UNSIGNED_BYTE,textureRGBA);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-
-    uint8_t *fd = rawData + texOffset + texels;
-    frameCount = (rawSize - (fd - rawData)) / (vertexCount*sizeof(Vertex));
-    animationFrames = (Vertex*)fd;
-
-    CARHeader *hdr=(CARHeader*)rawData;
-    size_t off=0; animCount=0;
-    for(int i=0;i<20;i++){
-        uint16_t b=hdr->animations[i];
-        if(b){
-            size_t n=b/(vertexCount*sizeof(Vertex));
-            anims[animCount].start=off;
-            anims[animCount].count=n;
-            off+=n; animCount++;
-        }
-    }
-    if(!animCount){ anims[0].start=0; anims[0].count=frameCount; animCount=1; }
-    currentAnim=0; animFrameIdx=0;
-
-    polygons=(CARPolygon*)(rawData+0x66);
+// #040404 entries are see-through
+void upload_palette(void) {
+    if (paletteAlpha) { paltex_palette(paletteRGB, paletteAlpha); return; }
+    uint8_t alpha[256];
+    for (int i = 0; i < 256; i++)
+        alpha[i]=(paletteRGB[i][0]==4 && paletteRGB[i][1]==4 && paletteRGB[i][2]==4)?0:255;
+    paltex_palette(paletteRGB, alpha);
+}
 
-    // choose background color
-    int counts[256]={0};
-    for(size_t i=0;i<texWidth*texHeight;i++){
-        uint8_t idx=indices[i];
+// background = the most common not-too-dark entry of the skin(s)
+void pick_background(const uint8_t *tex,size_t n){
+    size_t counts[256]={0};
+    for(size_t i=0;i<n;i++){
+        uint8_t idx=tex[i];
         float b=(paletteRGB[idx][0]+paletteRGB[idx][1]+paletteRGB[idx][2])/(3.0f*255.0f);
         if(b>0.2f) counts[idx]++;
     }
-    int best=0,bc=0;
+    int best=0; size_t bc=0;
     for(int i=0;i<256;i++) if(counts[i]>bc){ bc=counts[i]; best=i; }
     initBgPaletteIndex=currentBgPaletteIndex=best;
     bgColor[0]=paletteRGB[best][0]/255.0f;
     bgColor[1]=paletteRGB[best][1]/255.0f;
     bgColor[2]=paletteRGB[best][2]/255.0f;
+}
+
+void load_car_model(const char *fn) {
+    if (!car_open(&car,fn)) { fprintf(stderr,"%s: %s\n",fn,car.error); exit(1); }
+
+    vertexCount  = car.vertex_count;
+    polygonCount = car.polygon_count;
+    texWidth=car.tex_width; texHeight=car.tex_height;
+
+    if(!paltex_create(&skin,car.texture,texWidth,texHeight)){
+        fprintf(stderr,"%s: out of memory\n",fn); exit(1);
+    }
+
+    frameCount = car.frame_count;
+    animationFrames = car.frames;
+
+    animCount=0;
+    for(int i=0;i<CAR_ANIMS;i++){
+        if(car.header->animations[i]){
+            anims[animCount].start=car.anims[i].start;
+            anims[animCount].count=car.anims[i].count;
+            animCount++;
+        }
+    }
+    if(!animCount){ anims[0].start=0; anims[0].count=frameCount; animCount=1; }
+    currentAnim=0; animFrameIdx=0;
+
+    polygons=car.polygons;
+
+    pick_background(car.texture,(size_t)texWidth*texHeight);
 
     // center model
     float minX=1e9f,minY=1e9f,minZ=1e9f;
@@ -164,10 +171,8 @@ void load_car_model(const char *fn) {
     modelCenterZ=(minZ+maxZ)*0.5f;
 
     // build WAV buffers and apply volume factor
-    uint32_t totalBytes=0; for(int b=0;b<7;b++) totalBytes+=hdr->sounds[b];
-    long audio_off=rawSize-totalBytes, pos=audio_off;
-    for(int b=0;b<7;b++){
-        uint16_t len=hdr->sounds[b];
+    for(int b=0;b<CAR_SOUNDS;b++){
+        uint16_t len=car.sound_len[b];
         if(len){
             uint32_t ws=44+len;
             uint8_t *buf=malloc(ws);
@@ -183,7 +188,7 @@ void load_car_model(const char *fn) {
             memcpy(buf+36,"data",4);
             uint32_t dlen=len;   memcpy(buf+40,&dlen,4);
             for(int i=0;i<len;i++){
-                uint8_t s = rawData[pos+i];
+                uint8_t s = car.sounds[b][i];
                 float centered = (float)s - 128.0f;
                 centered *= VOLUME_FACTOR;
                 int ns = (int)(centered + 128.0f);
@@ -193,10 +198,161 @@ void load_car_model(const char *fn) {
             wavBuffers[b]=buf;
             wavBufferLens[b]=ws;
         }
-        pos+=len;
     }
 }
 
+// split quads into corners with their own UVs (0..1 over the skin);
+// indices start at base.  Returns the corner count, *ni the index count.
+// Buffers need room for polygon_count*4 corners and *6 indices.
+size_t bake_corners(const CARFile *c,GLuint base,uint16_t *cv,float *uv,GLuint *idx,size_t *ni){
+    size_t nc=0;
+    *ni=0;
+    for(size_t i=0;i<c->polygon_count;i++){
+        const CARPolygon *p=&c->polygons[i];
+        int n=(p->vertices_indices[3]<c->vertex_count)?4:3;
+        GLuint k=(GLuint)nc;
+        for(int v=0;v<n;v++){
+            cv[k+v]=p->vertices_indices[v];
+            uv[2*(k+v)+0]=p->uv[v][0]/(float)(c->tex_width<<8);
+            uv[2*(k+v)+1]=(p->uv[v][1]+4*p->v_offset)/(float)(c->tex_height<<8);
+        }
+        idx[(*ni)++]=base+k; idx[(*ni)++]=base+k+1; idx[(*ni)++]=base+k+2;
+        if(n==4){ idx[(*ni)++]=base+k; idx[(*ni)++]=base+k+2; idx[(*ni)++]=base+k+3; }
+        nc+=n;
+    }
+    return nc;
+}
+
+// split quads, scale UVs and upload topology once
+void build_mesh_buffers(void){
+    cornerVertex=malloc(polygonCount*4*sizeof(uint16_t));
+    float *uv=malloc(polygonCount*4*2*sizeof(float));
+    GLuint *idx=malloc(polygonCount*6*sizeof(GLuint));
+    size_t ni;
+    cornerCount=bake_corners(&car,0,cornerVertex,uv,idx,&ni);
+    meshIndexCount=(GLsizei)ni;
+    framePos=malloc(vertexCount*3*sizeof(float));
+    cornerPos=malloc(cornerCount*3*sizeof(float));
+
+    glGenBuffers(1,&vboUV);
+    glBindBuffer(GL_ARRAY_BUFFER,vboUV);
+    glBufferData(GL_ARRAY_BUFFER,cornerCount*2*sizeof(float),uv,GL_STATIC_DRAW);
+    glGenBuffers(1,&vboPos);
+    glBindBuffer(GL_ARRAY_BUFFER,vboPos);
+    glBufferData(GL_ARRAY_BUFFER,cornerCount*3*sizeof(float),NULL,GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glGenBuffers(1,&iboMesh);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,iboMesh);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,ni*sizeof(GLuint),idx,GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    free(uv); free(idx);
+}
+
+// lerp the model vertices and stream them; skipped while nothing moves
+void update_mesh_positions(size_t f0,size_t f1,float alpha){
+    if(f0==lastF0 && f1==lastF1 && alpha==lastAlpha) return;
+    lastF0=f0; lastF1=f1; lastAlpha=alpha;
+    const CARVertex *v0=animationFrames+f0*vertexCount;
+    const CARVertex *v1=animationFrames+f1*vertexCount;
+    for(size_t i=0;i<vertexCount;i++)
+        for(int c=0;c<3;c++)
+            framePos[3*i+c]=((1-alpha)*v0[i].xyz[c]+alpha*v1[i].xyz[c])*SCALE;
+    for(size_t i=0;i<cornerCount;i++)
+        memcpy(cornerPos+3*i,framePos+3*cornerVertex[i],3*sizeof(float));
+    glBindBuffer(GL_ARRAY_BUFFER,vboPos);
+    glBufferData(GL_ARRAY_BUFFER,cornerCount*3*sizeof(float),NULL,GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER,0,cornerCount*3*sizeof(float),cornerPos);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+}
+
+static GLuint compile_shader(GLenum type,const char *src){
+    GLuint s=glCreateShader(type);
+    glShaderSource(s,1,&src,NULL);
+    glCompileShader(s);
+    GLint ok=0; glGetShaderiv(s,GL_COMPILE_STATUS,&ok);
+    if(!ok){
+        char log[512]; glGetShaderInfoLog(s,sizeof(log),NULL,log);
+        fprintf(stderr,"Shader compile failed: %s\n",log);
+        glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+// upload every animation frame per baked corner (int16, unscaled) and
+// build the lerp program; returns 0 to fall back to the CPU path
+int build_frame_buffers(void){
+    if(!paltex_active() || !frameCount) return 0;
+    GLuint vs=compile_shader(GL_VERTEX_SHADER,lerpVS);
+    GLuint fs=compile_shader(GL_FRAGMENT_SHADER,lerpFS);
+    if(!vs || !fs){ glDeleteShader(vs); glDeleteShader(fs); return 0; }
+    progLerp=glCreateProgram();
+    glAttachShader(progLerp,vs); glAttachShader(progLerp,fs);
+    glBindAttribLocation(progLerp,0,"pos0");
+    glBindAttribLocation(progLerp,1,"pos1");
+    glLinkProgram(progLerp);
+    glDeleteShader(vs); glDeleteShader(fs);
+    GLint ok=0; glGetProgramiv(progLerp,GL_LINK_STATUS,&ok);
+    if(!ok){ glDeleteProgram(progLerp); progLerp=0; return 0; }
+
+    CARVertex *corners=malloc(frameCount*cornerCount*sizeof(CARVertex));
+    if(!corners){ glDeleteProgram(progLerp); progLerp=0; return 0; }
+    for(size_t f=0;f<frameCount;f++){
+        const CARVertex *src=animationFrames+f*vertexCount;
+        CARVertex *dst=corners+f*cornerCount;
+        for(size_t i=0;i<cornerCount;i++) dst[i]=src[cornerVertex[i]];
+    }
+    glGenBuffers(1,&vboFrames);
+    glBindBuffer(GL_ARRAY_BUFFER,vboFrames);
+    glBufferData(GL_ARRAY_BUFFER,frameCount*cornerCount*sizeof(CARVertex),corners,GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    free(corners);
+
+    glUseProgram(progLerp);
+    glUniform1f(glGetUniformLocation(progLerp,"scale"),SCALE);
+    uAlpha=glGetUniformLocation(progLerp,"alpha");
+    glUseProgram(0);
+    return 1;
+}
+
+// per-frame cost is two attribute offsets and a uniform
+void draw_mesh_lerp(size_t f0,size_t f1,float alpha){
+    size_t frameBytes=cornerCount*sizeof(CARVertex);
+    glUseProgram(progLerp);
+    glUniform1f(uAlpha,alpha);
+    glBindBuffer(GL_ARRAY_BUFFER,vboFrames);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0,3,GL_SHORT,GL_FALSE,0,(void*)(f0*frameBytes));
+    glVertexAttribPointer(1,3,GL_SHORT,GL_FALSE,0,(void*)(f1*frameBytes));
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,vboUV);
+    glTexCoordPointer(2,GL_FLOAT,0,(void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,iboMesh);
+    glDrawElements(GL_TRIANGLES,meshIndexCount,GL_UNSIGNED_INT,(void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableVertexAttribArray(1);
+    glDisableVertexAttribArray(0);
+    glUseProgram(0);
+}
+
+void draw_mesh(void){
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,vboPos);
+    glVertexPointer(3,GL_FLOAT,0,(void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER,vboUV);
+    glTexCoordPointer(2,GL_FLOAT,0,(void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,iboMesh);
+    glDrawElements(GL_TRIANGLES,meshIndexCount,GL_UNSIGNED_INT,(void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 void drawBitmapString(float x,float y,void*font,const char*s){
     glRasterPos2f(x,y);
     while(*s) glutBitmapCharacter(font,*s++);
@@ -242,7 +398,7 @@ void drawModelInfo(){
     buf[0]=0; strcat(buf,"Animations: ");
     first=1;
     for(int i=0;i<20;i++){
-        if(((CARHeader*)rawData)->animations[i]){
+        if(car.header->animations[i]){
             char n[8]; sprintf(n,"%s%d",first?"":"",i);
             if(!first) strcat(buf,",");
             strcat(buf,n);
@@ -254,7 +410,7 @@ void drawModelInfo(){
     buf[0]=0; strcat(buf,"Sounds: ");
     first=1;
     for(int i=0;i<7;i++){
-        if(((CARHeader*)rawData)->sounds[i]){
+        if(car.header->sounds[i]){
             char n[8]; sprintf(n,"%s%d",first?"":"",i);
             if(!first) strcat(buf,",");
             strcat(buf,n);
@@ -282,35 +438,15 @@ void display(void){
     size_t f0=anims[currentAnim].start+animFrameIdx;
     size_t f1=anims[currentAnim].start+((animFrameIdx+1)%anims[currentAnim].count);
 
-    glBindTexture(GL_TEXTURE_2D,texID);
-    glBegin(GL_TRIANGLES);
-    for(size_t i=0;i<polygonCount;i++){
-        CARPolygon *p=&polygons[i];
-        for(int v=0;v<3;v++){
-            int vi=p->vertices_indices[v];
-            int16_t *pv0=animationFrames[f0*vertexCount+vi].xyz;
-            int16_t *pv1=animationFrames[f1*vertexCount+vi].xyz;
-            float x=(1-alpha)*pv0[0]+alpha*pv1[0];
-            float y=(1-alpha)*pv0[1]+alpha*pv1[1];
-            float z=(1-alpha)*pv0[2]+alpha*pv1[2];
-            glTexCoord2f(p->uv[v][0]/(float)(texWidth<<8),(p->uv[v][1]+4*p->v_offset)/(float)(texHeight<<8));
-            glVertex3f(x*SCALE,y*SCALE,z*SCALE);
-        }
-        if(p->vertices_indices[3]<(int)vertexCount){
-            int ord[3]={0,2,3};
-            for(int v=0;v<3;v++){
-                int vi=p->vertices_indices[ord[v]];
-                int16_t *pv0=animationFrames[f0*vertexCount+vi].xyz;
-                int16_t *pv1=animationFrames[f1*vertexCount+vi].xyz;
-                float x=(1-alpha)*pv0[0]+alpha*pv1[0];
-                float y=(1-alpha)*pv0[1]+alpha*pv1[1];
-                float z=(1-alpha)*pv0[2]+alpha*pv1[2];
-                glTexCoord2f(p->uv[ord[v]][0]/(float)(texWidth<<8),(p->uv[ord[v]][1]+4*p->v_offset)/(float)(texHeight<<8));
-                glVertex3f(x*SCALE,y*SCALE,z*SCALE);
-            }
-        }
+    if(gpuLerp){
+        paltex_bind_program(&skin,progLerp);
+        draw_mesh_lerp(f0,f1,alpha);
+    } else {
+        paltex_bind(&skin);
+        update_mesh_positions(f0,f1,alpha);
+        draw_mesh();
+        paltex_unbind();
     }
-    glEnd();
 
     if(overlayEnabled){
         drawOverlay();
@@ -399,9 +535,7 @@ void keyboard(unsigned char k,int x,int y){
         break;
       case 'f':
         linearFiltering=!linearFiltering;
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linearFiltering?GL_LINEAR:GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linearFiltering?GL_LINEAR:GL_NEAREST);
+        paltex_filter(&skin, linearFiltering);
         break;
       case '1': if(animCount>=1){currentAnim=0;animFrameIdx=0;animationTime=0;} break;
       case '2': if(animCount>=2){currentAnim=1;animFrameIdx=0;animationTime=0;} break;
@@ -422,6 +556,467 @@ void keyboard(unsigned char k,int x,int y){
     }
 }
 
+//―――― Gallery mode ――――――――――――――――――――――――――――
+// -gallery <dir|list.txt|file.car> [...] puts every model on one grid, all
+// playing the same animation slot.  Each model keeps its own CARFile and
+// animation table, but the meshes share one index, UV and placement
+// buffer, the skins are packed into one index atlas, and the frame pair
+// of every model is restaged into one stream buffer only when the frame
+// tick advances.  The shader lerps, centres, scales and places each
+// corner, so the whole roster is one glDrawElements (plus the labels).
+
+#define GALLERY_FIT     0.45f   // model radius inside its 1x1 cell
+#define GALLERY_PAD     1       // replicated edge around each atlas skin
+
+typedef struct {
+    CARFile   car;
+    char      name[64];
+    AnimInfo  anims[CAR_ANIMS];
+    int       animCount;
+    uint16_t *cornerVertex;             // model vertex behind each corner
+    size_t    cornerBase, cornerCount;  // range in the shared buffers
+    float     center[3], fit;
+    int       atlasX, atlasY;           // skin origin in the atlas
+} GalleryModel;
+
+static GalleryModel *gallery = NULL;
+static size_t galleryCount = 0, galleryCorners = 0;
+static int galleryCols = 1, galleryRows = 1, galleryAnim = 0, galleryAnimSlots = 1;
+static float galleryDistance = 3.0f;
+static PalTex atlas;
+static int atlasW, atlasH;
+static GLuint galVboUV, galVboPlace, galVboStream, galIbo;
+static GLsizei galIndexCount = 0;
+static float *galPlace = NULL;      // centre, fit and cell x/y per corner
+static void *galStream = NULL;      // int16 frame pairs (GPU) or placed floats (CPU)
+static size_t galleryTick = 0, galStagedTick = (size_t)-1;
+static int galStagedAnim = -1;
+
+// NVIDIA aliases generic slots 2/3 to gl_Normal/gl_Color (and the shader
+// reads gl_Color), so the per-corner placement goes to free slots
+#define ATTR_PLACE 6
+#define ATTR_CELL  7
+
+static int galleryGpu = 0;
+static GLuint progGallery;
+static GLint uGalAlpha, uGalRot;
+
+static const char *galleryVS =
+    "#version 110\n"
+    "uniform float alpha;\n"
+    "uniform float scale;\n"
+    "uniform mat3 rot;\n"
+    "attribute vec3 pos0;\n"
+    "attribute vec3 pos1;\n"
+    "attribute vec4 place;\n"     // model centre, fit
+    "attribute vec2 cell;\n"
+    "void main(){\n"
+    "    vec3 p = (mix(pos0, pos1, alpha) * scale - place.xyz) * place.w;\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(rot * p + vec3(cell, 0.0), 1.0);\n"
+    "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "}\n";
+
+static int gallery_cmp(const void *a,const void *b){
+    return strcasecmp(*(char*const*)a,*(char*const*)b);
+}
+
+// open every model; unreadable ones are reported and skipped
+static int gallery_load(int argc,char **argv){
+    FileList files={0};
+    for(int i=2;i<argc;i++){
+        if(!filelist_add_arg(&files,argv[i],".car")){
+            fprintf(stderr,"Out of memory\n");
+            filelist_free(&files);
+            return 0;
+        }
+    }
+    char **paths=files.path;
+    size_t n=files.count;
+    if(n) qsort(paths,n,sizeof(char*),gallery_cmp);
+
+    gallery=calloc(n?n:1,sizeof(GalleryModel));
+    if(!gallery){
+        fprintf(stderr,"Out of memory\n");
+        filelist_free(&files);
+        return 0;
+    }
+    for(size_t i=0;i<n;i++){
+        GalleryModel *m=&gallery[galleryCount];
+        if(!car_open(&m->car,paths[i])){
+            fprintf(stderr,"%s: %s\n",paths[i],m->car.error);
+            continue;
+        }
+        if(!m->car.frame_count || !m->car.polygon_count){
+            fprintf(stderr,"%s: no frames or polygons, skipped\n",paths[i]);
+            car_close(&m->car);
+            continue;
+        }
+        const char *b=strrchr(paths[i],'/'), *b2=strrchr(paths[i],'\\');
+        if(b2>b) b=b2;
+        snprintf(m->name,sizeof(m->name),"%s",b?b+1:paths[i]);
+
+        for(int a=0;a<CAR_ANIMS;a++){
+            if(m->car.header->animations[a] && m->car.anims[a].count){
+                m->anims[m->animCount].start=m->car.anims[a].start;
+                m->anims[m->animCount].count=m->car.anims[a].count;
+                m->animCount++;
+            }
+        }
+        if(!m->animCount){ m->anims[0].start=0; m->anims[0].count=m->car.frame_count; m->animCount=1; }
+        if(m->animCount>galleryAnimSlots) galleryAnimSlots=m->animCount;
+
+        // centre and size from the first frame
+        float lo[3]={1e9f,1e9f,1e9f}, hi[3]={-1e9f,-1e9f,-1e9f};
+        for(size_t v=0;v<m->car.vertex_count;v++)
+            for(int c=0;c<3;c++){
+                float x=m->car.frames[v].xyz[c]*SCALE;
+                if(x<lo[c]) lo[c]=x;
+                if(x>hi[c]) hi[c]=x;
+            }
+        float r=0;
+        for(int c=0;c<3;c++){
+            m->center[c]=(lo[c]+hi[c])*0.5f;
+            if(hi[c]-lo[c]>r) r=hi[c]-lo[c];
+        }
+        m->fit=r>0?GALLERY_FIT/(r*0.5f):1.0f;
+        galleryCount++;
+    }
+    filelist_free(&files);
+    if(!galleryCount){ fprintf(stderr,"No readable .car files\n"); return 0; }
+
+    galleryCols=(int)ceil(sqrt((double)galleryCount));
+    galleryRows=(int)((galleryCount+galleryCols-1)/galleryCols);
+    // far enough back for the whole grid to fit the 45 degree view
+    int span=galleryCols>galleryRows?galleryCols:galleryRows;
+    galleryDistance=(span*0.5f+0.25f)/0.4142f+0.5f;
+    return 1;
+}
+
+// skins go into columns of CAR_TEX_WIDTH (+ padding), each into the
+// shortest column so far; the column count is grown until the atlas fits
+static int gallery_build_atlas(void){
+    GLint maxTex=2048;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE,&maxTex);
+    const int cw=CAR_TEX_WIDTH+2*GALLERY_PAD;
+    size_t total=0;
+    for(size_t i=0;i<galleryCount;i++) total+=gallery[i].car.tex_height+2*GALLERY_PAD;
+
+    int cols=(int)ceil(sqrt((double)total/cw));
+    if(cols<1) cols=1;
+    int *colH=NULL;
+    for(;;cols++){
+        if(cols*cw>maxTex){
+            fprintf(stderr,"Gallery skins don't fit a %dx%d atlas\n",maxTex,maxTex);
+            free(colH);
+            return 0;
+        }
+        int *grown=realloc(colH,cols*sizeof(int));
+        if(!grown){ free(colH); return 0; }
+        colH=grown;
+        memset(colH,0,cols*sizeof(int));
+        int h=0;
+        for(size_t i=0;i<galleryCount;i++){
+            int c=0;
+            for(int k=1;k<cols;k++) if(colH[k]<colH[c]) c=k;
+            gallery[i].atlasX=c*cw+GALLERY_PAD;
+            gallery[i].atlasY=colH[c]+GALLERY_PAD;
+            colH[c]+=gallery[i].car.tex_height+2*GALLERY_PAD;
+            if(colH[c]>h) h=colH[c];
+        }
+        if(h<=maxTex){ atlasW=cols*cw; atlasH=h; break; }
+    }
+    free(colH);
+
+    uint8_t *idx=calloc((size_t)atlasW*atlasH,1);
+    if(!idx) return 0;
+    for(size_t i=0;i<galleryCount;i++){
+        const GalleryModel *m=&gallery[i];
+        int w=m->car.tex_width, h=m->car.tex_height;
+        // copy with the border rows/columns repeated into the padding,
+        // so filtering at a skin edge never reaches the neighbour
+        for(int y=-GALLERY_PAD;y<h+GALLERY_PAD;y++){
+            int sy=y<0?0:(y>=h?h-1:y);
+            uint8_t *row=idx+(size_t)(m->atlasY+y)*atlasW+m->atlasX;
+            const uint8_t *src=m->car.texture+(size_t)sy*w;
+            memcpy(row,src,w);
+            for(int p=1;p<=GALLERY_PAD;p++){ row[-p]=src[0]; row[w-1+p]=src[w-1]; }
+        }
+    }
+    pick_background(idx,(size_t)atlasW*atlasH);
+    int ok=paltex_create(&atlas,idx,atlasW,atlasH);
+    free(idx);
+    return ok;
+}
+
+// per-corner atlas UVs, placement and the one index buffer
+static int gallery_build_buffers(void){
+    size_t maxCorners=0, maxIdx=0;
+    for(size_t i=0;i<galleryCount;i++){
+        maxCorners+=gallery[i].car.polygon_count*4;
+        maxIdx+=gallery[i].car.polygon_count*6;
+    }
+    float *uv=malloc(maxCorners*2*sizeof(float));
+    GLuint *idx=malloc(maxIdx*sizeof(GLuint));
+    galPlace=malloc(maxCorners*6*sizeof(float));
+    if(!uv || !idx || !galPlace) goto fail;
+
+    size_t nc=0, ni=0;
+    for(size_t i=0;i<galleryCount;i++){
+        GalleryModel *m=&gallery[i];
+        m->cornerVertex=malloc(m->car.polygon_count*4*sizeof(uint16_t));
+        if(!m->cornerVertex) goto fail;
+        size_t mi;
+        m->cornerBase=nc;
+        m->cornerCount=bake_corners(&m->car,(GLuint)nc,m->cornerVertex,uv+2*nc,idx+ni,&mi);
+        float cx=(float)(i%galleryCols)-(galleryCols-1)*0.5f;
+        float cy=(galleryRows-1)*0.5f-(float)(i/galleryCols);
+        for(size_t k=nc;k<nc+m->cornerCount;k++){
+            // skin UVs into the atlas; paltex clamps to edge, so do the same
+            for(int c=0;c<2;c++){
+                float t=uv[2*k+c]<0?0:(uv[2*k+c]>1?1:uv[2*k+c]);
+                uv[2*k+c]=c==0?(m->atlasX+t*m->car.tex_width)/(float)atlasW
+                              :(m->atlasY+t*m->car.tex_height)/(float)atlasH;
+            }
+            float *pl=galPlace+6*k;
+            pl[0]=m->center[0]; pl[1]=m->center[1]; pl[2]=m->center[2];
+            pl[3]=m->fit; pl[4]=cx; pl[5]=cy;
+        }
+        nc+=m->cornerCount;
+        ni+=mi;
+    }
+    galleryCorners=nc;
+    galIndexCount=(GLsizei)ni;
+    // frame pairs as int16 (GPU) or placed floats (CPU), whichever is larger
+    galStream=malloc(nc*6*sizeof(float));
+    if(!galStream) goto fail;
+
+    glGenBuffers(1,&galVboUV);
+    glBindBuffer(GL_ARRAY_BUFFER,galVboUV);
+    glBufferData(GL_ARRAY_BUFFER,nc*2*sizeof(float),uv,GL_STATIC_DRAW);
+    glGenBuffers(1,&galVboPlace);
+    glBindBuffer(GL_ARRAY_BUFFER,galVboPlace);
+    glBufferData(GL_ARRAY_BUFFER,nc*6*sizeof(float),galPlace,GL_STATIC_DRAW);
+    glGenBuffers(1,&galVboStream);
+    glBindBuffer(GL_ARRAY_BUFFER,galVboStream);
+    glBufferData(GL_ARRAY_BUFFER,nc*6*sizeof(float),NULL,GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    glGenBuffers(1,&galIbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,galIbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,ni*sizeof(GLuint),idx,GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    free(uv); free(idx);
+    return 1;
+fail:
+    free(uv); free(idx);
+    free(galPlace); galPlace=NULL;
+    return 0;
+}
+
+static int gallery_build_program(void){
+    if(!paltex_active()) return 0;
+    GLuint vs=compile_shader(GL_VERTEX_SHADER,galleryVS);
+    GLuint fs=compile_shader(GL_FRAGMENT_SHADER,lerpFS);
+    if(!vs || !fs){ glDeleteShader(vs); glDeleteShader(fs); return 0; }
+    progGallery=glCreateProgram();
+    glAttachShader(progGallery,vs); glAttachShader(progGallery,fs);
+    glBindAttribLocation(progGallery,0,"pos0");
+    glBindAttribLocation(progGallery,1,"pos1");
+    glBindAttribLocation(progGallery,ATTR_PLACE,"place");
+    glBindAttribLocation(progGallery,ATTR_CELL,"cell");
+    glLinkProgram(progGallery);
+    glDeleteShader(vs); glDeleteShader(fs);
+    GLint ok=0; glGetProgramiv(progGallery,GL_LINK_STATUS,&ok);
+    if(!ok){ glDeleteProgram(progGallery); progGallery=0; return 0; }
+    glUseProgram(progGallery);
+    glUniform1f(glGetUniformLocation(progGallery,"scale"),SCALE);
+    uGalAlpha=glGetUniformLocation(progGallery,"alpha");
+    uGalRot=glGetUniformLocation(progGallery,"rot");
+    glUseProgram(0);
+    return 1;
+}
+
+// the two frames model m shows at the current tick
+static void gallery_frames(const GalleryModel *m,const CARVertex **v0,const CARVertex **v1){
+    const AnimInfo *a=&m->anims[galleryAnim%m->animCount];
+    size_t f0=a->start+galleryTick%a->count;
+    size_t f1=a->start+(galleryTick+1)%a->count;
+    *v0=m->car.frames+f0*m->car.vertex_count;
+    *v1=m->car.frames+f1*m->car.vertex_count;
+}
+
+// GPU path: restage every model's frame pair once per tick
+static void gallery_stage(void){
+    if(galleryTick==galStagedTick && galleryAnim==galStagedAnim) return;
+    galStagedTick=galleryTick; galStagedAnim=galleryAnim;
+    int16_t *s=galStream;
+    for(size_t i=0;i<galleryCount;i++){
+        const GalleryModel *m=&gallery[i];
+        const CARVertex *v0,*v1;
+        gallery_frames(m,&v0,&v1);
+        int16_t *d=s+6*m->cornerBase;
+        for(size_t k=0;k<m->cornerCount;k++,d+=6){
+            memcpy(d,  v0[m->cornerVertex[k]].xyz,6);
+            memcpy(d+3,v1[m->cornerVertex[k]].xyz,6);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER,galVboStream);
+    glBufferData(GL_ARRAY_BUFFER,galleryCorners*6*sizeof(int16_t),NULL,GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER,0,galleryCorners*6*sizeof(int16_t),s);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+}
+
+// CPU path: lerp, centre, scale, rotate and place every corner each frame
+static void gallery_place(float alpha,const float rot[9]){
+    float *out=galStream;
+    for(size_t i=0;i<galleryCount;i++){
+        const GalleryModel *m=&gallery[i];
+        const CARVertex *v0,*v1;
+        gallery_frames(m,&v0,&v1);
+        for(size_t k=m->cornerBase;k<m->cornerBase+m->cornerCount;k++){
+            const float *pl=galPlace+6*k;
+            const int16_t *a=v0[m->cornerVertex[k-m->cornerBase]].xyz;
+            const int16_t *b=v1[m->cornerVertex[k-m->cornerBase]].xyz;
+            float p[3];
+            for(int c=0;c<3;c++)
+                p[c]=(((1-alpha)*a[c]+alpha*b[c])*SCALE-pl[c])*pl[3];
+            for(int r=0;r<3;r++)
+                out[3*k+r]=rot[r]*p[0]+rot[3+r]*p[1]+rot[6+r]*p[2]+(r==0?pl[4]:r==1?pl[5]:0);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER,galVboStream);
+    glBufferData(GL_ARRAY_BUFFER,galleryCorners*3*sizeof(float),NULL,GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER,0,galleryCorners*3*sizeof(float),out);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+}
+
+static void gallery_draw(float alpha,const float rot[9]){
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER,galVboUV);
+    glTexCoordPointer(2,GL_FLOAT,0,(void*)0);
+    if(galleryGpu){
+        gallery_stage();
+        paltex_bind_program(&atlas,progGallery);
+        glUniform1f(uGalAlpha,alpha);
+        glUniformMatrix3fv(uGalRot,1,GL_FALSE,rot);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(ATTR_PLACE);
+        glEnableVertexAttribArray(ATTR_CELL);
+        glBindBuffer(GL_ARRAY_BUFFER,galVboStream);
+        glVertexAttribPointer(0,3,GL_SHORT,GL_FALSE,12,(void*)0);
+        glVertexAttribPointer(1,3,GL_SHORT,GL_FALSE,12,(void*)6);
+        glBindBuffer(GL_ARRAY_BUFFER,galVboPlace);
+        glVertexAttribPointer(ATTR_PLACE,4,GL_FLOAT,GL_FALSE,24,(void*)0);
+        glVertexAttribPointer(ATTR_CELL,2,GL_FLOAT,GL_FALSE,24,(void*)16);
+    } else {
+        gallery_place(alpha,rot);
+        paltex_bind(&atlas);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER,galVboStream);
+        glVertexPointer(3,GL_FLOAT,0,(void*)0);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,galIbo);
+    glDrawElements(GL_TRIANGLES,galIndexCount,GL_UNSIGNED_INT,(void*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+    if(galleryGpu){
+        glDisableVertexAttribArray(ATTR_CELL);
+        glDisableVertexAttribArray(ATTR_PLACE);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(0);
+    }
+    else glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    paltex_unbind();
+}
+
+void gallery_display(void){
+    glClearColor(bgColor[0],bgColor[1],bgColor[2],1.0f);
+    glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
+    glColor3f(1,1,1);
+    glLoadIdentity();
+    glTranslatef(translateX,translateY,-galleryDistance/zoom);
+
+    // the viewer's glRotatef(rotateY,0,1,0)*glRotatef(rotateX,1,0,0),
+    // applied to every model about its own centre (column-major)
+    float ay=rotateY*(float)M_PI/180.0f, ax=rotateX*(float)M_PI/180.0f;
+    float cy=cosf(ay), sy=sinf(ay), cx=cosf(ax), sx=sinf(ax);
+    float rot[9]={ cy,0,-sy,  sy*sx,cx,cy*sx,  sy*cx,-sx,cy*cx };
+    float alpha=animating?(animationTime/frameDuration):0.0f;
+    gallery_draw(alpha,rot);
+
+    if(overlayEnabled){
+        glDisable(GL_DEPTH_TEST);
+        glColor3f(0,0,0);
+        for(size_t i=0;i<galleryCount;i++){
+            float x=(float)(i%galleryCols)-(galleryCols-1)*0.5f;
+            float y=(galleryRows-1)*0.5f-(float)(i/galleryCols);
+            drawBitmapString(x-0.45f,y-0.48f,GLUT_BITMAP_HELVETICA_10,gallery[i].name);
+        }
+        glEnable(GL_DEPTH_TEST);
+
+        glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity();
+        gluOrtho2D(0,winWidth,0,winHeight);
+        glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+        glDisable(GL_DEPTH_TEST);
+        char buf[128];
+        snprintf(buf,sizeof(buf),"%zu models, atlas %dx%d, anim slot %d (+/-), %s",
+                 galleryCount,atlasW,atlasH,galleryAnim+1,galleryGpu?"GPU lerp":"CPU lerp");
+        drawBitmapString(10,10,GLUT_BITMAP_HELVETICA_10,buf);
+        glEnable(GL_DEPTH_TEST);
+        glPopMatrix(); glMatrixMode(GL_PROJECTION); glPopMatrix(); glMatrixMode(GL_MODELVIEW);
+    }
+    glutSwapBuffers();
+}
+
+void gallery_idle(void){
+    static int lt=0;
+    int t=glutGet(GLUT_ELAPSED_TIME);
+    float dt=(t-lt)/1000.0f; lt=t;
+    if(spinning) rotateY+=0.2f;
+    if(animating){
+        animationTime+=dt;
+        while(animationTime>=frameDuration){
+            animationTime-=frameDuration;
+            galleryTick++;
+        }
+    }
+    glutPostRedisplay();
+}
+
+void gallery_keyboard(unsigned char k,int x,int y){
+    spinning=0;
+    switch(k){
+      case 27: // ESC
+        rotateX=initRotateX; rotateY=initRotateY;
+        translateX=initTranslateX; translateY=initTranslateY;
+        zoom=1.0f; spinning=1;
+        currentBgPaletteIndex=initBgPaletteIndex;
+        bgColor[0]=paletteRGB[initBgPaletteIndex][0]/255.0f;
+        bgColor[1]=paletteRGB[initBgPaletteIndex][1]/255.0f;
+        bgColor[2]=paletteRGB[initBgPaletteIndex][2]/255.0f;
+        break;
+      case 'w': zoom*=1.1f; break;
+      case 's': zoom/=1.1f; break;
+      case 'a': rotateY-=10; break;
+      case 'd': rotateY+=10; break;
+      case 'r': spinning=!spinning; break;
+      case ' ': animating=!animating; break;
+      case '\t':
+        wireframeMode=!wireframeMode;
+        glPolygonMode(GL_FRONT_AND_BACK, wireframeMode?GL_LINE:GL_FILL);
+        break;
+      case 'f':
+        linearFiltering=!linearFiltering;
+        paltex_filter(&atlas, linearFiltering);
+        break;
+      // models with fewer animations wrap around to their first ones
+      case '+': case '=': galleryAnim=(galleryAnim+1)%galleryAnimSlots; galleryTick=0; animationTime=0; break;
+      case '-': case '_': galleryAnim=(galleryAnim+galleryAnimSlots-1)%galleryAnimSlots; galleryTick=0; animationTime=0; break;
+    }
+}
+
 void reshape(int w,int h){
     winWidth=w; winHeight=h;
     glViewport(0,0,w,h);
@@ -431,27 +1026,49 @@ void reshape(int w,int h){
 }
 
 int main(int argc,char**argv){
-    if(argc<2){
-        fprintf(stderr,"Usage: %s <model.car>\\n",argv[0]);
+    const char *pal_file = palio_option(&argc, argv, NULL);
+    int galleryMode = argc>=3 && !strcmp(argv[1],"-gallery");
+    if(argc<2 || (!galleryMode && argc!=2)){
+        fprintf(stderr,"Usage: %s <model.car> [-palette <file>]\n"
+                       "       %s -gallery <dir|list.txt|file.car> [...] [-palette <file>]\n",argv[0],argv[0]);
         return 1;
     }
     glutInit(&argc,argv);
     glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGBA|GLUT_DEPTH);
     glutInitWindowSize(winWidth,winHeight);
     glutCreateWindow("Chasm The Rift CAR Viewer v1.9.3 by SMR9000");
+    if(glewInit()!=GLEW_OK || !GLEW_VERSION_1_5){
+        fprintf(stderr,"OpenGL 1.5 (vertex buffer objects) required\n");
+        return 1;
+    }
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_TEXTURE_2D);
     glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
 
-    load_palette_embedded();
-    load_car_model(argv[1]);
+    paltex_init();
+    load_palette(pal_file);
+    upload_palette();
+    if(galleryMode){
+        if(!gallery_load(argc,argv)) return 1;
+        if(!gallery_build_atlas() || !gallery_build_buffers()){
+            fprintf(stderr,"Gallery: out of memory\n");
+            return 1;
+        }
+        galleryGpu=gallery_build_program();
+        zoom=1.0f; animating=1;
+        glutSetWindowTitle("Chasm The Rift CAR Gallery v1.9.3 by SMR9000");
+    } else {
+        load_car_model(argv[1]);
+        build_mesh_buffers();
+        gpuLerp=build_frame_buffers();
+    }
 
     glutMouseFunc(mouse);
     glutMotionFunc(motion);
     glutSpecialFunc(special);
-    glutKeyboardFunc(keyboard);
-    glutIdleFunc(idle);
-    glutDisplayFunc(display);
+    glutKeyboardFunc(galleryMode?gallery_keyboard:keyboard);
+    glutIdleFunc(galleryMode?gallery_idle:idle);
+    glutDisplayFunc(galleryMode?gallery_display:display);
     glutReshapeFunc(reshape);
 
     glutMainLoop();
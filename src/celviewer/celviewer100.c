@@ -1,14 +1,14 @@
 /* 
  celviewer.c - simple Autodesk Animator 1 .CEL viewer using OpenGL/GLUT
 
- x86_64-w64-mingw32-gcc -O2 -std=c11   -I. -L.   -o celviewer.exe celviewer2.c   -lmingw32 -lfreeglut   -lopengl32 -lglu32   -lgdi32 -luser32 -lkernel32
+ x86_64-w64-mingw32-gcc -O2 -std=c11   -I. -L.   -I../../include -o celviewer.exe celviewer2.c ../paltex/paltex.c ../palio/palio.c ../chasmpal/chasmpal.c   -lmingw32 -lfreeglut -lglew32   -lopengl32 -lglu32   -lgdi32 -luser32 -lkernel32
 
  Usage:
-   celviewer.exe <file.cel> [initial_zoom]
+   celviewer.exe <file.cel> [initial_zoom] [-palette <file>]
 
  Features:
    • Load 8-bit .CEL (header + palette + pixels)
-   • Autoload chasmpalette.act or embedded palette
+   • Palette: -palette file, else the CEL's own, else the built-in one
    • Toggle transparency mask (index 255) with SPACE
    • Zoom in/out (+ / -), Pan (arrow keys)
    • Change background color index (PgUp / PgDn)
@@ -22,14 +22,17 @@
   #include <windows.h>
 #endif
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include "palio.h"
 #include <stdbool.h>
 #include <stdarg.h>
 #include <math.h>
+#include "paltex.h"
 
 #pragma pack(push,1)
 typedef struct {
@@ -47,7 +50,7 @@ static char     g_filename[256] = "";
 static uint8_t  g_palette[256][3];
 static uint8_t *g_cel_data      = NULL;
 static CelHeader g_hdr;
-static GLuint    g_tex          = 0;
+static PalTex    g_tex;                 // index map, palette on the GPU
 static bool      g_mask         = false;
 static bool      g_pattern      = false;
 static float     g_zoom         = 1.0f;
@@ -59,15 +62,14 @@ static int       g_win_w = 800, g_win_h = 600;
 static void print_usage(const char *p) {
     fprintf(stderr,
       "Usage:\n"
-      "  %s <file.cel> [initial_zoom]\n", p);
+      "  %s <file.cel> [initial_zoom] [-palette <file>]\n", p);
 }
 
-// Try loading a global ACT palette
-static bool load_palette_act(void) {
-    FILE *f = fopen("chasmpalette.act","rb");
-    if (!f) return false;
-    if (fread(g_palette,3,256,f)!=256) { fclose(f); return false; }
-    fclose(f);
+// -palette file, or the built-in palette when path is NULL
+static bool load_palette(const char *path) {
+    Palette pal;
+    if (!palio_load(path, &pal)) return false;
+    memcpy(g_palette, pal.rgb, sizeof(g_palette));
     return true;
 }
 
@@ -101,12 +103,9 @@ static bool load_cel(const char *path) {
             for(int c=0;c<3;c++)
                 g_palette[i][c] = (pal6[i][c]*255 + 31)/63;
     } else {
-        // fallback to ACT or grayscale
-        if (!load_palette_act()) {
-            fprintf(stderr,"Note: no ACT or embedded palette, using grayscale\n");
-            for(int i=0;i<256;i++)
-                g_palette[i][0]=g_palette[i][1]=g_palette[i][2]=(uint8_t)i;
-        }
+        // fallback to the built-in palette
+        fprintf(stderr,"Note: no embedded palette, using the Chasm palette\n");
+        load_palette(NULL);
         // seek past header to pixel data
         fseek(f, sizeof(g_hdr), SEEK_SET);
     }
@@ -123,35 +122,21 @@ static bool load_cel(const char *path) {
     return true;
 }
 
-// Build or rebuild the GL texture from cel_data + palette + mask
-static void build_texture(void) {
-    if (g_tex) glDeleteTextures(1,&g_tex);
-    glGenTextures(1,&g_tex);
-    glBindTexture(GL_TEXTURE_2D,g_tex);
-    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+// Palette + mask; the index texture itself never changes
+static void upload_palette(void) {
+    uint8_t alpha[256];
+    for(int i=0;i<256;i++) alpha[i] = (g_mask && i==255) ? 0 : 255;
+    paltex_palette(g_palette, alpha);
+}
 
-    int w = g_hdr.width, h = g_hdr.height;
-    size_t npix = (size_t)w * h;
-    bool use_alpha = g_mask;
-    int fmt = use_alpha ? GL_RGBA : GL_RGB;
-    int stride = use_alpha ? 4 : 3;
-    uint8_t *buf = malloc(npix * stride);
-
-    for(int y=0;y<h;y++){
-      for(int x=0;x<w;x++){
-        size_t idx = y*w + x;
-        uint8_t c = g_cel_data[idx];
-        buf[idx*stride+0] = g_palette[c][0];
-        buf[idx*stride+1] = g_palette[c][1];
-        buf[idx*stride+2] = g_palette[c][2];
-        if(use_alpha) buf[idx*4+3] = (c==255 ? 0 : 255);
-      }
+// Upload cel_data once as an index map
+static bool build_texture(void) {
+    upload_palette();
+    if (!paltex_create(&g_tex, g_cel_data, g_hdr.width, g_hdr.height)) {
+        fprintf(stderr,"Error creating texture\n");
+        return false;
     }
-
-    glTexImage2D(GL_TEXTURE_2D,0,fmt,w,h,0,fmt,GL_UNSIGNED_BYTE,buf);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-    free(buf);
+    return true;
 }
 
 // Render bitmap text with HELVETICA_10
@@ -192,7 +177,7 @@ static void display(void) {
     }
 
     glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D,g_tex);
+    paltex_bind(&g_tex);
     glColor3f(1,1,1);
 
     float iw = g_hdr.width  * g_zoom;
@@ -226,6 +211,7 @@ static void display(void) {
       glEnd();
     }
 
+    paltex_unbind();
     glDisable(GL_TEXTURE_2D);
 
     // overlay: filename, size, zoom, pattern status at top-left
@@ -254,7 +240,7 @@ static void keyboard(unsigned char key, int x, int y) {
       case '-': if(g_zoom>0.1f) g_zoom /= 1.1f; break;
       case ' ':
         g_mask = !g_mask;
-        build_texture();
+        upload_palette();
         break;
       case 'p': case 'P':
         g_pattern = !g_pattern;
@@ -262,7 +248,7 @@ static void keyboard(unsigned char key, int x, int y) {
       case 27: // ESC
         g_zoom=1; g_pan_x=g_pan_y=0;
         g_mask=false; g_pattern=false; g_bg_index=0;
-        build_texture();
+        upload_palette();
         break;
     }
     glutPostRedisplay();
@@ -282,17 +268,22 @@ static void special(int key,int x,int y) {
 }
 
 int main(int argc,char **argv) {
+    const char *pal_file = palio_option(&argc, argv, NULL);
     if(argc<2||argc>3){ print_usage(argv[0]); return 1; }
     if(argc==3) g_zoom = atof(argv[2]);
     if(!load_cel(argv[1])) return 1;
-    // ensure palette loaded (ACT or embedded)
-    load_palette_act();
+    // an explicit palette overrides the CEL's own
+    if(pal_file && !load_palette(pal_file)) {
+        fprintf(stderr,"Error: failed to load %s\n", pal_file);
+        return 1;
+    }
 
     glutInit(&argc,argv);
     glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGBA);
     glutInitWindowSize(g_win_w,g_win_h);
     glutCreateWindow("Chasm The Rift / Autodesk Animator CEL Viewer v1.0 by SMR9000");
-    build_texture();
+    if(glewInit()==GLEW_OK) paltex_init();
+    if(!build_texture()) return 1;
 
     glutDisplayFunc(display);
     glutReshapeFunc (reshape);
@@ -0,0 +1,61 @@
+// chasmpal.c - the built-in Chasm palette (see include/chasmpal.h)
+//
+// Generated from chasmpalette.act (CHASM2.PAL scaled to 8-bit); the old
+// src/carviewer/chasmpalette.o held the same 768 bytes.
+
+#include "chasmpal.h"
+
+const uint8_t chasmpal_rgb[256][3] = {
+    {  4,  4,  4}, { 16, 16, 16}, { 28, 28, 28}, { 36, 36, 36}, { 48, 48, 48}, { 60, 60, 60}, { 68, 68, 68}, { 80, 80, 80},  // 0
+    { 92, 92, 92}, {100,100,100}, {112,112,112}, {124,124,124}, {132,132,132}, {144,144,144}, {156,156,156}, {168,168,168},  // 8
+    {176,176,176}, {188,188,188}, {200,200,200}, {208,208,208}, {220,220,220}, {232,232,232}, {240,240,240}, {252,252,252},  // 16
+    { 16, 20, 16}, { 24, 24, 24}, { 16, 20, 20}, { 24, 24, 24}, {  8,  8,  8}, { 16, 16, 12}, { 16, 12, 12}, { 28, 24, 24},  // 24
+    { 24, 20, 12}, { 36, 28, 16}, { 48, 36, 24}, { 60, 44, 28}, { 72, 52, 32}, { 84, 60, 40}, { 96, 68, 44}, {108, 80, 52},  // 32
+    {120, 88, 56}, {132, 96, 64}, {144,104, 68}, {156,112, 76}, {168,120, 80}, {180,128, 88}, {192,136, 92}, {204,148,100},  // 40
+    {212,152,104}, {216,152,108}, {224,160,116}, {228,168,124}, {236,176,132}, {240,180,140}, {248,188,148}, {252,196,152},  // 48
+    { 32,  4,  4}, { 44,  4,  4}, { 60,  4,  4}, { 80,  4,  4}, {100,  8,  8}, {112, 12, 12}, {124, 12, 12}, {136, 16, 16},  // 56
+    { 28, 32, 28}, { 32, 36, 32}, { 40, 44, 40}, { 44, 52, 44}, { 48, 60, 52}, { 56, 64, 56}, { 60, 72, 60}, { 64, 80, 68},  // 64
+    { 72, 84, 72}, { 76, 92, 76}, { 80,100, 84}, { 84,108, 88}, { 88,116, 96}, { 96,124,100}, {100,132,104}, {104,140,112},  // 72
+    { 28, 24, 24}, { 36, 32, 28}, { 48, 40, 32}, { 56, 44, 36}, { 64, 52, 40}, { 72, 56, 48}, { 80, 64, 52}, { 88, 72, 56},  // 80
+    { 96, 76, 60}, {104, 84, 64}, {112, 92, 72}, {120, 96, 76}, {128,104, 80}, {136,108, 84}, {148,116, 88}, {156,124, 96},  // 88
+    { 20, 20, 12}, { 28, 28, 20}, { 36, 32, 24}, { 44, 40, 28}, { 52, 48, 36}, { 60, 56, 40}, { 68, 64, 44}, { 76, 72, 52},  // 96
+    { 80, 80, 56}, { 88, 88, 64}, { 96, 96, 68}, {104,104, 72}, {112,112, 80}, {120,120, 84}, {128,124, 88}, {136,132, 96},  // 104
+    { 20, 20, 12}, { 32, 28, 20}, { 44, 40, 32}, { 52, 48, 40}, { 64, 60, 48}, { 76, 72, 56}, { 88, 80, 64}, {100, 92, 76},  // 112
+    {116,104, 88}, {132,116,100}, {148,132,108}, {160,144,120}, {176,160,132}, {192,172,144}, {208,184,156}, {224,200,168},  // 120
+    { 28, 28, 28}, { 36, 36, 36}, { 40, 44, 44}, { 44, 52, 52}, { 52, 60, 60}, { 56, 64, 64}, { 64, 72, 72}, { 68, 80, 80},  // 128
+    { 72, 88, 88}, { 76, 96, 96}, { 84,104,104}, { 88,112,112}, { 92,120,124}, { 96,128,132}, {100,136,140}, {104,148,148},  // 136
+    { 12, 20, 12}, { 16, 24, 16}, { 24, 36, 24}, { 32, 44, 28}, { 40, 52, 36}, { 44, 60, 44}, { 52, 68, 48}, { 56, 72, 52},  // 144
+    { 60, 80, 56}, { 68, 88, 60}, { 72, 92, 68}, { 76,100, 72}, { 84,108, 76}, { 88,112, 80}, { 92,120, 84}, {100,128, 92},  // 152
+    {148, 20, 20}, {160, 20, 20}, {172, 24, 24}, {184, 24, 24}, { 92,  4,  4}, {100,  8,  8}, {104, 16, 16}, {112, 24, 24},  // 160
+    {120, 28, 28}, {128, 36, 36}, {136, 44, 44}, {144, 48, 48}, {152, 56, 56}, {160, 60, 60}, {168, 68, 68}, {176, 76, 76},  // 168
+    {140, 60, 12}, {156, 76, 16}, {168, 92, 24}, {184,108, 32}, {196,124, 36}, {212,140, 44}, {228,156, 48}, {240,172, 56},  // 176
+    {244,184, 76}, {244,196, 96}, {248,208,116}, {252,220,136}, {252,228,152}, {252,236,168}, {252,244,184}, {252,252,200},  // 184
+    { 20, 20, 12}, { 32, 28, 16}, { 40, 36, 20}, { 48, 44, 24}, { 56, 48, 28}, { 64, 56, 32}, { 76, 64, 36}, { 84, 72, 40},  // 192
+    { 92, 80, 44}, {100, 88, 48}, {112, 96, 52}, {120,104, 60}, {128,108, 64}, {136,116, 68}, {144,124, 72}, {156,132, 76},  // 200
+    { 24, 20,  8}, { 32, 24, 12}, { 44, 32, 16}, { 52, 36, 16}, { 60, 40, 20}, { 68, 48, 24}, { 80, 52, 28}, { 88, 56, 32},  // 208
+    { 96, 64, 36}, {108, 68, 40}, {116, 76, 40}, {124, 80, 44}, {132, 84, 48}, {144, 92, 52}, {152, 96, 56}, {160,100, 60},  // 216
+    {  8,  8, 20}, { 16, 16, 28}, { 24, 24, 40}, { 32, 32, 48}, { 40, 40, 56}, { 48, 48, 68}, { 56, 56, 76}, { 64, 64, 84},  // 224
+    { 72, 72, 92}, { 84, 84,104}, { 92, 92,112}, {100,100,120}, {108,108,128}, {116,116,136}, {128,128,148}, {136,136,156},  // 232
+    { 72, 80, 52}, { 56, 68, 32}, { 40, 52, 16}, { 84, 84, 60}, { 92, 92, 68}, { 64, 64, 48}, { 40, 76, 32}, { 68,108, 60},  // 240
+    { 96,144, 88}, {124,176,116}, {152,212,144}, {180,248,172}, { 96, 32,  8}, {124, 48, 12}, {  0,  0,  0}, {252,  0,200},  // 248
+};
+
+// 0 for the #040404 key colour
+const uint8_t chasmpal_alpha[256] = {
+      0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
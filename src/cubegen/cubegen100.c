@@ -1,211 +1,492 @@
 // cubegen.c v1.0.0 (2023-10-01)
 // --------------------------------------------------
 // 3D LUT Cube Generator
-// Loads a 256-entry palette from:
-//   • Photoshop .act / Quake .lmp   (768-byte binary RGB)
-//   • JASC .pal                     (ASCII “JASC-PAL”)
-//   • GIMP .gpl                     (ASCII GIMP Palette)
-//   • 16×16 indexed .png            (via stb_image.h)
-// Automatically writes <inputbasename>_<format>.cube.
+// Loads a 256-entry palette in any format palio recognises (.act, .lmp,
+// raw or JASC .pal, .gpl, pal2all's .txt/.aco/.h, 16×16 .png), or a
+// binary .lut written by -bin (see write_lut).
+// Automatically writes <inputbasename>_<format>.cube, plus
+// <inputbasename>_<format>.lut with -bin.
+//
+// -apply runs PNGs through the LUT in process instead: a fast, preview
+// quality stand-in for exact quantizing.  By default each pixel gets the
+// trilinear blend of its 8 surrounding lattice colours (AVX2 when the CPU
+// has it) and is written as <name>.lut.png with its alpha kept; -indexed
+// takes the palette index of the nearest lattice point and writes an
+// indexed <name>.idx.png (alpha is dropped).
 //
 // Usage:
 //   cubegen.exe -help
-//   cubegen.exe input.act
+//   cubegen.exe [-size N] [-threads N] [-bin] input.act
 //   cubegen.exe input.pal
 //   cubegen.exe input.gpl
 //   cubegen.exe input.png
+//   cubegen.exe [-size N] [-threads N] [-indexed] -apply <dir|list.txt|file.png> [...] input.pal
 //
 // Build (MinGW/WSL):
-// x86_64-w64-mingw32-gcc -std=c99 -O2 -DSTB_IMAGE_IMPLEMENTATION cubegen100.c -lm -o cubegen.exe cubegen.res
+// x86_64-w64-mingw32-gcc -std=c99 -O2 -DSTB_IMAGE_IMPLEMENTATION cubegen100.c ../palquant/palquant.c ../workpool/workpool.c ../pngidx/pngidx.c ../palio/palio.c ../filelist/filelist.c -I../../include -lm -o cubegen.exe cubegen.res
 //
-// Place stb_image.h alongside cubegen.c.
+// Place stb_image.h and stb_image_write.h alongside cubegen.c.
 // --------------------------------------------------
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <sys/stat.h>
+#include <math.h>
 #include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#include "palquant.h"
+#include "workpool.h"
+#include "pngidx.h"
+#include "palio.h"
+#include "filelist.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CUBE_X86 1
+#include <immintrin.h>
+#endif
+
+#define CUBE_DEFAULT_SIZE 16
+#define CUBE_MAX_SIZE     129
+#define CUBE_LINE         27        // "0.xxxxxx 0.xxxxxx 0.xxxxxx\n"
+#define CUBE_ERR_LEN      1100      // "failed to write " + a 1024-byte path
 
 static uint8_t pal[256][3];
+static PalQuant quant;
+
+//―――― Lattice ――――――――――――――――――――――――――――――
+
+typedef struct {
+    int      n;
+    int      axis[CUBE_MAX_SIZE];       // lattice step -> nearest 8-bit value
+    uint8_t  level[CUBE_MAX_SIZE];      // 1 if step k falls exactly on axis[k]
+    int32_t  scaled[256][3];            // palette x (n-1), see nearest_exact
+    uint8_t *idx;                       // n³ palette indices, r fastest, then g, b
+} Lattice;
+
+static Lattice lut;
+
+// Nearest entry to lattice point (r,g,b) * 255/(n-1) itself, not to the
+// 8-bit level it rounds to: with both sides scaled by n-1 the squared
+// distances are exact integers (< 2^32), lowest index winning ties.
+static int nearest_exact(const Lattice *l, int r, int g, int b) {
+    const int32_t R = 255 * r, G = 255 * g, B = 255 * b;
+    uint32_t bd = UINT32_MAX;
+    int best = 0;
+    for (int i = 0; i < 256; i++) {
+        int32_t dr = l->scaled[i][0] - R, dg = l->scaled[i][1] - G, db = l->scaled[i][2] - B;
+        uint32_t d = (uint32_t)(dr*dr) + (uint32_t)(dg*dg) + (uint32_t)(db*db);
+        if (d < bd) { bd = d; best = i; }
+    }
+    return best;
+}
+
+// one blue plane; the table is prepared, so lookups don't write to it
+static void fill_plane(void *ctx, size_t b, int worker) {
+    Lattice *l = ctx;
+    uint8_t *out = l->idx + b * l->n * l->n;
+    (void)worker;
+    for (int g = 0; g < l->n; g++)
+        for (int r = 0; r < l->n; r++)
+            // points on 8-bit levels (every point for sizes 2, 4, 6, 16,
+            // 18, 52, 86) take the palquant fast path
+            *out++ = (uint8_t)(l->level[r] && l->level[g] && l->level[b]
+                ? palquant_nearest(&quant, l->axis[r], l->axis[g], l->axis[b])
+                : nearest_exact(l, r, g, (int)b));
+}
 
-static void scale6to8() {
-    uint8_t mx = 0;
+static int build_lattice(int n, int threads) {
+    lut.n = n;
+    for (int k = 0; k < n; k++) {
+        lut.axis[k]  = (int)lround(k * 255.0 / (n - 1));
+        lut.level[k] = k * 255 % (n - 1) == 0;
+    }
     for (int i = 0; i < 256; i++)
         for (int c = 0; c < 3; c++)
-            if (pal[i][c] > mx) mx = pal[i][c];
-    if (mx <= 63)
-        for (int i = 0; i < 256; i++)
-            for (int c = 0; c < 3; c++)
-                pal[i][c] <<= 2;
+            lut.scaled[i][c] = pal[i][c] * (n - 1);
+    lut.idx = malloc((size_t)n * n * n);
+    if (!lut.idx || !palquant_prepare(&quant)) return 0;
+    workpool_run(n, threads, fill_plane, &lut);
+    return 1;
+}
+
+// write .cube file.  Every lattice point outputs the colour of one palette
+// entry, so the 256 possible lines are formatted once and then copied.
+static int write_cube(const char *fn) {
+    static char line[256][CUBE_LINE + 1];
+    for (int i = 0; i < 256; i++)
+        snprintf(line[i], sizeof(line[i]), "%.6f %.6f %.6f\n",
+                 pal[i][0]/255.0, pal[i][1]/255.0, pal[i][2]/255.0);
+
+    char head[128];
+    int hlen = snprintf(head, sizeof(head),
+                        "TITLE \"3D LUT\"\nLUT_3D_SIZE %d\n"
+                        "DOMAIN_MIN 0.0 0.0 0.0\nDOMAIN_MAX 1.0 1.0 1.0\n", lut.n);
+    size_t cells = (size_t)lut.n * lut.n * lut.n;
+    size_t len = hlen + cells * CUBE_LINE;
+    char *file = malloc(len);
+    if (!file) return 0;
+    memcpy(file, head, hlen);
+    for (size_t i = 0; i < cells; i++)
+        memcpy(file + hlen + i * CUBE_LINE, line[lut.idx[i]], CUBE_LINE);
+
+    // binary mode: the lines are already "\n" and the size is exact
+    FILE *f = fopen(fn, "wb");
+    int ok = f && fwrite(file, 1, len, f) == len;
+    if (f && fclose(f) != 0) ok = 0;
+    free(file);
+    return ok;
 }
 
-// load 768-byte binary (.act, .lmp, raw .PAL)
-static int load_binary(const char *fn) {
+// .lut layout (little-endian):
+//   0    "CLUT"
+//   4    uint16  lattice size n
+//   6    uint16  0 (reserved)
+//   8    768     palette, 8-bit RGB
+//   776  n³      palette indices, r fastest, then g, then b (as in .cube)
+// RGB per cell is pal[idx]; at 65³ that is 275 KB against 7.4 MB of text.
+#define LUT_HEADER (8 + 768)
+
+static int write_lut(const char *fn) {
+    size_t cells = (size_t)lut.n * lut.n * lut.n;
+    uint8_t *file = malloc(LUT_HEADER + cells);
+    if (!file) return 0;
+    memcpy(file, "CLUT", 4);
+    file[4] = (uint8_t)lut.n;
+    file[5] = (uint8_t)(lut.n >> 8);
+    file[6] = file[7] = 0;
+    memcpy(file + 8, pal, 768);
+    memcpy(file + LUT_HEADER, lut.idx, cells);
+    FILE *f = fopen(fn, "wb");
+    int ok = f && fwrite(file, 1, LUT_HEADER + cells, f) == LUT_HEADER + cells;
+    if (f && fclose(f) != 0) ok = 0;
+    free(file);
+    return ok;
+}
+
+// loads palette and lattice together; -size is ignored
+static int load_lut(const char *fn) {
     FILE *f = fopen(fn, "rb");
     if (!f) return 0;
-    if (fread(pal, 1, 768, f) != 768) { fclose(f); return 0; }
+    uint8_t head[8];
+    int ok = fread(head, 1, 8, f) == 8 && !memcmp(head, "CLUT", 4);
+    int n = ok ? head[4] | head[5] << 8 : 0;
+    ok = ok && n >= 2 && n <= CUBE_MAX_SIZE && fread(pal, 1, 768, f) == 768;
+    if (ok) {
+        size_t cells = (size_t)n * n * n;
+        lut.n = n;
+        for (int k = 0; k < n; k++)
+            lut.axis[k] = (int)lround(k * 255.0 / (n - 1));
+        lut.idx = malloc(cells);
+        ok = lut.idx && fread(lut.idx, 1, cells, f) == cells && fgetc(f) == EOF;
+        if (!ok) { free(lut.idx); lut.idx = NULL; }
+    }
     fclose(f);
-    scale6to8();
-    return 1;
+    return ok;
 }
 
-// load JASC-PAL ASCII
-static int load_jasc(const char *fn) {
-    FILE *f = fopen(fn, "r");
-    if (!f) return 0;
-    char buf[128];
-    if (!fgets(buf, sizeof(buf), f) || strncmp(buf, "JASC-PAL", 8)) { fclose(f); return 0; }
-    fgets(buf, sizeof(buf), f);
-    fgets(buf, sizeof(buf), f);
-    for (int i = 0; i < 256; i++) {
-        int r, g, b;
-        if (fscanf(f, "%d %d %d", &r, &g, &b) != 3) { fclose(f); return 0; }
-        pal[i][0] = r; pal[i][1] = g; pal[i][2] = b;
+//―――― Applying the LUT ―――――――――――――――――――――――――
+
+// lattice colours as 0x00BBGGRR, one 32-bit gather per corner
+static uint32_t *lut_rgb;
+
+typedef void (*ApplyFn)(uint8_t *rgba, size_t npix);
+
+// trilinear blend of the 8 lattice colours around each pixel; alpha kept
+static void apply_scalar(uint8_t *px, size_t npix) {
+    const int n = lut.n;
+    const float scale = (n - 1) / 255.0f;
+    for (size_t i = 0; i < npix; i++, px += 4) {
+        int   c0[3];
+        float w[3];
+        for (int c = 0; c < 3; c++) {
+            float f = px[c] * scale;
+            c0[c] = (int)f;
+            if (c0[c] > n - 2) c0[c] = n - 2;
+            w[c] = f - c0[c];
+        }
+        const uint32_t *p = lut_rgb + ((size_t)c0[2] * n + c0[1]) * n + c0[0];
+        const size_t dy = n, dz = (size_t)n * n;
+        for (int c = 0; c < 3; c++) {
+            int sh = 8 * c;
+#define CH(o) (float)((p[o] >> sh) & 0xFF)
+            float x00 = CH(0)       + (CH(1)           - CH(0))       * w[0];
+            float x10 = CH(dy)      + (CH(dy + 1)      - CH(dy))      * w[0];
+            float x01 = CH(dz)      + (CH(dz + 1)      - CH(dz))      * w[0];
+            float x11 = CH(dz + dy) + (CH(dz + dy + 1) - CH(dz + dy)) * w[0];
+#undef CH
+            float y0 = x00 + (x10 - x00) * w[1];
+            float y1 = x01 + (x11 - x01) * w[1];
+            px[c] = (uint8_t)(y0 + (y1 - y0) * w[2] + 0.5f);
+        }
     }
-    fclose(f);
-    scale6to8();
-    return 1;
 }
 
-// load GIMP .gpl ASCII
-static int load_gpl(const char *fn) {
-    FILE *f = fopen(fn, "r");
-    if (!f) return 0;
-    char buf[128];
-    while (fgets(buf, sizeof(buf), f) && buf[0] != '#');
-    for (int i = 0; i < 256; i++) {
-        int r, g, b;
-        if (fscanf(f, "%d %d %d", &r, &g, &b) != 3) { fclose(f); return 0; }
-        pal[i][0] = r; pal[i][1] = g; pal[i][2] = b;
-        fgets(buf, sizeof(buf), f);
+#ifdef CUBE_X86
+
+// 8 pixels per step: corners fetched with vpgatherdd, channels blended in float
+__attribute__((target("avx2")))
+static void apply_avx2(uint8_t *px, size_t npix) {
+    const int n = lut.n;
+    const __m256  scale = _mm256_set1_ps((n - 1) / 255.0f);
+    const __m256  half  = _mm256_set1_ps(0.5f);
+    const __m256i last  = _mm256_set1_epi32(n - 2);
+    const __m256i dy    = _mm256_set1_epi32(n), dz = _mm256_set1_epi32(n * n);
+    const __m256i byte  = _mm256_set1_epi32(0xFF);
+    const int *lat = (const int *)lut_rgb;
+    size_t i = 0;
+    for (; i + 8 <= npix; i += 8, px += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)px);
+        __m256i c0[3];
+        __m256  w[3];
+        for (int c = 0; c < 3; c++) {
+            __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(
+                           _mm256_and_si256(_mm256_srli_epi32(v, 8 * c), byte)), scale);
+            c0[c] = _mm256_min_epi32(_mm256_cvttps_epi32(f), last);
+            w[c]  = _mm256_sub_ps(f, _mm256_cvtepi32_ps(c0[c]));
+        }
+        __m256i base = _mm256_add_epi32(c0[0], _mm256_add_epi32(
+                           _mm256_mullo_epi32(c0[1], dy), _mm256_mullo_epi32(c0[2], dz)));
+        __m256i k[8];
+        for (int j = 0; j < 8; j++) {
+            __m256i o = base;
+            if (j & 1) o = _mm256_add_epi32(o, _mm256_set1_epi32(1));
+            if (j & 2) o = _mm256_add_epi32(o, dy);
+            if (j & 4) o = _mm256_add_epi32(o, dz);
+            k[j] = _mm256_i32gather_epi32(lat, o, 4);
+        }
+        __m256i out = _mm256_andnot_si256(_mm256_set1_epi32(0x00FFFFFF), v);
+        for (int c = 0; c < 3; c++) {
+            __m256 e[8];
+            for (int j = 0; j < 8; j++)
+                e[j] = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(k[j], 8 * c), byte));
+            for (int j = 0; j < 8; j += 2)
+                e[j] = _mm256_add_ps(e[j], _mm256_mul_ps(_mm256_sub_ps(e[j + 1], e[j]), w[0]));
+            e[0] = _mm256_add_ps(e[0], _mm256_mul_ps(_mm256_sub_ps(e[2], e[0]), w[1]));
+            e[4] = _mm256_add_ps(e[4], _mm256_mul_ps(_mm256_sub_ps(e[6], e[4]), w[1]));
+            e[0] = _mm256_add_ps(e[0], _mm256_mul_ps(_mm256_sub_ps(e[4], e[0]), w[2]));
+            __m256i q = _mm256_cvttps_epi32(_mm256_add_ps(e[0], half));
+            out = _mm256_or_si256(out, _mm256_slli_epi32(q, 8 * c));
+        }
+        _mm256_storeu_si256((__m256i *)px, out);
     }
-    fclose(f);
-    scale6to8();
-    return 1;
+    apply_scalar(px, npix - i);
 }
 
-// load 16×16 indexed PNG (extract palette from pixels)
-static int load_png16(const char *fn) {
-    int w, h, comp;
-    unsigned char *img = stbi_load(fn, &w, &h, &comp, 3);
-    if (!img) return 0;
-    if (w != 16 || h != 16) { stbi_image_free(img); return 0; }
-    for (int i = 0; i < 256; i++) {
-        pal[i][0] = img[i*3+0];
-        pal[i][1] = img[i*3+1];
-        pal[i][2] = img[i*3+2];
+#endif
+
+static ApplyFn pick_apply(const char **isa) {
+#ifdef CUBE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { *isa = "avx2"; return apply_avx2; }
+#endif
+    *isa = "scalar";
+    return apply_scalar;
+}
+
+//―――― Batch apply ―――――――――――――――――――――――――――
+
+typedef struct {
+    FileList *files;
+    char    (*errors)[CUBE_ERR_LEN];
+    int      *ok;
+    int       indexed;
+    ApplyFn   apply;
+} ApplyJob;
+
+// our own outputs are not inputs
+static int is_input(const char *name) {
+    return filelist_endswith(name, ".png") && !filelist_endswith(name, ".lut.png")
+        && !filelist_endswith(name, ".idx.png");
+}
+
+// list entries may name anything, so every input keeps the .png suffix
+// the output name replaces
+static void keep_inputs(FileList *l) {
+    size_t kept = 0;
+    for (size_t i = 0; i < l->count; i++) {
+        if (is_input(l->path[i])) { l->path[kept++] = l->path[i]; continue; }
+        if (!filelist_endswith(l->path[i], ".lut.png") && !filelist_endswith(l->path[i], ".idx.png"))
+            fprintf(stderr, "Skipped %s: not a .png\n", l->path[i]);
+        free(l->path[i]);
     }
-    stbi_image_free(img);
-    scale6to8();
-    return 1;
+    l->count = kept;
 }
 
-// find nearest palette entry for (r,g,b) ∈ [0..1]
-static int find_best(double r, double g, double b) {
-    int best = 0; double bd = 1e9;
-    for (int i = 0; i < 256; i++) {
-        double dr = pal[i][0]/255.0 - r;
-        double dg = pal[i][1]/255.0 - g;
-        double db = pal[i][2]/255.0 - b;
-        double d = dr*dr + dg*dg + db*db;
-        if (d < bd) { bd = d; best = i; }
+static void apply_item(void *ctx, size_t i, int worker) {
+    ApplyJob *job = ctx;
+    const char *in = job->files->path[i];
+    char out[1024];
+    int w, h, comp;
+    uint8_t *img = stbi_load(in, &w, &h, &comp, 4);
+    if (!img) { snprintf(job->errors[i], sizeof(job->errors[i]), "cannot read image"); return; }
+    size_t npix = (size_t)w * h;
+    snprintf(out, sizeof(out), "%.*s%s", (int)(strlen(in) - 4), in,
+             job->indexed ? ".idx.png" : ".lut.png");
+
+    if (job->indexed) {
+        // nearest lattice point; the indices are written over the RGBA buffer
+        const int n = lut.n;
+        const float scale = (n - 1) / 255.0f;
+        for (size_t p = 0; p < npix; p++) {
+            const uint8_t *s = img + 4 * p;
+            int r = (int)(s[0] * scale + 0.5f);
+            int g = (int)(s[1] * scale + 0.5f);
+            int b = (int)(s[2] * scale + 0.5f);
+            img[p] = lut.idx[((size_t)b * n + g) * n + r];
+        }
+        job->ok[i] = pngidx_write(out, img, w, h, w, (const uint8_t (*)[3])pal, NULL);
+    } else {
+        job->apply(img, npix);
+        job->ok[i] = stbi_write_png(out, w, h, 4, img, w * 4);
     }
-    return best;
+    if (job->ok[i]) printf("%s\n", out);
+    else snprintf(job->errors[i], sizeof(job->errors[i]), "failed to write %s", out);
+    stbi_image_free(img);
 }
 
-// write .cube file
-static int write_cube(const char *fn) {
-    FILE *f = fopen(fn, "w");
-    if (!f) return 0;
-    const int N = 16;
-    fprintf(f, "TITLE \"3D LUT\"\nLUT_3D_SIZE %d\n", N);
-    fprintf(f, "DOMAIN_MIN 0.0 0.0 0.0\nDOMAIN_MAX 1.0 1.0 1.0\n");
-    for (int b = 0; b < N; b++) {
-        double db = b/(double)(N-1);
-        for (int g = 0; g < N; g++) {
-            double dg = g/(double)(N-1);
-            for (int r = 0; r < N; r++) {
-                double dr = r/(double)(N-1);
-                int idx = find_best(dr, dg, db);
-                fprintf(f, "%.6f %.6f %.6f\n",
-                        pal[idx][0]/255.0,
-                        pal[idx][1]/255.0,
-                        pal[idx][2]/255.0);
+static int run_apply(FileList *files, int indexed, int threads) {
+    keep_inputs(files);
+    if (!files->count) {
+        fprintf(stderr, "No .png files found\n");
+        filelist_free(files);
+        return 1;
+    }
+    size_t cells = (size_t)lut.n * lut.n * lut.n;
+    const char *isa = "nearest";
+    ApplyJob job = { files, calloc(files->count, sizeof(*job.errors)),
+                     calloc(files->count, sizeof(int)), indexed, NULL };
+    if (!indexed) {
+        job.apply = pick_apply(&isa);
+        lut_rgb = malloc(cells * sizeof(uint32_t));
+        if (lut_rgb)
+            for (size_t i = 0; i < cells; i++) {
+                const uint8_t *c = pal[lut.idx[i]];
+                lut_rgb[i] = c[0] | c[1] << 8 | (uint32_t)c[2] << 16;
             }
+    }
+    if (!job.errors || !job.ok || (!indexed && !lut_rgb)) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    int used = workpool_run(files->count, threads, apply_item, &job);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < files->count; i++) {
+        if (!job.ok[i]) {
+            fprintf(stderr, "Error: %s: %s\n", files->path[i], job.errors[i]);
+            failed++;
         }
     }
-    fclose(f);
-    return 1;
+    printf("Applied %d^3 LUT to %zu of %zu images (%d threads, %s)\n",
+           lut.n, files->count - failed, files->count, used, isa);
+    filelist_free(files);
+    free(job.errors);
+    free(job.ok);
+    free(lut_rgb);
+    return failed ? 1 : 0;
 }
 
 static void print_help(const char *pname) {
     printf("Usage:\n"
            "  %s -help\n"
-           "  %s <input.{act,lmp,pal,gpl,png}>\n\n",
-           pname, pname);
+           "  %s [-size N] [-threads N] [-bin] <input.{act,lmp,pal,gpl,png,lut}>\n"
+           "  %s [-size N] [-threads N] [-indexed] -apply <dir|list.txt|file.png> [...] <input>\n\n",
+           pname, pname, pname);
+    printf("Options:\n"
+           "  -size N      LUT_3D_SIZE, 2..%d (default %d; 33 and 65 are common)\n"
+           "  -threads N   worker threads for the lattice fill / images (default: one per CPU)\n"
+           "  -bin         also write the binary <inputbasename>_<format>.lut\n"
+           "  -apply X     run PNGs through the LUT (trilinear) into <name>.lut.png;\n"
+           "               repeatable, X is a PNG, a folder or a list file\n"
+           "  -indexed     with -apply: nearest lattice entry into indexed <name>.idx.png\n\n",
+           CUBE_MAX_SIZE, CUBE_DEFAULT_SIZE);
     printf("Supported inputs:\n"
-           "  .act, .lmp   768-byte binary\n"
-           "  .pal         JASC-PAL ASCII or raw 768-byte .PAL\n"
-           "  .gpl         GIMP palette ASCII\n"
-           "  .png         16w x 16h indexed preview PNG\n"
+           "  " PALIO_FORMATS "\n"
+           "  a .lut from -bin keeps its own size\n"
     "IMPORTANT: For best results use palette without PINK transparency!!!\n");
     printf("Output: <inputbasename>_<format>.cube\n");
 }
 
-static char *make_output_name(const char *in) {
+static char *make_output_name(const char *in, const char *suffix) {
     const char *dot = strrchr(in, '.');
     size_t base_len = dot ? (size_t)(dot - in) : strlen(in);
     const char *ext = dot ? dot + 1 : "";
-    char *out = malloc(base_len + 1 + strlen(ext) + 6);
+    char *out = malloc(base_len + 1 + strlen(ext) + strlen(suffix) + 1);
     memcpy(out, in, base_len);
     out[base_len] = '_';
     strcpy(out + base_len + 1, ext);
-    strcpy(out + base_len + 1 + strlen(ext), ".cube");
+    strcpy(out + base_len + 1 + strlen(ext), suffix);
     return out;
 }
 
 int main(int argc, char **argv) {
-    if (argc != 2 || !strcmp(argv[1], "-help") || !strcmp(argv[1], "--help")) {
+    const char *in = NULL;
+    int size = CUBE_DEFAULT_SIZE, threads = 0, help = 0;
+    int bin = 0, apply = 0, indexed = 0;
+    FileList images = { 0 };
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-help") || !strcmp(argv[i], "--help")) help = 1;
+        else if (!strcmp(argv[i], "-size") && i + 1 < argc)    size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-bin"))                     bin = 1;
+        else if (!strcmp(argv[i], "-indexed"))                 indexed = 1;
+        else if (!strcmp(argv[i], "-apply") && i + 1 < argc) {
+            apply = 1;
+            if (!filelist_add_arg(&images, argv[++i], ".png")) {
+                fprintf(stderr, "Error: out of memory\n");
+                filelist_free(&images);
+                return 1;
+            }
+        }
+        else if (!in) in = argv[i];
+        else help = 1;
+    }
+    if (help || !in) {
         print_help(argv[0]);
         return 0;
     }
-    const char *in = argv[1];
-    const char *dot = strrchr(in, '.');
-    int ok = 0;
-    if (dot) {
-        if (!strcasecmp(dot, ".pal")) {
-            // check header to distinguish JASC vs raw binary
-            char header[16] = {0};
-            FILE *f = fopen(in, "r");
-            if (f) {
-                fgets(header, sizeof(header), f);
-                fclose(f);
-            }
-            if (!strncmp(header, "JASC-PAL", 8))
-                ok = load_jasc(in);
-            else
-                ok = load_binary(in);
-        }
-        else if (!strcasecmp(dot, ".act") || !strcasecmp(dot, ".lmp"))
-            ok = load_binary(in);
-        else if (!strcasecmp(dot, ".gpl"))
-            ok = load_gpl(in);
-        else if (!strcasecmp(dot, ".png"))
-            ok = load_png16(in);
+    if (size < 2 || size > CUBE_MAX_SIZE) {
+        fprintf(stderr, "Error: -size must be 2..%d\n", CUBE_MAX_SIZE);
+        return 1;
+    }
+    // a .lut brings its lattice along; anything else is a palette
+    int from_lut = load_lut(in), ok = from_lut;
+    if (!ok) {
+        Palette p;
+        ok = palio_load(in, &p);
+        if (ok) memcpy(pal, p.rgb, 768);
     }
     if (!ok) {
         fprintf(stderr, "Error: failed to load palette '%s'\n", in);
         return 1;
     }
-    char *out = make_output_name(in);
+    if (!from_lut && (!palquant_init(&quant, pal) || !build_lattice(size, threads))) {
+        fprintf(stderr, "Error: out of memory\n");
+        return 1;
+    }
+    if (apply) return run_apply(&images, indexed, threads);
+
+    char *out = make_output_name(in, ".cube");
     if (!write_cube(out)) {
         fprintf(stderr, "Error: failed to write cube '%s'\n", out);
         free(out);
         return 1;
     }
-    printf("3D LUT written to %s\n", out);
+    printf("3D LUT (%d^3) written to %s\n", lut.n, out);
     free(out);
+    if (bin && !from_lut) {
+        out = make_output_name(in, ".lut");
+        if (!write_lut(out)) {
+            fprintf(stderr, "Error: failed to write LUT '%s'\n", out);
+            free(out);
+            return 1;
+        }
+        printf("Binary LUT written to %s\n", out);
+        free(out);
+    }
+    free(lut.idx);
+    palquant_free(&quant);
     return 0;
 }
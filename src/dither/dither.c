@@ -0,0 +1,285 @@
+// dither.c - palette dithering (see include/dither.h)
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include "dither.h"
+#include "workpool.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <sched.h>
+#endif
+
+static const char *const mode_names[DITHER_COUNT] = {
+    "none", "fs", "sierra", "bayer4", "bayer8", "noise", "atkinson"
+};
+
+const char *dither_name(DitherMode mode) {
+    return mode >= 0 && mode < DITHER_COUNT ? mode_names[mode] : "?";
+}
+
+int dither_parse(const char *name) {
+    for (int m = 0; m < DITHER_COUNT; m++)
+        if (!strcmp(name, mode_names[m])) return m;
+    return -1;
+}
+
+//―――― Diffusion kernels ―――――――――――――――――――――――――
+
+typedef struct { int dx, dy, w; } DitherTap;
+
+typedef struct {
+    int       shift;            // weights are in 1/(1 << shift)
+    int       n;
+    DitherTap tap[6];
+} DitherKernel;
+
+static const DitherKernel kernel_fs = { 4, 4, {
+    { 1,0,7 }, { -1,1,3 }, { 0,1,5 }, { 1,1,1 } } };
+static const DitherKernel kernel_sl = { 2, 3, {
+    { 1,0,2 }, { -1,1,1 }, { 0,1,1 } } };
+// Atkinson only passes on 6/8 of the error
+static const DitherKernel kernel_atkinson = { 3, 6, {
+    { 1,0,1 }, { 2,0,1 }, { -1,1,1 }, { 0,1,1 }, { 1,1,1 }, { 0,2,1 } } };
+
+static const DitherKernel *diffusion_kernel(DitherMode mode) {
+    switch (mode) {
+    case DITHER_FS:       return &kernel_fs;
+    case DITHER_SL:       return &kernel_sl;
+    case DITHER_ATKINSON: return &kernel_atkinson;
+    default:              return NULL;
+    }
+}
+
+static int kernel_reach(const DitherKernel *k) {
+    int reach = 0;
+    for (int n = 0; n < k->n; n++)
+        if (k->tap[n].dy > reach) reach = k->tap[n].dy;
+    return reach;
+}
+
+//―――― Ordered and noise thresholds ―――――――――――――――――
+
+static const uint8_t bayer4[4][4] = {
+    {  0,  8,  2, 10 }, { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 }, { 15,  7, 13,  5 }
+};
+
+static const uint8_t bayer8[8][8] = {
+    {  0,32, 8,40, 2,34,10,42 }, { 48,16,56,24,50,18,58,26 },
+    { 12,44, 4,36,14,46, 6,38 }, { 60,28,52,20,62,30,54,22 },
+    {  3,35,11,43, 1,33, 9,41 }, { 51,19,59,27,49,17,57,25 },
+    { 15,47, 7,39,13,45, 5,37 }, { 63,31,55,23,61,29,53,21 }
+};
+
+// -8..8 from the pixel position alone, so rows can run in any order
+static int noise_at(uint32_t seed, int x, int y) {
+    uint32_t h = seed ^ ((uint32_t)x * 0x9E3779B1u) ^ ((uint32_t)y * 0x85EBCA77u);
+    h ^= h >> 15; h *= 0x2C1B3C6Du;
+    h ^= h >> 12; h *= 0x297A2D39u;
+    h ^= h >> 15;
+    return (int)(h % 17) - 8;
+}
+
+//―――― Row spans ―――――――――――――――――――――――――――――
+//
+// Both the stream and the wavefront run rows through these two, so the
+// per-pixel work lives in one place.  px/idx point at the start of row y.
+
+static void ordered_span(const DitherStream *s, uint8_t *px, uint8_t *idx,
+                         int y, int x0, int x1) {
+    for (int x = x0; x < x1; x++) {
+        uint8_t *p = px + 4*x;
+        if (p[3] < s->alpha_cut) {
+            if (idx) idx[x] = s->clear;
+            continue;
+        }
+        int t;
+        switch (s->mode) {
+        case DITHER_BAYER4: t = bayer4[y & 3][x & 3] - 8;  break;
+        case DITHER_BAYER8: t = bayer8[y & 7][x & 7] - 32; break;
+        case DITHER_NOISE:  t = noise_at(s->seed, x, y);   break;
+        default:            t = 0;                         break;
+        }
+        int c[3];
+        for (int ch = 0; ch < 3; ch++) {
+            int v = p[ch] + t;
+            c[ch] = v < 0 ? 0 : (v > 255 ? 255 : v);
+        }
+        int best = palquant_nearest(s->q, c[0], c[1], c[2]);
+        memcpy(p, s->q->pal[best], 3);
+        if (idx) idx[x] = (uint8_t)best;
+    }
+}
+
+// H bounds which rows may receive error (INT_MAX when streaming)
+static void diffuse_span(const DitherStream *s, int H, uint8_t *px, uint8_t *idx,
+                         int y, int x0, int x1) {
+    const DitherKernel *k = s->kernel;
+    int W = s->W, ring = s->ring;
+    int shift = k->shift, half = 1 << shift >> 1, top = 255 << shift;
+    int32_t (*row)[3] = s->acc + (size_t)(y % ring) * W;
+
+    for (int x = x0; x < x1; x++) {
+        uint8_t *p = px + 4*x;
+        if (p[3] < s->alpha_cut) {
+            if (idx) idx[x] = s->clear;
+            continue;
+        }
+        int v[3], c[3];
+        for (int ch = 0; ch < 3; ch++) {
+            v[ch] = (p[ch] << shift) + row[x][ch];
+            v[ch] = v[ch] < 0 ? 0 : (v[ch] > top ? top : v[ch]);
+            c[ch] = (v[ch] + half) >> shift;
+        }
+        int best = palquant_nearest(s->q, c[0], c[1], c[2]);
+        const uint8_t *pal = s->q->pal[best];
+        for (int ch = 0; ch < 3; ch++) {
+            int e = v[ch] - (pal[ch] << shift);
+            p[ch] = pal[ch];
+            if (!e) continue;
+            for (int n = 0; n < k->n; n++) {
+                int nx = x + k->tap[n].dx, ny = y + k->tap[n].dy;
+                if (nx < 0 || nx >= W || ny >= H) continue;
+                s->acc[(size_t)(ny % ring) * W + nx][ch] += (e * k->tap[n].w + half) >> shift;
+            }
+        }
+        if (idx) idx[x] = (uint8_t)best;
+    }
+}
+
+//―――― Streaming ―――――――――――――――――――――――――――――
+
+int dither_begin(DitherStream *ds, PalQuant *q, DitherMode mode, int W) {
+    memset(ds, 0, sizeof(*ds));
+    if (mode < 0 || mode >= DITHER_COUNT || W <= 0) return 0;
+    ds->q    = q;
+    ds->mode = mode;
+    ds->W    = W;
+
+    const DitherKernel *k = diffusion_kernel(mode);
+    if (!k) return 1;
+    ds->kernel = k;
+    ds->reach  = kernel_reach(k);
+    ds->ring   = ds->reach + 1;
+    ds->acc    = calloc((size_t)ds->ring * W, sizeof(*ds->acc));
+    return ds->acc != NULL;
+}
+
+void dither_row(DitherStream *ds, uint8_t *rgba, uint8_t *idx) {
+    int y = ds->y++;
+    if (!ds->kernel) {
+        ordered_span(ds, rgba, idx, y, 0, ds->W);
+        return;
+    }
+    // row y+reach first receives error from this row; its slot last held
+    // row y-1, which is finished
+    memset(ds->acc + (size_t)((y + ds->reach) % ds->ring) * ds->W, 0,
+           ds->W * sizeof(*ds->acc));
+    diffuse_span(ds, INT_MAX, rgba, idx, y, 0, ds->W);
+}
+
+void dither_end(DitherStream *ds) {
+    free(ds->acc);
+    memset(ds, 0, sizeof(*ds));
+}
+
+//―――― Row-lag wavefront ―――――――――――――――――――――――――
+//
+// Rows are handed to the workpool in order.  Row y walks across in
+// DITHER_TILE-wide steps and, before each step, waits until every row
+// above it that feeds the step (Floyd-Steinberg: row y-1 one pixel past
+// the step's end) has got that far.  Pending error lives in a ring of
+// rows sized to the worker count, so memory is O(width x threads).
+
+typedef struct {
+    DitherStream        s;          // shared settings and error ring
+    uint8_t            *rgba, *idx;
+    int                 H;
+    int                 lag[3];     // columns row y-dy must lead by
+    atomic_int         *done;       // columns finished per row
+} DiffuseJob;
+
+static void wait_for(atomic_int *v, int need) {
+    while (atomic_load_explicit(v, memory_order_acquire) < need) {
+#ifdef _WIN32
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
+static void diffuse_row(void *ctx, size_t item, int worker) {
+    DiffuseJob *j = ctx;
+    const DitherStream *s = &j->s;
+    int y = (int)item, W = s->W, ring = s->ring;
+    (void)worker;
+
+    // this row is the first to push error into row y+reach: take over its
+    // ring slot once the row that used it last is finished
+    int far = y + s->reach;
+    if (far < j->H) {
+        if (far >= ring) wait_for(&j->done[far - ring], W);
+        memset(s->acc + (size_t)(far % ring) * W, 0, W * sizeof(*s->acc));
+    }
+
+    uint8_t *px  = j->rgba + (size_t)y * W * 4;
+    uint8_t *idx = j->idx ? j->idx + (size_t)y * W : NULL;
+    for (int x0 = 0; x0 < W; x0 += DITHER_TILE) {
+        int x1 = x0 + DITHER_TILE < W ? x0 + DITHER_TILE : W;
+        for (int dy = 1; dy <= s->reach && dy <= y; dy++) {
+            int need = x1 + j->lag[dy];
+            wait_for(&j->done[y - dy], need < W ? need : W);
+        }
+        diffuse_span(s, j->H, px, idx, y, x0, x1);
+        atomic_store_explicit(&j->done[y], x1, memory_order_release);
+    }
+}
+
+static void ordered_row(void *ctx, size_t item, int worker) {
+    DiffuseJob *j = ctx;
+    int y = (int)item, W = j->s.W;
+    (void)worker;
+    ordered_span(&j->s, j->rgba + (size_t)y * W * 4,
+                 j->idx ? j->idx + (size_t)y * W : NULL, y, 0, W);
+}
+
+int dither_image(PalQuant *q, DitherMode mode, uint8_t *rgba, uint8_t *idx,
+                 int W, int H, int threads) {
+    if (mode < 0 || mode >= DITHER_COUNT || W <= 0 || H <= 0) return 0;
+
+    DiffuseJob job = { .s = { .q = q, .mode = mode, .W = W },
+                       .rgba = rgba, .idx = idx, .H = H };
+    int workers = threads > 0 ? threads : workpool_cpu_count();
+    // concurrent lookups need every cell built up front
+    if (workers > 1 && H > 1 && !palquant_prepare(q)) return 0;
+
+    const DitherKernel *k = diffusion_kernel(mode);
+    if (!k) {
+        workpool_run((size_t)H, threads, ordered_row, &job);
+        return 1;
+    }
+
+    job.s.kernel = k;
+    job.s.reach  = kernel_reach(k);
+    for (int n = 0; n < k->n; n++) {
+        int dy = k->tap[n].dy;
+        if (dy && -k->tap[n].dx > job.lag[dy]) job.lag[dy] = -k->tap[n].dx;
+    }
+    job.s.ring = workers + job.s.reach + 1;
+    if (job.s.ring > H + job.s.reach) job.s.ring = H + job.s.reach;
+
+    job.s.acc = calloc((size_t)job.s.ring * W, sizeof(*job.s.acc));
+    job.done  = calloc((size_t)H, sizeof(*job.done));
+    int ok = job.s.acc && job.done;
+    if (ok) workpool_run((size_t)H, threads, diffuse_row, &job);
+
+    free(job.s.acc);
+    free(job.done);
+    return ok;
+}
@@ -0,0 +1,95 @@
+// filelist.c - input gathering for the batch / gallery modes (see include/filelist.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "filelist.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#endif
+
+int filelist_endswith(const char *s, const char *suffix) {
+    size_t sl = strlen(s), su = strlen(suffix);
+    return sl >= su && strcasecmp(s + sl - su, suffix) == 0;
+}
+
+int filelist_add(FileList *l, const char *path) {
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 64;
+        char **p = realloc(l->path, cap * sizeof(char*));
+        if (!p) return 0;
+        l->path = p;
+        l->cap = cap;
+    }
+    char *s = strdup(path);
+    if (!s) return 0;
+    l->path[l->count++] = s;
+    return 1;
+}
+
+int filelist_is_dir(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// 1 = directory to descend into, 0 = anything else (links included)
+static int is_real_dir(const char *path) {
+#ifdef _WIN32
+    DWORD a = GetFileAttributesA(path);
+    return a != INVALID_FILE_ATTRIBUTES && (a & FILE_ATTRIBUTE_DIRECTORY) &&
+           !(a & FILE_ATTRIBUTE_REPARSE_POINT);
+#else
+    struct stat st;
+    return lstat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+int filelist_scan_dir(FileList *l, const char *dir, const char *ext) {
+    DIR *d = opendir(dir);
+    if (!d) { perror(dir); return 1; }
+    struct dirent *ent;
+    int ok = 1;
+    while (ok && (ent = readdir(d))) {
+        if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
+        char path[1024];
+        if (snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >= (int)sizeof(path)) {
+            fprintf(stderr, "%s/%s: path too long, skipped\n", dir, ent->d_name);
+            continue;
+        }
+        if (is_real_dir(path))                        ok = filelist_scan_dir(l, path, ext);
+        else if (filelist_endswith(ent->d_name, ext)) ok = filelist_add(l, path);
+    }
+    closedir(d);
+    return ok;
+}
+
+int filelist_read_list(FileList *l, const char *list) {
+    FILE *f = fopen(list, "r");
+    if (!f) { perror(list); return 1; }
+    char line[1024];
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0]) ok = filelist_add(l, line);
+    }
+    fclose(f);
+    return ok;
+}
+
+int filelist_add_arg(FileList *l, const char *arg, const char *ext) {
+    if (filelist_is_dir(arg))        return filelist_scan_dir(l, arg, ext);
+    if (filelist_endswith(arg, ext)) return filelist_add(l, arg);
+    return filelist_read_list(l, arg);
+}
+
+void filelist_free(FileList *l) {
+    for (size_t i = 0; i < l->count; i++) free(l->path[i]);
+    free(l->path);
+    l->path = NULL;
+    l->count = l->cap = 0;
+}
@@ -1,5 +1,5 @@
 // Chasm Floor Tag Editor v1.0.2 (v106)
-// Compile: x86_64-w64-mingw32-gcc floorflag.c -o floorflag.exe -I. -L./lib -l:libfreeglut.a -lopengl32 -lgdi32 -std=c99 -static floorflag.res
+// Compile: x86_64-w64-mingw32-gcc floorflag.c ../palio/palio.c ../chasmpal/chasmpal.c -o floorflag.exe -I. -I../../include -L./lib -l:libfreeglut.a -lopengl32 -lgdi32 -std=c99 -static floorflag.res
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include "palio.h"
 
 #define MAX_FLOORS       64
 #define TEX_SIZE         64
@@ -19,13 +20,15 @@
 #define MIN_WINDOW_H     512
 #define DEFAULT_WINDOW_W 768
 #define DEFAULT_WINDOW_H 512
+#define ATLAS_SIZE       1024
+#define ATLAS_PAD        1
 
 static const char *g_filename;
 static unsigned char *fileBuf = NULL;
 static long fileSize = 0;
 static unsigned char floorIdx[MAX_FLOORS][TEX_SIZE*TEX_SIZE];
 static unsigned char *floorRGBA[MAX_FLOORS];
-static GLuint texBase[MAX_FLOORS];
+static GLuint texAtlas;   // all 64 tiles, see initGL
 static unsigned char palette[256][3];
 static int tileFlags[MAX_FLOORS] = {0};
 static int windowW = DEFAULT_WINDOW_W, windowH = DEFAULT_WINDOW_H;
@@ -44,11 +47,11 @@ static void buildBase(char *out){
     out[j]='\0';
 }
 
+// built-in palette unless -palette names a file
 void loadPalette(const char *path){
-    FILE *f=fopen(path,"rb"); 
-    if(!f){fprintf(stderr,"No palette\n");exit(1);}
-    for(int i=0;i<256;i++) fread(palette[i],1,3,f);
-    fclose(f);
+    Palette pal;
+    if(!palio_load(path,&pal)){fprintf(stderr,"No palette\n");exit(1);}
+    memcpy(palette,pal.rgb,sizeof(palette));
 }
 
 void loadFloors(const char *path){
@@ -73,16 +76,33 @@ void loadFloors(const char *path){
     }
 }
 
+// The tiles share one texture laid out as an 8x8 grid of 66x66 slots: each
+// tile sits ATLAS_PAD texels in, its edge texels repeated around it so a
+// sample on a tile boundary never picks up the neighbour.  The whole grid
+// is then a single bind and a single draw.
+static void atlasUpload(int ti){
+    const int slot=TEX_SIZE+2*ATLAS_PAD;
+    unsigned char buf[(TEX_SIZE+2*ATLAS_PAD)*(TEX_SIZE+2*ATLAS_PAD)*4];
+    for(int y=0;y<slot;y++)for(int x=0;x<slot;x++){
+        int sx=x-ATLAS_PAD, sy=y-ATLAS_PAD;
+        sx=sx<0?0:(sx>=TEX_SIZE?TEX_SIZE-1:sx);
+        sy=sy<0?0:(sy>=TEX_SIZE?TEX_SIZE-1:sy);
+        memcpy(&buf[(y*slot+x)*4],&floorRGBA[ti][(sy*TEX_SIZE+sx)*4],4);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D,0,(ti%8)*slot,(ti/8)*slot,slot,slot,GL_RGBA,GL_UNSIGNED_BYTE,buf);
+}
+
 void initGL(){
     glEnable(GL_TEXTURE_2D);
     glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
-    glGenTextures(MAX_FLOORS,texBase);
-    for(int i=0;i<MAX_FLOORS;i++){
-        glBindTexture(GL_TEXTURE_2D,texBase[i]);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,64,64,0,GL_RGBA,GL_UNSIGNED_BYTE,floorRGBA[i]);
-    }
+    glGenTextures(1,&texAtlas);
+    glBindTexture(GL_TEXTURE_2D,texAtlas);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
+    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,ATLAS_SIZE,ATLAS_SIZE,0,GL_RGBA,GL_UNSIGNED_BYTE,NULL);
+    for(int i=0;i<MAX_FLOORS;i++) atlasUpload(i);
     glClearColor(0.28,0.345,0.345,1);
     viewportW = 512; viewportH = 512;
     viewportX = windowW - 512;
@@ -207,18 +227,27 @@ void display(){
     glMatrixMode(GL_MODELVIEW); glLoadIdentity();
     float gridNDC = 2.0f, half=gridNDC*0.5f, step=gridNDC/8.0f;
     
-    // Draw tiles
+    // Draw tiles: one quad per atlas slot, all in one call
+    static GLfloat xy[MAX_FLOORS*8], st[MAX_FLOORS*8];
+    const float slot=(TEX_SIZE+2*ATLAS_PAD)/(float)ATLAS_SIZE,
+                tex=TEX_SIZE/(float)ATLAS_SIZE, pad=ATLAS_PAD/(float)ATLAS_SIZE;
     for(int y=0;y<8;y++)for(int x=0;x<8;x++){
         int idx=y*8+x;
         float vx=-half+x*step, vy=half-(y+1)*step;
-        glBindTexture(GL_TEXTURE_2D,texBase[idx]);
-        glBegin(GL_QUADS);
-          glTexCoord2f(0,1); glVertex2f(vx,vy);
-          glTexCoord2f(1,1); glVertex2f(vx+step,vy);
-          glTexCoord2f(1,0); glVertex2f(vx+step,vy+step);
-          glTexCoord2f(0,0); glVertex2f(vx,vy+step);
-        glEnd();
+        float s0=x*slot+pad, s1=s0+tex, t0=y*slot+pad, t1=t0+tex;
+        GLfloat q[8]={vx,vy, vx+step,vy, vx+step,vy+step, vx,vy+step};
+        GLfloat t[8]={s0,t1, s1,t1, s1,t0, s0,t0};
+        memcpy(&xy[idx*8],q,sizeof(q));
+        memcpy(&st[idx*8],t,sizeof(t));
     }
+    glBindTexture(GL_TEXTURE_2D,texAtlas);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2,GL_FLOAT,0,xy);
+    glTexCoordPointer(2,GL_FLOAT,0,st);
+    glDrawArrays(GL_QUADS,0,MAX_FLOORS*4);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
     
     // Draw selection outline
     glDisable(GL_TEXTURE_2D);
@@ -307,8 +336,9 @@ void onMouse(int b,int s,int mx,int my){
 }
 
 int main(int argc,char **argv){
+    const char *palFile=palio_option(&argc,argv,NULL);
     g_filename=(argc>1)?argv[1]:"FLOORS.XX";
-    loadPalette("chasmpalette.act");
+    loadPalette(palFile);
     loadFloors(g_filename);
 
     glutInit(&argc,argv);
@@ -1,5 +1,6 @@
 // floors_viewer.c v128 (1.0.2)
-// x86_64-w64-mingw32-gcc floors120-FINAL.c -o floortool.exe -I. -I./GL -L./lib -lfreeglut -lopengl32 -lm floortool.res
+// x86_64-w64-mingw32-gcc floors120-FINAL.c ../palquant/palquant.c ../dither/dither.c ../workpool/workpool.c ../paltex/paltex.c ../palio/palio.c ../chasmpal/chasmpal.c -o floortool.exe -I. -I../../include -I./GL -L./lib -lfreeglut -lglew32 -lopengl32 -lm floortool.res
+// floortool.exe [FLOORS.XX] [-undo <MB>] [-palette <file>]
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
@@ -14,12 +15,18 @@
   #define MKDIR(dir) mkdir(dir,0755)
 #endif
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <limits.h>
+#include "palquant.h"
+#include "dither.h"
+#include "paltex.h"
+#include "palio.h"
 
 //―――― Config ―――――――――――――――――――――――――
 
@@ -27,7 +34,9 @@
 #define TEX_SIZE         64
 #define HEADER_SIZE      64
 #define UNKNOWN_BYTES    64
-#define UNDO_DEPTH       100
+#define ATLAS_SIZE       1024
+#define ATLAS_PAD        1
+#define UNDO_BUDGET_MB   8     // default undo journal size, -undo <MB>
 
 #define MIN_WINDOW_W     512
 #define MIN_WINDOW_H     512
@@ -39,23 +48,6 @@
 enum { MODE_GRID=0, MODE_TILE=1, MODE_MIPMAP=2 };
 typedef struct { int x,y; } Point;
 
-typedef enum {
-  DITHER_NONE = 0,
-  DITHER_FS,
-  DITHER_SL,
-  DITHER_BAYER4,
-  DITHER_BAYER8,
-  DITHER_NOISE,
-  DITHER_ATKINSON,
-  DITHER_COUNT
-} DitherMode;
-
-typedef struct {
-    unsigned char rgba[TEX_SIZE*TEX_SIZE*4];
-    unsigned char idx[TEX_SIZE*TEX_SIZE];
-    int tile_index;
-} UndoState;
-
 static const char *ditherNames[DITHER_COUNT] = {
   "None (Default)",
   "Floyd–Steinberg",
@@ -67,8 +59,6 @@ static const char *ditherNames[DITHER_COUNT] = {
 };
 
 static DitherMode importDitherMode = DITHER_NONE;
-static UndoState undoStack[UNDO_DEPTH];
-static int undoTop = -1;
 
 static const char *g_filename;
 static unsigned char *fileBuf = NULL;
@@ -80,12 +70,13 @@ static unsigned char *floorRGBA[MAX_FLOORS],
                      *floorMip2Data[MAX_FLOORS],
                      *floorMip3Data[MAX_FLOORS];
 
-static GLuint texBase[MAX_FLOORS],
-              texMip1[MAX_FLOORS],
-              texMip2[MAX_FLOORS],
-              texMip3[MAX_FLOORS];
+// mip levels 1-3 as palette indices, as they go into the file
+static unsigned char floorMipIdx[MAX_FLOORS][3][(TEX_SIZE/2)*(TEX_SIZE/2)];
+
+static PalTex atlas;   // every tile and mip level as indices, see Tile Atlas
 
 static unsigned char palette[256][3];
+static PalQuant quant;
 static int tileFlags[MAX_FLOORS] = {0};
 
 static Point sel = {0,0};
@@ -93,6 +84,7 @@ static int mode = MODE_GRID;
 static float zoomLevel = 1.0f, zoomStep = 0.1f;
 static int bgIndex, defaultBgIndex;
 static bool showUI = true, dirty = false;
+static bool tileDirty[MAX_FLOORS];   // edited since the last save
 
 static int windowW = DEFAULT_WINDOW_W,
            windowH = DEFAULT_WINDOW_H;
@@ -120,7 +112,10 @@ void flipTileHorizontal(void);
 void flipTileVertical(void);
 void rotateTile90(void);
 void updateTileTextures(int ti);
-void pushUndoState(int ti);
+void tileEdited(int ti);
+void updateMipRect(int ti,int x0,int y0,int x1,int y1);
+void quantizeMips(int ti);
+bool undoRecord(int ti,const unsigned char *newIdx,bool join);
 void undoLastAction(void);
 
 // Build base filename without extension or path
@@ -134,265 +129,284 @@ static void buildBase(char *out){
     out[j] = '\0';
 }
 
-//―――― Dither Algorithms ―――――――――――――――――――――
+//―――― Dither ―――――――――――――――――――――――――――――
 
-static const unsigned char bayer4[4][4] = {
-  {  0,  8,  2, 10}, { 12,  4, 14,  6},
-  {  3, 11,  1,  9}, { 15,  7, 13,  5}
-};
+// snaps rgba to the palette with the selected import dither
+void applyDither(unsigned char *rgba,int W,int H){
+    if(importDitherMode!=DITHER_NONE)
+        dither_image(&quant,importDitherMode,rgba,NULL,W,H,0);
+}
 
-static const unsigned char bayer8[8][8] = {
-  {  0,32, 8,40, 2,34,10,42},{48,16,56,24,50,18,58,26},
-  {12,44, 4,36,14,46, 6,38},{60,28,52,20,62,30,54,22},
-  { 3,35,11,43, 1,33, 9,41},{51,19,59,27,49,17,57,25},
-  {15,47, 7,39,13,45, 5,37},{63,31,55,23,61,29,53,21}
-};
+//―――― Undo Journal ―――――――――――――――――――――――――
+//
+// Every edit appends one record per changed tile that holds only the runs
+// of indices it overwrote (RGBA and mips are rebuilt from them):
+//
+//   UndoRecord | runs x (uint16 start, uint16 len, len old indices) | uint32 size
+//
+// The trailing size lets undo walk the journal backwards.  Records of one
+// operation (e.g. a grid import touching many tiles) are chained with
+// `join` and undone together.  The oldest operations, each with all its
+// joined records, are dropped once the journal outgrows undoBudget.
 
-void applyFSDither(unsigned char *rgba,int W,int H){
-    int size=W*H;
-    float *fr=malloc(size*sizeof(float)),
-          *fg=malloc(size*sizeof(float)),
-          *fb=malloc(size*sizeof(float));
-    for(int i=0;i<size;i++){
-        fr[i]=rgba[4*i+0];
-        fg[i]=rgba[4*i+1];
-        fb[i]=rgba[4*i+2];
-    }
-    for(int y=0;y<H;y++) for(int x=0;x<W;x++){
-        int i=y*W+x;
-        float oldr=fr[i], oldg=fg[i], oldb=fb[i];
-        int best=0; float bd=1e9f;
-        for(int c=0;c<256;c++){
-            float dr=oldr-palette[c][0],
-                  dg=oldg-palette[c][1],
-                  db=oldb-palette[c][2],
-                  d=dr*dr+dg*dg+db*db;
-            if(d<bd){bd=d;best=c;}
-        }
-        float nr=palette[best][0], ng=palette[best][1], nb=palette[best][2];
-        rgba[4*i+0]=(unsigned char)nr;
-        rgba[4*i+1]=(unsigned char)ng;
-        rgba[4*i+2]=(unsigned char)nb;
-        float er=oldr-nr, eg=oldg-ng, eb=oldb-nb;
-        #define DIFFUSE(dx,dy,f) \
-          if(x+dx>=0&&x+dx<W&&y+dy>=0&&y+dy<H){ \
-            fr[(y+dy)*W + (x+dx)] += er*f; \
-            fg[(y+dy)*W + (x+dx)] += eg*f; \
-            fb[(y+dy)*W + (x+dx)] += eb*f; }
-        DIFFUSE(1, 0, 7.0f/16.0f);
-        DIFFUSE(-1,1, 3.0f/16.0f);
-        DIFFUSE(0, 1, 5.0f/16.0f);
-        DIFFUSE(1, 1, 1.0f/16.0f);
-        #undef DIFFUSE
-    }
-    free(fr); free(fg); free(fb);
+typedef struct {
+    uint32_t size;          // whole record, header and trailer included
+    uint16_t tile, runs;
+    uint8_t  join;          // undo together with the record before it
+} UndoRecord;
+
+static unsigned char *undoBuf;
+static size_t undoHead, undoTail, undoCap;  // live records: [undoHead, undoTail)
+static size_t undoBudget = (size_t)UNDO_BUDGET_MB << 20;
+static bool undoLost;   // the current operation's first records were dropped
+
+static UndoRecord undoAt(size_t off){
+    UndoRecord r; memcpy(&r,undoBuf+off,sizeof(r));
+    return r;
 }
 
-void applySLDither(unsigned char *rgba,int W,int H){
-    int size=W*H;
-    float *fr=malloc(size*sizeof(float)),
-          *fg=malloc(size*sizeof(float)),
-          *fb=malloc(size*sizeof(float));
-    for(int i=0;i<size;i++){
-        fr[i]=rgba[4*i+0];
-        fg[i]=rgba[4*i+1];
-        fb[i]=rgba[4*i+2];
+static bool undoReserve(size_t need){
+    if(undoTail+need<=undoCap) return true;
+    if(undoHead){   // slide the live records down before growing
+        memmove(undoBuf,undoBuf+undoHead,undoTail-undoHead);
+        undoTail-=undoHead; undoHead=0;
+        if(undoTail+need<=undoCap) return true;
     }
-    for(int y=0;y<H;y++) for(int x=0;x<W;x++){
-        int i=y*W+x;
-        float oldr=fr[i], oldg=fg[i], oldb=fb[i];
-        int best=0; float bd=1e9f;
-        for(int c=0;c<256;c++){
-            float dr=oldr-palette[c][0],
-                  dg=oldg-palette[c][1],
-                  db=oldb-palette[c][2],
-                  d=dr*dr+dg*dg+db*db;
-            if(d<bd){bd=d;best=c;}
-        }
-        float nr=palette[best][0], ng=palette[best][1], nb=palette[best][2];
-        rgba[4*i+0]=(unsigned char)nr;
-        rgba[4*i+1]=(unsigned char)ng;
-        rgba[4*i+2]=(unsigned char)nb;
-        float er=oldr-nr, eg=oldg-ng, eb=oldb-nb;
-        #define SL(dx,dy,f) \
-          if(x+dx>=0&&x+dx<W&&y+dy>=0&&y+dy<H){ \
-            fr[(y+dy)*W + (x+dx)] += er*f; \
-            fg[(y+dy)*W + (x+dx)] += eg*f; \
-            fb[(y+dy)*W + (x+dx)] += eb*f; }
-        SL(1,0, 2.0f/4.0f);
-        SL(-1,1,1.0f/4.0f);
-        SL(0,1, 1.0f/4.0f);
-        #undef SL
-    }
-    free(fr); free(fg); free(fb);
+    size_t cap=undoCap?undoCap:65536;
+    while(cap<undoTail+need) cap*=2;
+    unsigned char *nb=realloc(undoBuf,cap);
+    if(!nb) return false;
+    undoBuf=nb; undoCap=cap;
+    return true;
 }
 
-void applyBayer4(unsigned char *rgba,int W,int H){
-    for(int y=0;y<H;y++)for(int x=0;x<W;x++){
-        int i=y*W+x, t=bayer4[y%4][x%4]-8;
-        for(int k=0;k<3;k++){
-            int v=rgba[4*i+k]+t;
-            rgba[4*i+k] = v<0?0:(v>255?255:v);
-        }
+// journals the indices of tile ti that newIdx is about to overwrite;
+// returns false if nothing would change
+bool undoRecord(int ti,const unsigned char *newIdx,bool join){
+    const unsigned char *old=floorIdx[ti];
+    const int n=TEX_SIZE*TEX_SIZE;
+    // runs are at least one index apart, so this bounds any record
+    size_t worst=sizeof(UndoRecord)+n+(n/2+1)*4+4;
+    // a chain whose head is gone can't be undone whole, so skip the rest
+    if(join&&undoLost) return memcmp(old,newIdx,n)!=0;
+    undoLost=false;
+    if(!undoReserve(worst)){   // out of memory: keep editing, lose history
+        fprintf(stderr,"Out of memory for the undo journal, history discarded\n");
+        undoHead=undoTail=0;
+        undoLost=true;
+        return memcmp(old,newIdx,n)!=0;
     }
+
+    unsigned char *rec=undoBuf+undoTail, *w=rec+sizeof(UndoRecord);
+    int runs=0;
+    for(int p=0;p<n;){
+        if(old[p]==newIdx[p]){ p++; continue; }
+        // gaps shorter than a run header are cheaper to keep in the run
+        int e=p+1;
+        for(int q=e;q<n&&q-e<4;q++) if(old[q]!=newIdx[q]) e=q+1;
+        uint16_t hdr[2]={(uint16_t)p,(uint16_t)(e-p)};
+        memcpy(w,hdr,4);
+        memcpy(w+4,old+p,e-p);
+        w+=4+e-p; runs++; p=e;
+    }
+    if(!runs) return false;
+
+    UndoRecord r={(uint32_t)(w-rec)+4,(uint16_t)ti,(uint16_t)runs,join};
+    memcpy(rec,&r,sizeof(r));
+    memcpy(w,&r.size,4);
+    undoTail+=r.size;
+
+    while(undoTail-undoHead>undoBudget){
+        size_t end=undoHead+undoAt(undoHead).size;
+        while(end<undoTail&&undoAt(end).join) end+=undoAt(end).size;
+        if(end==undoTail) break;   // always keep the newest operation
+        undoHead=end;
+    }
+    return true;
 }
 
-void applyBayer8(unsigned char *rgba,int W,int H){
-    for(int y=0;y<H;y++)for(int x=0;x<W;x++){
-        int i=y*W+x, t=bayer8[y%8][x%8]-32;
-        for(int k=0;k<3;k++){
-            int v=rgba[4*i+k]+t;
-            rgba[4*i+k] = v<0?0:(v>255?255:v);
+void undoLastAction(void) {
+    if(undoTail==undoHead) return;
+
+    bool more=true;
+    while(more&&undoTail>undoHead){
+        uint32_t size; memcpy(&size,undoBuf+undoTail-4,4);
+        const unsigned char *rec=undoBuf+undoTail-size;
+        UndoRecord r; memcpy(&r,rec,sizeof(r));
+        int ti=r.tile, x0=TEX_SIZE, y0=TEX_SIZE, x1=0, y1=0;
+
+        const unsigned char *rp=rec+sizeof(r);
+        for(int i=0;i<r.runs;i++){
+            uint16_t hdr[2]; memcpy(hdr,rp,4); rp+=4;
+            int s=hdr[0], e=hdr[0]+hdr[1];
+            memcpy(floorIdx[ti]+s,rp,hdr[1]); rp+=hdr[1];
+            for(int p=s;p<e;p++) memcpy(&floorRGBA[ti][4*p],palette[floorIdx[ti][p]],3);
+
+            int ys=s/TEX_SIZE, ye=(e-1)/TEX_SIZE;
+            int xs=ys==ye? s%TEX_SIZE : 0, xe=ys==ye? (e-1)%TEX_SIZE+1 : TEX_SIZE;
+            if(xs<x0) x0=xs;
+            if(xe>x1) x1=xe;
+            if(ys<y0) y0=ys;
+            if(ye+1>y1) y1=ye+1;
         }
+        updateMipRect(ti,x0,y0,x1,y1);
+        quantizeMips(ti);
+        updateTileTextures(ti);
+        tileDirty[ti]=true;
+
+        undoTail-=size;
+        more=r.join;
     }
+    dirty=true;
+    glutPostRedisplay();
 }
 
-void applyNoiseDither(unsigned char *rgba,int W,int H){
-    for(int i=0;i<W*H;i++){
-        int n=(rand()%17)-8;
-        for(int k=0;k<3;k++){
-            int v=rgba[4*i+k]+n;
-            rgba[4*i+k] = v<0?0:(v>255?255:v);
-        }
+//―――― Mipmap Generator ―――――――――――――――――――――――――
+
+// box-filters dst texel (x,y) from the 2x2 block under it in src
+static void mipTexel(const unsigned char *src,int sw,unsigned char *dst,int dw,int x,int y){
+    int r0=y*2,c0=x*2;
+    int i00=(r0*sw+c0)*4, i10=(r0*sw+c0+1)*4;
+    int i01=((r0+1)*sw+c0)*4,i11=((r0+1)*sw+c0+1)*4;
+    for(int k=0;k<3;k++){
+        int v=src[i00+k]+src[i10+k]+src[i01+k]+src[i11+k];
+        dst[(y*dw+x)*4+k]=v/4;
     }
+    dst[(y*dw+x)*4+3]=255;
 }
 
-void applyAtkinsonDither(unsigned char *rgba, int W, int H) {
-    int size = W * H;
-    float *fr = malloc(size * sizeof(float)),
-          *fg = malloc(size * sizeof(float)),
-          *fb = malloc(size * sizeof(float));
+unsigned char* generateMip(unsigned char *src,int sw,int sh,int *dw,int *dh){
+    *dw=sw/2; *dh=sh/2;
+    int w2=*dw, h2=*dh;
+    unsigned char *dst=malloc(w2*h2*4);
+    for(int y=0;y<h2;y++)for(int x=0;x<w2;x++)
+        mipTexel(src,sw,dst,w2,x,y);
+    return dst;
+}
 
-    for (int i = 0; i < size; i++) {
-        fr[i] = rgba[4*i + 0];
-        fg[i] = rgba[4*i + 1];
-        fb[i] = rgba[4*i + 2];
+// refreshes the mip texels above base-level rect [x0,x1) x [y0,y1) of ti
+void updateMipRect(int ti,int x0,int y0,int x1,int y1){
+    unsigned char *lvl[4]={floorRGBA[ti],floorMip1Data[ti],floorMip2Data[ti],floorMip3Data[ti]};
+    for(int l=1;l<4;l++){
+        int dw=TEX_SIZE>>l;
+        x0/=2; y0/=2; x1=(x1+1)/2; y1=(y1+1)/2;
+        for(int y=y0;y<y1;y++)for(int x=x0;x<x1;x++)
+            mipTexel(lvl[l-1],dw*2,lvl[l],dw,x,y);
     }
+}
 
-    for (int y = 0; y < H; y++) {
-        for (int x = 0; x < W; x++) {
-            int i = y * W + x;
-            float oldr = fr[i], oldg = fg[i], oldb = fb[i];
-            int best = 0; float bd = 1e9f;
-
-            for (int c = 0; c < 256; c++) {
-                float dr = oldr - palette[c][0],
-                      dg = oldg - palette[c][1],
-                      db = oldb - palette[c][2];
-                float d = dr*dr + dg*dg + db*db;
-                if (d < bd) { bd = d; best = c; }
-            }
-
-            float nr = palette[best][0], ng = palette[best][1], nb = palette[best][2];
-            rgba[4*i + 0] = (unsigned char)nr;
-            rgba[4*i + 1] = (unsigned char)ng;
-            rgba[4*i + 2] = (unsigned char)nb;
-
-            float er = oldr - nr, eg = oldg - ng, eb = oldb - nb;
-
-            #define ATK(dx, dy, f) \
-                if (x + dx >= 0 && x + dx < W && y + dy >= 0 && y + dy < H) { \
-                    int j = (y + dy) * W + (x + dx); \
-                    fr[j] += er * f; \
-                    fg[j] += eg * f; \
-                    fb[j] += eb * f; \
-                }
-
-            ATK(1, 0, 1/8.0f);
-            ATK(2, 0, 1/8.0f);
-            ATK(-1, 1, 1/8.0f);
-            ATK(0, 1, 1/8.0f);
-            ATK(1, 1, 1/8.0f);
-            ATK(0, 2, 1/8.0f);
-            #undef ATK
+// maps ti's box-filtered mips onto the palette, as saveFileXX writes them
+void quantizeMips(int ti){
+    unsigned char *lvl[3]={floorMip1Data[ti],floorMip2Data[ti],floorMip3Data[ti]};
+    for(int l=0;l<3;l++){
+        int n=(TEX_SIZE>>(l+1))*(TEX_SIZE>>(l+1));
+        for(int p=0;p<n;p++){
+            unsigned char *px=lvl[l]+4*p;
+            floorMipIdx[ti][l][p]=palquant_nearest(&quant,px[0],px[1],px[2]);
         }
     }
+}
 
-    free(fr); free(fg); free(fb);
+//―――― Tile Atlas ―――――――――――――――――――――――――
+//
+// All 64 tiles and their three mip levels share one ATLAS_SIZE^2 index
+// map (see paltex.h), so every view binds once and draws its quads in a
+// single batch, and the palette is looked up on the GPU.  Level l
+// of tile ti sits in an 8x8 grid of slots ATLAS_PAD texels wider on each
+// side than the tile, the border repeating the tile's edge texels so a
+// sample landing on a tile boundary never picks up the neighbour:
+//
+//   level 0: 8 x 66 at (0,0)       level 1: 8 x 34 at (528,0)
+//   level 2: 8 x 18 at (528,272)   level 3: 8 x 10 at (672,272)
+
+static const int atlasOrgX[4]={0,528,528,672}, atlasOrgY[4]={0,0,272,272};
+
+static GLfloat *batchXY, *batchST;
+static int batchLen, batchCap;   // in vertices
+
+static void atlasTileOrigin(int l,int ti,int *x,int *y){
+    int slot=(TEX_SIZE>>l)+2*ATLAS_PAD;
+    *x=atlasOrgX[l]+(ti%8)*slot+ATLAS_PAD;
+    *y=atlasOrgY[l]+(ti/8)*slot+ATLAS_PAD;
 }
 
-void applyDither(unsigned char *rgba,int W,int H){
-    switch(importDitherMode){
-      case DITHER_FS:      applyFSDither(rgba,W,H); break;
-      case DITHER_SL:     applySLDither(rgba,W,H); break;
-      case DITHER_BAYER4: applyBayer4(rgba,W,H);   break;
-      case DITHER_BAYER8: applyBayer8(rgba,W,H);   break;
-      case DITHER_NOISE:  applyNoiseDither(rgba,W,H); break;
-      case DITHER_ATKINSON: applyAtkinsonDither(rgba,W,H); break;
-      default: break;
+// uploads level l of tile ti (size x size indices) with its padded border
+static void atlasUpload(int l,int ti,const unsigned char *idx){
+    int size=TEX_SIZE>>l, slot=size+2*ATLAS_PAD;
+    unsigned char buf[(TEX_SIZE+2*ATLAS_PAD)*(TEX_SIZE+2*ATLAS_PAD)];
+    for(int y=0;y<slot;y++)for(int x=0;x<slot;x++){
+        int sx=x-ATLAS_PAD, sy=y-ATLAS_PAD;
+        sx=sx<0?0:(sx>=size?size-1:sx);
+        sy=sy<0?0:(sy>=size?size-1:sy);
+        buf[y*slot+x]=idx[sy*size+sx];
     }
+    int ox,oy; atlasTileOrigin(l,ti,&ox,&oy);
+    paltex_update(&atlas,buf,ox-ATLAS_PAD,oy-ATLAS_PAD,slot,slot);
 }
 
-//―――― Undo System ―――――――――――――――――――――――――
+// queues the part [u0,u1]x[v0,v1] of tile ti's level l (v runs down the
+// tile) onto the rect x0..x1 (left..right), yt..yb (top..bottom)
+static void atlasQuad(int l,int ti,float u0,float v0,float u1,float v1,
+                      float x0,float yt,float x1,float yb){
+    if(batchLen+4>batchCap){
+        int cap=batchCap?batchCap*2:256;
+        GLfloat *xy=realloc(batchXY,cap*2*sizeof(GLfloat));
+        if(xy) batchXY=xy;
+        GLfloat *st=realloc(batchST,cap*2*sizeof(GLfloat));
+        if(st) batchST=st;
+        if(!xy||!st) return;
+        batchCap=cap;
+    }
+    int ox,oy; atlasTileOrigin(l,ti,&ox,&oy);
+    float sz=(float)(TEX_SIZE>>l)/ATLAS_SIZE;
+    float s0=ox/(float)ATLAS_SIZE+u0*sz, s1=ox/(float)ATLAS_SIZE+u1*sz;
+    float t0=oy/(float)ATLAS_SIZE+v0*sz, t1=oy/(float)ATLAS_SIZE+v1*sz;
+    GLfloat xy[8]={x0,yb, x1,yb, x1,yt, x0,yt};
+    GLfloat st[8]={s0,t1, s1,t1, s1,t0, s0,t0};
+    memcpy(batchXY+batchLen*2,xy,sizeof(xy));
+    memcpy(batchST+batchLen*2,st,sizeof(st));
+    batchLen+=4;
+}
 
-void pushUndoState(int ti) {
-    undoTop = (undoTop + 1) % UNDO_DEPTH;
-    memcpy(undoStack[undoTop].rgba, floorRGBA[ti], TEX_SIZE*TEX_SIZE*4);
-    memcpy(undoStack[undoTop].idx, floorIdx[ti], TEX_SIZE*TEX_SIZE);
-    undoStack[undoTop].tile_index = ti;
+// draws every queued quad in one call
+static void atlasFlush(void){
+    if(!batchLen) return;
+    paltex_bind(&atlas);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2,GL_FLOAT,0,batchXY);
+    glTexCoordPointer(2,GL_FLOAT,0,batchST);
+    glDrawArrays(GL_QUADS,0,batchLen);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    paltex_unbind();
+    batchLen=0;
 }
 
-void undoLastAction(void) {
-    if(undoTop < 0) return;
-    
-    int ti = undoStack[undoTop].tile_index;
-    memcpy(floorRGBA[ti], undoStack[undoTop].rgba, TEX_SIZE*TEX_SIZE*4);
-    memcpy(floorIdx[ti], undoStack[undoTop].idx, TEX_SIZE*TEX_SIZE);
-    
+void updateTileTextures(int ti) {
+    atlasUpload(0, ti, floorIdx[ti]);
+    atlasUpload(1, ti, floorMipIdx[ti][0]);
+    atlasUpload(2, ti, floorMipIdx[ti][1]);
+    atlasUpload(3, ti, floorMipIdx[ti][2]);
+}
+
+// rebuilds ti's mip chain and textures after an edit and queues it for saving
+void tileEdited(int ti) {
     int w1,h1,w2,h2;
-    free(floorMip1Data[ti]); 
-    free(floorMip2Data[ti]); 
-    free(floorMip3Data[ti]);
+    free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
     floorMip1Data[ti] = generateMip(floorRGBA[ti],64,64,&w1,&h1);
     floorMip2Data[ti] = generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
     floorMip3Data[ti] = generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-    
+    quantizeMips(ti);
     updateTileTextures(ti);
-    undoTop--;
+    tileDirty[ti] = true;
     dirty = true;
-    glutPostRedisplay();
-}
-
-//―――― Mipmap Generator ―――――――――――――――――――――――――
-
-unsigned char* generateMip(unsigned char *src,int sw,int sh,int *dw,int *dh){
-    *dw=sw/2; *dh=sh/2;
-    int w2=*dw, h2=*dh;
-    unsigned char *dst=malloc(w2*h2*4);
-    for(int y=0;y<h2;y++)for(int x=0;x<w2;x++){
-        int r0=y*2,c0=x*2;
-        int i00=(r0*sw+c0)*4, i10=(r0*sw+c0+1)*4;
-        int i01=((r0+1)*sw+c0)*4,i11=((r0+1)*sw+c0+1)*4;
-        for(int k=0;k<3;k++){
-            int v=src[i00+k]+src[i10+k]+src[i01+k]+src[i11+k];
-            dst[(y*w2+x)*4+k]=v/4;
-        }
-        dst[(y*w2+x)*4+3]=255;
-    }
-    return dst;
-}
-
-//―――― Texture Updates ―――――――――――――――――――――――――
-
-void updateTileTextures(int ti) {
-    glBindTexture(GL_TEXTURE_2D, texBase[ti]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 64, 64, GL_RGBA, GL_UNSIGNED_BYTE, floorRGBA[ti]);
-    
-    glBindTexture(GL_TEXTURE_2D, texMip1[ti]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 32, 32, GL_RGBA, GL_UNSIGNED_BYTE, floorMip1Data[ti]);
-    
-    glBindTexture(GL_TEXTURE_2D, texMip2[ti]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 16, 16, GL_RGBA, GL_UNSIGNED_BYTE, floorMip2Data[ti]);
-    
-    glBindTexture(GL_TEXTURE_2D, texMip3[ti]);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 8, 8, GL_RGBA, GL_UNSIGNED_BYTE, floorMip3Data[ti]);
 }
 
 //―――― Tile Manipulation ―――――――――――――――――――――――――
 
 void flipTileHorizontal(void){
     int ti = sel.y*8 + sel.x;
-    pushUndoState(ti);
     
     unsigned char newRGBA[64*64*4];
     unsigned char newIdx[64*64];
@@ -406,23 +420,16 @@ void flipTileHorizontal(void){
         }
     }
     
+    if(!undoRecord(ti, newIdx, false)) return;   // symmetric tile
     memcpy(floorRGBA[ti], newRGBA, 64*64*4);
     memcpy(floorIdx[ti], newIdx, 64*64);
     
-    int w1,h1,w2,h2;
-    free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-    floorMip1Data[ti] = generateMip(floorRGBA[ti],64,64,&w1,&h1);
-    floorMip2Data[ti] = generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-    floorMip3Data[ti] = generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-    
-    updateTileTextures(ti);
-    dirty = true;
+    tileEdited(ti);
     glutPostRedisplay();
 }
 
 void flipTileVertical(void){
     int ti = sel.y*8 + sel.x;
-    pushUndoState(ti);
     
     unsigned char newRGBA[64*64*4];
     unsigned char newIdx[64*64];
@@ -436,23 +443,16 @@ void flipTileVertical(void){
         }
     }
     
+    if(!undoRecord(ti, newIdx, false)) return;   // symmetric tile
     memcpy(floorRGBA[ti], newRGBA, 64*64*4);
     memcpy(floorIdx[ti], newIdx, 64*64);
     
-    int w1,h1,w2,h2;
-    free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-    floorMip1Data[ti] = generateMip(floorRGBA[ti],64,64,&w1,&h1);
-    floorMip2Data[ti] = generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-    floorMip3Data[ti] = generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-    
-    updateTileTextures(ti);
-    dirty = true;
+    tileEdited(ti);
     glutPostRedisplay();
 }
 
 void rotateTile90(void){
     int ti = sel.y*8 + sel.x;
-    pushUndoState(ti);
     
     unsigned char newRGBA[64*64*4];
     unsigned char newIdx[64*64];
@@ -466,26 +466,22 @@ void rotateTile90(void){
         }
     }
     
+    if(!undoRecord(ti, newIdx, false)) return;   // symmetric tile
     memcpy(floorRGBA[ti], newRGBA, 64*64*4);
     memcpy(floorIdx[ti], newIdx, 64*64);
     
-    int w1,h1,w2,h2;
-    free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-    floorMip1Data[ti] = generateMip(floorRGBA[ti],64,64,&w1,&h1);
-    floorMip2Data[ti] = generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-    floorMip3Data[ti] = generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-    
-    updateTileTextures(ti);
-    dirty = true;
+    tileEdited(ti);
     glutPostRedisplay();
 }
 
 //―――― File I/O and Imports ―――――――――――――――――――――――――
 
+// built-in palette when path is NULL
 void loadPalette(const char *path){
-    FILE *f=fopen(path,"rb"); if(!f){fprintf(stderr,"pal\n");exit(1);}
-    for(int i=0;i<256;i++) fread(palette[i],1,3,f);
-    fclose(f);
+    Palette pal;
+    if(!palio_load(path,&pal)){fprintf(stderr,"pal\n");exit(1);}
+    memcpy(palette,pal.rgb,sizeof(palette));
+    if(!palquant_init(&quant,palette)){fprintf(stderr,"pal\n");exit(1);}
     defaultBgIndex=0;
     for(int i=0;i<256;i++){
         if(palette[i][0]==0x48&&palette[i][1]==0x58&&palette[i][2]==0x58){
@@ -516,6 +512,13 @@ void loadFloors(const char *path){
             floorRGBA[i][4*p+2]=palette[ci][2];
             floorRGBA[i][4*p+3]=255;
         }
+        // keep the stored mips until the tile is edited
+        unsigned char *mp=ptr+TEX_SIZE*TEX_SIZE;
+        for(int l=0;l<3;l++){
+            int n=(TEX_SIZE>>(l+1))*(TEX_SIZE>>(l+1));
+            memcpy(floorMipIdx[i][l],mp,n);
+            mp+=n;
+        }
         ptr+=perTile;
     }
     for(int i=0;i<MAX_FLOORS;i++){
@@ -607,12 +610,7 @@ void pasteTileFromClipboard(){
     unsigned char newRGBA[64*64*4], newIdx[64*64];
     for(int p=0;p<64*64;p++){
         unsigned char R=buf[4*p+0],G=buf[4*p+1],B=buf[4*p+2];
-        int best=0,bd=INT_MAX;
-        for(int c=0;c<256;c++){
-            int dr=R-palette[c][0], dg=G-palette[c][1], db=B-palette[c][2];
-            int d=dr*dr+dg*dg+db*db;
-            if(d<bd){bd=d;best=c;}
-        }
+        int best=palquant_nearest(&quant,R,G,B);
         newIdx[p]=best;
         newRGBA[4*p+0]=palette[best][0];
         newRGBA[4*p+1]=palette[best][1];
@@ -621,16 +619,11 @@ void pasteTileFromClipboard(){
     }
     free(buf);
     int ti=sel.y*8+sel.x;
-    pushUndoState(ti);
+    if(!undoRecord(ti,newIdx,false)) return;
     memcpy(floorRGBA[ti],newRGBA,64*64*4);
     memcpy(floorIdx [ti],newIdx ,64*64);
-    int w1,h1,w2,h2;
-    free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-    floorMip1Data[ti]=generateMip(floorRGBA[ti],64,64,&w1,&h1);
-    floorMip2Data[ti]=generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-    floorMip3Data[ti]=generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-    updateTileTextures(ti);
-    dirty=true; glutPostRedisplay();
+    tileEdited(ti);
+    glutPostRedisplay();
 #else
     fprintf(stderr,"Clipboard not supported\n");
 #endif
@@ -644,6 +637,7 @@ void importGridPNG(){
     if(!img){fprintf(stderr,"load %s\n",in);return;}
     if(W!=512||H!=512){fprintf(stderr,"need 512×512\n");stbi_image_free(img);return;}
     applyDither(img,512,512);
+    bool joined=false;   // one undo step for the whole grid
     for(int ty=0;ty<8;ty++)for(int tx=0;tx<8;tx++){
       unsigned char newRGBA[64*64*4], newIdx[64*64];
       for(int py=0;py<64;py++)for(int px=0;px<64;px++){
@@ -657,32 +651,20 @@ void importGridPNG(){
       }
       for(int p=0;p<64*64;p++){
         unsigned char R=newRGBA[4*p+0],G=newRGBA[4*p+1],B=newRGBA[4*p+2];
-        int best=0,bd=INT_MAX;
-        for(int c=0;c<256;c++){
-            int dr=R-palette[c][0], dg=G-palette[c][1], db=B-palette[c][2];
-            int d=dr*dr+dg*dg+db*db;
-            if(d<bd){bd=d;best=c;}
-        }
+        int best=palquant_nearest(&quant,R,G,B);
         newIdx[p]=best;
         newRGBA[4*p+0]=palette[best][0];
         newRGBA[4*p+1]=palette[best][1];
         newRGBA[4*p+2]=palette[best][2];
       }
       int ti=ty*8+tx;
-      pushUndoState(ti);
+      if(!undoRecord(ti,newIdx,joined)) continue;   // unchanged tile
+      joined=true;
       memcpy(floorRGBA[ti],newRGBA,64*64*4);
       memcpy(floorIdx [ti],newIdx ,64*64);
+      tileEdited(ti);
     }
     stbi_image_free(img);
-    for(int ti=0;ti<MAX_FLOORS;ti++){
-      int w1,h1,w2,h2;
-      free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-      floorMip1Data[ti]=generateMip(floorRGBA[ti],64,64,&w1,&h1);
-      floorMip2Data[ti]=generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-      floorMip3Data[ti]=generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-      updateTileTextures(ti);
-    }
-    dirty=true; 
     glutPostRedisplay();
     glutSwapBuffers();
 }
@@ -693,6 +675,7 @@ void importTilesFromManifest(){
     char mfpath[512]; sprintf(mfpath,"%s/%s.txt",folder,base);
     FILE *mf=fopen(mfpath,"r"); if(!mf) return;
     char line[512];
+    bool joined=false;   // one undo step for the whole manifest
     
     while(fgets(line,sizeof(line),mf)){
         char *nl=strchr(line,'\n'); if(nl)*nl='\0';
@@ -705,12 +688,7 @@ void importTilesFromManifest(){
         
         for(int p=0;p<64*64;p++){
             unsigned char R=img[4*p+0],G=img[4*p+1],B=img[4*p+2];
-            int best=0,bd=INT_MAX;
-            for(int c=0;c<256;c++){
-                int dr=R-palette[c][0], dg=G-palette[c][1], db=B-palette[c][2];
-                int d=dr*dr+dg*dg+db*db;
-                if(d<bd){bd=d;best=c;}
-            }
+            int best=palquant_nearest(&quant,R,G,B);
             newIdx[p]=best;
             newRGBA[4*p+0]=palette[best][0];
             newRGBA[4*p+1]=palette[best][1];
@@ -722,21 +700,15 @@ void importTilesFromManifest(){
         char *us=strrchr(line,'_'), *dot=strrchr(line,'.');
         if(!us||!dot) continue;
         int ti=atoi(us+1); if(ti<0||ti>=MAX_FLOORS) continue;
+        if(!undoRecord(ti,newIdx,joined)) continue;   // unchanged tile
+        joined=true;
         
-        pushUndoState(ti);
         memcpy(floorRGBA[ti],newRGBA,64*64*4);
         memcpy(floorIdx [ti],newIdx ,64*64);
-        
-        int w1,h1,w2,h2;
-        free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-        floorMip1Data[ti]=generateMip(floorRGBA[ti],64,64,&w1,&h1);
-        floorMip2Data[ti]=generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-        floorMip3Data[ti]=generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-        updateTileTextures(ti);
+        tileEdited(ti);
     }
     fclose(mf);
     
-    dirty=true; 
     glutPostRedisplay();
     glutSwapBuffers();
 }
@@ -759,12 +731,7 @@ void importSelectedTile(){
     
     for(int p=0;p<64*64;p++){
         unsigned char R=img[4*p+0],G=img[4*p+1],B=img[4*p+2];
-        int best=0,bd=INT_MAX;
-        for(int c=0;c<256;c++){
-            int dr=R-palette[c][0], dg=G-palette[c][1], db=B-palette[c][2];
-            int d=dr*dr+dg*dg+db*db;
-            if(d<bd){bd=d;best=c;}
-        }
+        int best=palquant_nearest(&quant,R,G,B);
         newIdx[p]=best;
         newRGBA[4*p+0]=palette[best][0];
         newRGBA[4*p+1]=palette[best][1];
@@ -774,67 +741,73 @@ void importSelectedTile(){
     
     stbi_image_free(img);
     int ti=sel.y*8+sel.x;
-    pushUndoState(ti);
-    memcpy(floorRGBA[ti],newRGBA,64*64*4);
-    memcpy(floorIdx [ti],newIdx ,64*64);
-    
-    int w1,h1,w2,h2;
-    free(floorMip1Data[ti]); free(floorMip2Data[ti]); free(floorMip3Data[ti]);
-    floorMip1Data[ti]=generateMip(floorRGBA[ti],64,64,&w1,&h1);
-    floorMip2Data[ti]=generateMip(floorMip1Data[ti],w1,h1,&w2,&h2);
-    floorMip3Data[ti]=generateMip(floorMip2Data[ti],w2,h2,&w2,&h2);
-    updateTileTextures(ti);
+    if(undoRecord(ti,newIdx,false)){
+        memcpy(floorRGBA[ti],newRGBA,64*64*4);
+        memcpy(floorIdx [ti],newIdx ,64*64);
+        tileEdited(ti);
+    }
     
-    dirty=true;
     glutPostRedisplay();
     glutSwapBuffers();
 }
 
+// the file on disk may be patched only while it is still the one we loaded
+static bool sameFileXX(FILE *f){
+    unsigned char hd[HEADER_SIZE];
+    return fileSize>=HEADER_SIZE
+        && fseek(f,0,SEEK_END)==0 && ftell(f)==fileSize
+        && fseek(f,0,SEEK_SET)==0 && fread(hd,1,HEADER_SIZE,f)==HEADER_SIZE
+        && memcmp(hd,fileBuf,HEADER_SIZE)==0;
+}
+
+// writes back only the tiles edited since the last save: their indices and
+// quantized mips are patched into the file in place
 void saveFileXX(){
     size_t baseSz=TEX_SIZE*TEX_SIZE;
     size_t m1=(TEX_SIZE/2)*(TEX_SIZE/2),
            m2=(TEX_SIZE/4)*(TEX_SIZE/4),
            m3=(TEX_SIZE/8)*(TEX_SIZE/8);
     size_t perTile=baseSz+m1+m2+m3+UNKNOWN_BYTES;
+    int edited=0;
     for(int i=0;i<MAX_FLOORS;i++){
+        if(!tileDirty[i]) continue;
+        edited++;
         unsigned char *dst=fileBuf+HEADER_SIZE+i*perTile;
         memcpy(dst,floorIdx[i],baseSz);
-        unsigned char *p1=dst+baseSz;
-        for(int p=0;p<m1;p++){
-            unsigned char *px=floorMip1Data[i]+4*p;
-            int best=0,bd=INT_MAX;
-            for(int c=0;c<256;c++){
-                int dr=px[0]-palette[c][0], dg=px[1]-palette[c][1], db=px[2]-palette[c][2];
-                int d=dr*dr+dg*dg+db*db; if(d<bd){bd=d;best=c;}
-            }
-            p1[p]=best;
-        }
-        unsigned char *p2=p1+m1;
-        for(int p=0;p<m2;p++){
-            unsigned char *px=floorMip2Data[i]+4*p;
-            int best=0,bd=INT_MAX;
-            for(int c=0;c<256;c++){
-                int dr=px[0]-palette[c][0], dg=px[1]-palette[c][1], db=px[2]-palette[c][2];
-                int d=dr*dr+dg*dg+db*db; if(d<bd){bd=d;best=c;}
-            }
-            p2[p]=best;
-        }
-        unsigned char *p3=p2+m2;
-        for(int p=0;p<m3;p++){
-            unsigned char *px=floorMip3Data[i]+4*p;
-            int best=0,bd=INT_MAX;
-            for(int c=0;c<256;c++){
-                int dr=px[0]-palette[c][0], dg=px[1]-palette[c][1], db=px[2]-palette[c][2];
-                int d=dr*dr+dg*dg+db*db; if(d<bd){bd=d;best=c;}
-            }
-            p3[p]=best;
+        memcpy(dst+baseSz,floorMipIdx[i][0],m1);
+        memcpy(dst+baseSz+m1,floorMipIdx[i][1],m2);
+        memcpy(dst+baseSz+m1+m2,floorMipIdx[i][2],m3);
+    }
+
+    // patch the existing file; if it has gone missing or no longer matches
+    // what was loaded, write the whole buffer to a temp file and rename it over
+    FILE *f=fopen(g_filename,"r+b");
+    bool ok=f&&sameFileXX(f);
+    if(ok){
+        for(int i=0;i<MAX_FLOORS&&ok;i++){
+            if(!tileDirty[i]) continue;
+            long off=HEADER_SIZE+i*(long)perTile;
+            ok=fseek(f,off,SEEK_SET)==0
+            && fwrite(fileBuf+off,1,perTile-UNKNOWN_BYTES,f)==perTile-UNKNOWN_BYTES;
         }
+        if(fclose(f)) ok=false;
+    } else {
+        if(f) fclose(f);
+        char tmp[1024];
+        snprintf(tmp,sizeof(tmp),"%s.tmp",g_filename);
+        f=fopen(tmp,"wb");
+        if(!f){perror("saveFileXX");return;}
+        ok=fwrite(fileBuf,1,fileSize,f)==(size_t)fileSize;
+        if(fclose(f)) ok=false;
+#ifdef _WIN32
+        if(ok) remove(g_filename);
+#endif
+        if(ok&&rename(tmp,g_filename)) ok=false;
+        if(!ok) remove(tmp);
     }
-    FILE *f=fopen(g_filename,"wb");
-    if(!f){perror("saveFileXX");return;}
-    fwrite(fileBuf,1,fileSize,f);
-    fclose(f);
-    dirty=false; printf("Saved %s\n",g_filename);
+    if(!ok){perror("saveFileXX");return;}
+    memset(tileDirty,0,sizeof(tileDirty));
+    dirty=false; printf("Saved %s (%d tiles changed)\n",g_filename,edited);
 }
 
 void setClearColorFromPalette(){
@@ -845,31 +818,17 @@ void setClearColorFromPalette(){
 void initGL(){
     glEnable(GL_TEXTURE_2D);
     glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
-    glGenTextures(MAX_FLOORS,texBase);
-    glGenTextures(MAX_FLOORS,texMip1);
-    glGenTextures(MAX_FLOORS,texMip2);
-    glGenTextures(MAX_FLOORS,texMip3);
-    for(int i=0;i<MAX_FLOORS;i++){
-        glBindTexture(GL_TEXTURE_2D,texBase[i]);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,64,64,0,GL_RGBA,GL_UNSIGNED_BYTE,floorRGBA[i]);
-
-        glBindTexture(GL_TEXTURE_2D,texMip1[i]);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,32,32,0,GL_RGBA,GL_UNSIGNED_BYTE,floorMip1Data[i]);
-
-        glBindTexture(GL_TEXTURE_2D,texMip2[i]);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,16,16,0,GL_RGBA,GL_UNSIGNED_BYTE,floorMip2Data[i]);
-
-        glBindTexture(GL_TEXTURE_2D,texMip3[i]);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-        glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,8,8,0,GL_RGBA,GL_UNSIGNED_BYTE,floorMip3Data[i]);
+    if(glewInit()==GLEW_OK) paltex_init();
+    paltex_palette(palette,NULL);
+    unsigned char *blank=calloc(ATLAS_SIZE,ATLAS_SIZE);
+    if(!blank||!paltex_create(&atlas,blank,ATLAS_SIZE,ATLAS_SIZE)){
+        fprintf(stderr,"atlas\n"); exit(1);
     }
+    free(blank);
+    glBindTexture(GL_TEXTURE_2D,atlas.tex);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP);
+    for(int i=0;i<MAX_FLOORS;i++) updateTileTextures(i);
     setClearColorFromPalette();
     computeViewport(windowW,windowH);
     glViewport(viewportX,viewportY,viewportW,viewportH);
@@ -915,7 +874,7 @@ void renderOverlay(){
     const char *ctrls[] = {
         "F1 : Toggle UI","T   : Tile Pattern view","M   :Mipmap view",
         "Arrows : Navigate","+/- : Zoom","ESC : Reset GUI",
-        "PgUp/Dn: Change BG color", "U : Undo (100x)"
+        "PgUp/Dn: Change BG color", "U : Undo"
     };
     for(int i=0;i<8;i++) drawText(ctrls[i],10,windowH-120 - i*15);
     
@@ -961,16 +920,10 @@ void display(){
 
     if(mode==MODE_GRID){
         for(int y=0;y<8;y++)for(int x=0;x<8;x++){
-            int idx=y*8+x;
-            float vx=-half+x*step, vy=half-(y+1)*step;
-            glBindTexture(GL_TEXTURE_2D,texBase[idx]);
-            glBegin(GL_QUADS);
-              glTexCoord2f(0,1); glVertex2f(vx,vy);
-              glTexCoord2f(1,1); glVertex2f(vx+step,vy);
-              glTexCoord2f(1,0); glVertex2f(vx+step,vy+step);
-              glTexCoord2f(0,0); glVertex2f(vx,vy+step);
-            glEnd();
+            float vx=-half+x*step, vy=half-y*step;
+            atlasQuad(0,y*8+x,0,0,1,1,vx,vy,vx+step,vy-step);
         }
+        atlasFlush();
         glColor3f(1,0,0); glLineWidth(1); glBegin(GL_LINE_LOOP);
           float x0=-half+sel.x*step, y0=half-sel.y*step;
           glVertex2f(x0,y0); glVertex2f(x0+step,y0);
@@ -978,33 +931,25 @@ void display(){
         glEnd(); glColor3f(1,1,1);
     }
     else if(mode==MODE_TILE){
+        // the atlas cannot wrap, so lay the repeats out as quads
         int idx=sel.y*8+sel.x;
-        glBindTexture(GL_TEXTURE_2D,texBase[idx]);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
         float rx=(viewportW/(float)TEX_SIZE)*zoomLevel,
               ry=(viewportH/(float)TEX_SIZE)*zoomLevel;
-        glBegin(GL_QUADS);
-          glTexCoord2f(0,ry);  glVertex2f(-1,-1);
-          glTexCoord2f(rx,ry); glVertex2f( 1,-1);
-          glTexCoord2f(rx,0);  glVertex2f( 1, 1);
-          glTexCoord2f(0,0);   glVertex2f(-1, 1);
-        glEnd();
+        float sx=2.0f/rx, sy=2.0f/ry;
+        for(int j=0;j<ry;j++)for(int i=0;i<rx;i++){
+            float u1=rx-i<1?rx-i:1, v1=ry-j<1?ry-j:1;
+            float x0=-1+i*sx, y0=1-j*sy;
+            atlasQuad(0,idx,0,0,u1,v1,x0,y0,x0+u1*sx,y0-v1*sy);
+        }
+        atlasFlush();
     }
     else {
-        GLuint *lvl[4]={texBase,texMip1,texMip2,texMip3};
         for(int i=0;i<4;i++){
-            GLuint t=lvl[i][sel.y*8+sel.x];
-            glBindTexture(GL_TEXTURE_2D,t);
             int qx=i%2, qy=i/2;
-            float x0=-1+qx, y0=1-qy, x1=x0+1, y1=y0-1;
-            glBegin(GL_QUADS);
-              glTexCoord2f(0,1); glVertex2f(x0,y1);
-              glTexCoord2f(1,1); glVertex2f(x1,y1);
-              glTexCoord2f(1,0); glVertex2f(x1,y0);
-              glTexCoord2f(0,0); glVertex2f(x0,y0);
-            glEnd();
+            float x0=-1+qx, y0=1-qy;
+            atlasQuad(i,sel.y*8+sel.x,0,0,1,1,x0,y0,x0+1,y0-1);
         }
+        atlasFlush();
     }
 
     renderOverlay();
@@ -1085,9 +1030,16 @@ void onMouse(int b,int s,int mx,int my){
 }
 
 int main(int argc,char **argv){
+    const char *palFile=palio_option(&argc,argv,NULL);
     g_filename = (argc>1)? argv[1] : "FLOORS.XX";
+    for(int i=2;i+1<argc;i++){
+        if(!strcmp(argv[i],"-undo")){
+            int mb=atoi(argv[++i]);
+            undoBudget=(size_t)(mb>1?mb:1)<<20;
+        }
+    }
     srand(12345);
-    loadPalette("chasmpalette.act");
+    loadPalette(palFile);
     loadFloors(g_filename);
 
     glutInit(&argc,argv);
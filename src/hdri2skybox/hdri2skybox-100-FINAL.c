@@ -1,11 +1,13 @@
 // hdri2skybox.c
-// x86_64-w64-mingw32-gcc -std=c11     -I. -I./stb     hdri2skybox.c     -L./lib -lfreeglut -lglu32 -lopengl32 -lm     -o hdri2skybox.exe hdri2skybox.res
+// x86_64-w64-mingw32-gcc -std=c11     -I. -I./stb -I../../include     hdri2skybox.c ../workpool/workpool.c     -lz -lm     -o hdri2skybox.exe hdri2skybox.res
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <errno.h>
+#include <zlib.h>
 #ifdef _WIN32
   #include <direct.h>
   #define MKDIR(p) _mkdir(p)
@@ -14,12 +16,17 @@
   #include <sys/types.h>
   #define MKDIR(p) mkdir(p, 0755)
 #endif
-#include <GL/freeglut.h>           // just to create a GL context
+#include "workpool.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKY_X86 1
+#include <immintrin.h>
+#endif
+
 // normalize a 3D vector in-place
 static void normalize3(float v[3]) {
     float len = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
@@ -28,16 +35,434 @@ static void normalize3(float v[3]) {
     }
 }
 
-// nearest-neighbor sample from equirectangular map
-static unsigned char fetchEquirect(
-    const unsigned char *img, int W, int H, int C,
-    float u, float v, int ch)
+// nearest-neighbor pixel index in the equirectangular map
+static size_t equirectPixel(int W, int H, float u, float v)
 {
     int x = (int)(u*(W-1) + 0.5f),
         y = (int)(v*(H-1) + 0.5f);
     if (x<0) x=0; else if (x>=W) x=W-1;
     if (y<0) y=0; else if (y>=H) y=H-1;
-    return img[(y*W + x)*C + ch];
+    return (size_t)y*W + x;
+}
+
+// faces are cut into row tiles so six faces spread over any core count
+#define TILE_ROWS 32
+// faces are produced in groups whose map + RGB buffers fit in this many
+// bytes, so a large faceSize keeps only one face resident at a time
+#define GROUP_BYTES ((size_t)256 << 20)
+
+// The sampling map holds, for every face pixel (faces 0..5, row-major),
+// the equirect pixel it copies.  It depends only on (W, H, faceSize), so
+// with -cache it is stored once and later conversions are a pure gather.
+// Only the slice for the current face group is kept in memory.
+typedef struct {
+    char    magic[8];                 // "SKYMAP1"
+    int32_t W, H, faceSize;
+} SkyMapHeader;
+
+typedef void (*GatherFn)(unsigned char *out, const unsigned char *pan,
+                         const uint32_t *idx, size_t n, uint32_t last);
+
+typedef struct {
+    const unsigned char *pan;
+    int            W, H, faceSize, tilesPerFace;
+    int            face0, nfaces;     // faces of the current group
+    size_t         count;             // nfaces * faceSize^2
+    uint32_t      *map;               // equirect pixel index per group pixel
+    unsigned char *faces;             // the group's faces back to back, RGB
+    unsigned char *face[6];
+    GatherFn       gather;
+    uint32_t       bandFirst, bandEnd;  // resident equirect pixels (streaming)
+    uint32_t      *tileLo, *tileHi;     // map index range of each gather tile
+    char           path[6][512];
+    int            ok[6];
+} SkyJob;
+
+static void mapTile(void *ctx, size_t item, int worker)
+{
+    SkyJob *job = ctx;
+    int faceSize = job->faceSize;
+    int lf = (int)(item / job->tilesPerFace), f = job->face0 + lf;
+    int y0 = (int)(item % job->tilesPerFace) * TILE_ROWS;
+    int y1 = y0 + TILE_ROWS < faceSize ? y0 + TILE_ROWS : faceSize;
+    (void)worker;
+
+    for (int y = y0; y < y1; ++y) {
+        // NDC → [-1..1]
+        float V = 2.0f*(y+0.5f)/faceSize - 1.0f;
+        uint32_t *out = job->map + ((size_t)lf*faceSize + y)*faceSize;
+        for (int x = 0; x < faceSize; ++x) {
+            float U = 2.0f*(x+0.5f)/faceSize - 1.0f;
+            // build direction
+            float d[3];
+            switch(f) {
+              case 0: d[0]=-1; d[1]=-V; d[2]= U; break; // left
+              case 1: d[0]=+1; d[1]=-V; d[2]=-U; break; // right
+              case 2: d[0]= U; d[1]=+1; d[2]= V; break; // top
+              case 3: d[0]= U; d[1]=-1; d[2]=-V; break; // bottom
+              case 4: d[0]= U; d[1]=-V; d[2]=+1; break; // front
+              default:d[0]=-U; d[1]=-V; d[2]=-1; break; // back
+            }
+            normalize3(d);
+
+            // spherical coords
+            float theta = atan2f(d[2], d[0]);
+            float phi   = asinf(d[1]);
+            float eu = (theta + M_PI)/(2.0f*M_PI);
+            float ev = (phi   + M_PI/2.0f)/M_PI;
+            // flip V for image row-0=top
+            float sampleV = 1.0f - ev;
+
+            out[x] = (uint32_t)equirectPixel(job->W, job->H, eu, sampleV);
+        }
+    }
+}
+
+static void gather_scalar(unsigned char *out, const unsigned char *pan,
+                          const uint32_t *idx, size_t n, uint32_t last)
+{
+    (void)last;
+    for (size_t i = 0; i < n; ++i) {
+        const unsigned char *src = pan + (size_t)idx[i]*3;
+        out[3*i+0] = src[0];
+        out[3*i+1] = src[1];
+        out[3*i+2] = src[2];
+    }
+}
+
+#ifdef SKY_X86
+// 8 pixels per step: gather RGBx dwords, pack each lane to 12 bytes.
+// The dword read at the last equirect pixel would run past the image, so
+// any block touching it goes scalar; stores spill 4 bytes, so stop 2 early.
+__attribute__((target("avx2")))
+static void gather_avx2(unsigned char *out, const unsigned char *pan,
+                        const uint32_t *idx, size_t n, uint32_t last)
+{
+    const __m256i pack = _mm256_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1,
+                                          0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    const __m256i vlast = _mm256_set1_epi32((int)last);
+    const __m256i three = _mm256_set1_epi32(3);
+    size_t i = 0;
+    for (; i + 10 <= n; i += 8) {
+        __m256i vi = _mm256_loadu_si256((const __m256i*)(idx + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(vi, vlast))) {
+            gather_scalar(out + 3*i, pan, idx + i, 8, last);
+            continue;
+        }
+        __m256i px = _mm256_i32gather_epi32((const int*)pan, _mm256_mullo_epi32(vi, three), 1);
+        px = _mm256_shuffle_epi8(px, pack);
+        _mm_storeu_si128((__m128i*)(out + 3*i),      _mm256_castsi256_si128(px));
+        _mm_storeu_si128((__m128i*)(out + 3*i + 12), _mm256_extracti128_si256(px, 1));
+    }
+    gather_scalar(out + 3*i, pan, idx + i, n - i, last);
+}
+#endif
+
+static void gatherTile(void *ctx, size_t item, int worker)
+{
+    SkyJob *job = ctx;
+    size_t tile = (size_t)TILE_ROWS*job->faceSize;
+    size_t i0 = item*tile, n = i0 + tile < job->count ? tile : job->count - i0;
+    (void)worker;
+    job->gather(job->faces + 3*i0, job->pan, job->map + i0, n,
+                (uint32_t)((size_t)job->W*job->H - 1));
+}
+
+// Bounded-memory mode: a non-interlaced 8/16-bit PNG is inflated row by
+// row and only a band of rows is kept; each band fills the face pixels
+// whose map entry falls inside it.  Rows are converted exactly like
+// stbi_load(..., 3) (grey replicated, alpha dropped, 16-bit -> high byte),
+// so the output matches the whole-image path.
+typedef struct {
+    FILE          *f;
+    z_stream       zs;
+    int            W, H, colorType, depth, channels;
+    size_t         bpp, stride;       // filter unit and row size in bytes
+    unsigned char *cur, *prev;        // filter byte + row
+    unsigned char  plte[256][3];
+    uint32_t       idatLeft;          // unread bytes of the current IDAT
+    unsigned char  in[65536];
+} PngStream;
+
+static uint32_t be32(const unsigned char *p)
+{
+    return (uint32_t)p[0]<<24 | (uint32_t)p[1]<<16 | (uint32_t)p[2]<<8 | p[3];
+}
+
+static int pngChunk(FILE *f, uint32_t *len, char type[5])
+{
+    unsigned char hd[8];
+    if (fread(hd, 1, 8, f) != 8) return 0;
+    *len = be32(hd);
+    memcpy(type, hd+4, 4);
+    type[4] = '\0';
+    return 1;
+}
+
+static void pngClose(PngStream *ps)
+{
+    if (!ps->f) return;
+    inflateEnd(&ps->zs);
+    fclose(ps->f);
+    free(ps->cur); free(ps->prev);
+    ps->f = NULL;
+}
+
+// 1 if path is a PNG we can stream; 0 means fall back to stbi_load
+static int pngOpen(PngStream *ps, const char *path)
+{
+    static const int chans[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    memset(ps, 0, sizeof(*ps));
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    unsigned char sig[8], ihdr[13];
+    int haveHdr = 0, havePlte = 0;
+    uint32_t len;
+    char type[5];
+    if (fread(sig, 1, 8, f) != 8 || memcmp(sig, "\x89PNG\r\n\x1a\n", 8)) goto fail;
+    while (pngChunk(f, &len, type)) {
+        if (!strcmp(type, "IDAT")) {
+            ps->idatLeft = len;
+            break;
+        }
+        if (!strcmp(type, "IHDR") && len == 13) {
+            if (fread(ihdr, 1, 13, f) != 13) goto fail;
+            haveHdr = 1;
+            len = 0;
+        } else if (!strcmp(type, "PLTE") && len <= 768 && len % 3 == 0) {
+            if (fread(ps->plte, 1, len, f) != len) goto fail;
+            havePlte = 1;
+            len = 0;
+        }
+        if (fseek(f, (long)len + 4, SEEK_CUR)) goto fail;   // data + CRC
+    }
+    if (!haveHdr || strcmp(type, "IDAT")) goto fail;
+
+    ps->W = (int)be32(ihdr);  ps->H = (int)be32(ihdr+4);
+    ps->depth = ihdr[8];      ps->colorType = ihdr[9];
+    if (ps->W <= 0 || ps->H <= 0 || ihdr[10] || ihdr[11] || ihdr[12]) goto fail;
+    if (ps->colorType > 6 || !chans[ps->colorType]) goto fail;
+    if (ps->depth != 8 && !(ps->depth == 16 && ps->colorType != 3)) goto fail;
+    if (ps->colorType == 3 && !havePlte) goto fail;
+
+    ps->channels = chans[ps->colorType];
+    ps->bpp      = (size_t)ps->channels * ps->depth / 8;
+    ps->stride   = (size_t)ps->W * ps->bpp;
+    ps->cur  = malloc(ps->stride + 1);
+    ps->prev = calloc(ps->stride + 1, 1);
+    if (!ps->cur || !ps->prev || inflateInit(&ps->zs) != Z_OK) {
+        free(ps->cur); free(ps->prev);
+        goto fail;
+    }
+    ps->f = f;
+    return 1;
+fail:
+    fclose(f);
+    return 0;
+}
+
+// refill zlib input from the IDAT chunk sequence
+static int pngFeed(PngStream *ps)
+{
+    while (!ps->idatLeft) {
+        uint32_t len;
+        char type[5];
+        if (fseek(ps->f, 4, SEEK_CUR) || !pngChunk(ps->f, &len, type)
+         || strcmp(type, "IDAT")) return 0;
+        ps->idatLeft = len;
+    }
+    size_t n = ps->idatLeft < sizeof(ps->in) ? ps->idatLeft : sizeof(ps->in);
+    if (fread(ps->in, 1, n, ps->f) != n) return 0;
+    ps->idatLeft -= (uint32_t)n;
+    ps->zs.next_in  = ps->in;
+    ps->zs.avail_in = (uInt)n;
+    return 1;
+}
+
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p-a), pb = abs(p-b), pc = abs(p-c);
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+// next image row as W*3 RGB bytes
+static int pngReadRow(PngStream *ps, unsigned char *rgb)
+{
+    z_stream *zs = &ps->zs;
+    zs->next_out  = ps->cur;
+    zs->avail_out = (uInt)(ps->stride + 1);
+    while (zs->avail_out) {
+        if (!zs->avail_in && !pngFeed(ps)) return 0;
+        int r = inflate(zs, Z_NO_FLUSH);
+        if (r == Z_STREAM_END) { if (zs->avail_out) return 0; break; }
+        if (r != Z_OK && r != Z_BUF_ERROR) return 0;
+    }
+
+    unsigned char *x = ps->cur + 1;
+    const unsigned char *b = ps->prev + 1;
+    size_t bpp = ps->bpp;
+    switch (ps->cur[0]) {
+      case 0: break;
+      case 1: for (size_t i = bpp; i < ps->stride; ++i) x[i] += x[i-bpp]; break;
+      case 2: for (size_t i = 0; i < ps->stride; ++i) x[i] += b[i]; break;
+      case 3:
+        for (size_t i = 0; i < ps->stride; ++i)
+            x[i] += ((i >= bpp ? x[i-bpp] : 0) + b[i]) >> 1;
+        break;
+      case 4:
+        for (size_t i = 0; i < ps->stride; ++i)
+            x[i] += i >= bpp ? paeth(x[i-bpp], b[i], b[i-bpp]) : paeth(0, b[i], 0);
+        break;
+      default: return 0;
+    }
+
+    int step = ps->depth / 8;          // 16-bit samples keep the high byte
+    for (int px = 0; px < ps->W; ++px) {
+        const unsigned char *s = x + (size_t)px*ps->bpp;
+        unsigned char *o = rgb + (size_t)px*3;
+        switch (ps->colorType) {
+          case 0: case 4: o[0] = o[1] = o[2] = s[0]; break;
+          case 3:         memcpy(o, ps->plte[s[0]], 3); break;
+          default:        o[0] = s[0]; o[1] = s[step]; o[2] = s[2*step]; break;
+        }
+    }
+    unsigned char *t = ps->cur; ps->cur = ps->prev; ps->prev = t;
+    return 1;
+}
+
+static void rangeTile(void *ctx, size_t item, int worker)
+{
+    SkyJob *job = ctx;
+    size_t tile = (size_t)TILE_ROWS*job->faceSize;
+    size_t i0 = item*tile, n = i0 + tile < job->count ? tile : job->count - i0;
+    uint32_t lo = UINT32_MAX, hi = 0;
+    (void)worker;
+    for (size_t i = i0; i < i0 + n; ++i) {
+        if (job->map[i] < lo) lo = job->map[i];
+        if (job->map[i] > hi) hi = job->map[i];
+    }
+    job->tileLo[item] = lo;
+    job->tileHi[item] = hi;
+}
+
+static void bandTile(void *ctx, size_t item, int worker)
+{
+    SkyJob *job = ctx;
+    if (job->tileHi[item] < job->bandFirst || job->tileLo[item] >= job->bandEnd) return;
+    size_t tile = (size_t)TILE_ROWS*job->faceSize;
+    size_t i0 = item*tile, n = i0 + tile < job->count ? tile : job->count - i0;
+    uint32_t first = job->bandFirst, len = job->bandEnd - job->bandFirst;
+    (void)worker;
+    for (size_t i = i0; i < i0 + n; ++i) {
+        uint32_t p = job->map[i] - first;
+        if (p < len) memcpy(job->faces + 3*i, job->pan + (size_t)p*3, 3);
+    }
+}
+
+// bytes resident while streaming a group of n faces: faces, map, tile
+// ranges, the PNG row pair and one face being compressed
+static size_t streamFixed(const PngStream *ps, int faceSize, int n)
+{
+    size_t px = (size_t)faceSize*faceSize;
+    size_t tiles = ((size_t)n*faceSize + TILE_ROWS-1) / TILE_ROWS;
+    return n*px*(3 + sizeof(uint32_t)) + tiles*2*sizeof(uint32_t)
+         + 2*(ps->stride + 1) + 2*px*3;
+}
+
+// decode the PNG in bands of rows for the current group; 1 on success
+static int streamBands(PngStream *ps, SkyJob *job, size_t rows, int threads)
+{
+    size_t tiles = ((size_t)job->nfaces*job->faceSize + TILE_ROWS-1) / TILE_ROWS;
+    size_t rowBytes = (size_t)job->W*3;
+    unsigned char *band = malloc(rows*rowBytes);
+    job->tileLo = malloc(tiles*sizeof(uint32_t));
+    job->tileHi = malloc(tiles*sizeof(uint32_t));
+    int ok = band && job->tileLo && job->tileHi;
+    if (ok) workpool_run(tiles, threads, rangeTile, job);
+    job->pan = band;
+    for (int y0 = 0; ok && y0 < job->H; y0 += (int)rows) {
+        int y1 = y0 + (int)rows < job->H ? y0 + (int)rows : job->H;
+        for (int y = y0; ok && y < y1; ++y)
+            ok = pngReadRow(ps, band + (size_t)(y-y0)*rowBytes);
+        job->bandFirst = (uint32_t)((size_t)y0*job->W);
+        job->bandEnd   = (uint32_t)((size_t)y1*job->W);
+        if (ok) workpool_run(tiles, threads, bandTile, job);
+    }
+    job->pan = NULL;
+    free(band);
+    free(job->tileLo); free(job->tileHi);
+    job->tileLo = job->tileHi = NULL;
+    return ok;
+}
+
+static void cachePath(char *path, size_t len, const char *dir, int W, int H, int faceSize)
+{
+    snprintf(path, len, "%s/skymap_%dx%d_%d.bin", dir, W, H, faceSize);
+}
+
+// the cached map for (W, H, faceSize) if it exists and is complete
+static FILE *openMap(const char *path, const SkyJob *job)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    SkyMapHeader hd;
+    size_t size = sizeof(hd) + (size_t)6*job->faceSize*job->faceSize*sizeof(uint32_t);
+    int ok = fread(&hd, sizeof(hd), 1, f) == 1
+          && !memcmp(hd.magic, "SKYMAP1", 8)
+          && hd.W == job->W && hd.H == job->H && hd.faceSize == job->faceSize
+          && !fseek(f, 0, SEEK_END) && (size_t)ftell(f) == size;
+    if (!ok) { fclose(f); return NULL; }
+    return f;
+}
+
+// 1 if the current group's slice was read from an open map
+static int loadMap(FILE *f, SkyJob *job)
+{
+    long off = (long)(sizeof(SkyMapHeader)
+             + (size_t)job->face0*job->faceSize*job->faceSize*sizeof(uint32_t));
+    int ok = !fseek(f, off, SEEK_SET)
+          && fread(job->map, sizeof(uint32_t), job->count, f) == job->count;
+    // a foreign file must never index outside the image
+    size_t pixels = (size_t)job->W*job->H;
+    for (size_t i = 0; ok && i < job->count; ++i)
+        if (job->map[i] >= pixels) ok = 0;
+    return ok;
+}
+
+// the map is written group by group to path.tmp, then renamed into place
+static FILE *createMap(const char *tmp, const SkyJob *job)
+{
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return NULL;
+    SkyMapHeader hd = { "SKYMAP1", job->W, job->H, job->faceSize };
+    if (fwrite(&hd, sizeof(hd), 1, f) != 1) {
+        fclose(f);
+        remove(tmp);
+        return NULL;
+    }
+    return f;
+}
+
+static int commitMap(FILE *f, int ok, const char *tmp, const char *path)
+{
+    if (fclose(f)) ok = 0;
+#ifdef _WIN32
+    if (ok) remove(path);
+#endif
+    if (!ok || rename(tmp, path)) {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+static void writeFace(void *ctx, size_t f, int worker)
+{
+    SkyJob *job = ctx;
+    (void)worker;
+    job->ok[job->face0 + f] = stbi_write_png(job->path[job->face0 + f],
+                                             job->faceSize, job->faceSize, 3,
+                                             job->face[f], job->faceSize*3);
 }
 
 // pick faceSize = highest power-of-two ≤ min(W/4, H/2)
@@ -49,10 +474,25 @@ static int deriveFaceSize(int W, int H) {
 }
 
 int main(int argc, char **argv) {
+    // -threads N / -cache DIR may appear anywhere; 0 threads = one per CPU
+    int threads = 0;
+    // -budget MB streams PNG input in row bands to cap memory
+    const char *cacheDir = NULL;
+    double budgetMB = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char *opt = argv[i];
+        if ((!strcmp(opt, "-threads") || !strcmp(opt, "-cache") || !strcmp(opt, "-budget")) && i+1 < argc) {
+            if      (opt[1] == 't') threads  = atoi(argv[i+1]);
+            else if (opt[1] == 'c') cacheDir = argv[i+1];
+            else                    budgetMB = atof(argv[i+1]);
+            memmove(&argv[i], &argv[i+2], (argc-i-1)*sizeof(char*));
+            argc -= 2; --i;
+        }
+    }
     if (argc < 2 || argc > 3) {
         fprintf(stderr, 
             "HDRI to SKYBOX Converter v1.0.0 by SMR9000\n\n"
-            "Usage: %s <input.jpg/png> [faceSize]\n\n"
+            "Usage: %s <input.jpg/png> [faceSize] [-threads N] [-cache DIR] [-budget MB]\n\n"
             "Use https://www.manyworlds.run to create HDRI skybox\n"
             "This Tool uses only HDRI images in PNG/JPG as input\n"
             "Drag and drop image on executable to autogenerate size\n"
@@ -64,17 +504,28 @@ int main(int argc, char **argv) {
     int manual = (argc==3), faceSize = manual ? atoi(argv[2]) : 0;
 
     // load the panorama first so we can auto-derive size if needed
+    // (with -budget only the PNG header is read here)
     int W,H,C;
-    unsigned char *pan = stbi_load(infile, &W,&H,&C, 3);
-    if (!pan) {
-        fprintf(stderr, "Error: failed to load “%s”\n", infile);
-        return 1;
+    unsigned char *pan = NULL;
+    static PngStream png;
+    int streaming = budgetMB > 0 && pngOpen(&png, infile);
+    if (streaming) {
+        W = png.W; H = png.H;
+    } else {
+        if (budgetMB > 0)
+            printf("Note: only non-interlaced PNGs stream; loading “%s” whole\n", infile);
+        pan = stbi_load(infile, &W,&H,&C, 3);
+        if (!pan) {
+            fprintf(stderr, "Error: failed to load “%s”\n", infile);
+            return 1;
+        }
     }
     if (!manual) {
         faceSize = deriveFaceSize(W,H);
         if (faceSize < 2) {
             fprintf(stderr, "Error: panorama too small ( %dx%d )\n", W,H);
             stbi_image_free(pan);
+            pngClose(&png);
             return 1;
         }
         printf("Auto-derived faceSize = %d\n", faceSize);
@@ -99,74 +550,120 @@ int main(int argc, char **argv) {
     if (MKDIR(base) != 0 && errno != EEXIST) {
         perror("mkdir");
         stbi_image_free(pan);
+        pngClose(&png);
         return 1;
     }
 
-    // tiny hidden GLUT context
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_RGBA|GLUT_DOUBLE|GLUT_DEPTH);
-    glutInitWindowSize(1,1);
-    glutCreateWindow("HDRI to SKYBOX Converter v1.0.0 by SMR9000");
-
-    // buffer for one face
-    unsigned char *face = malloc(faceSize*faceSize*3);
-    if (!face) {
+    // faces are built a group at a time: the map slice and RGB buffers of
+    // one group are filled tile by tile in parallel, then compressed
+    size_t facePx = (size_t)faceSize*faceSize;
+    int group = (int)(GROUP_BYTES / (facePx*(3 + sizeof(uint32_t))));
+    if (group < 1) group = 1;
+    if (group > 6) group = 6;
+    // a streamed PNG is decoded once per group, so take the largest group
+    // that leaves the budget room for at least one row
+    size_t rows = 0;
+    if (streaming) {
+        size_t budget = (size_t)(budgetMB*1024*1024), rowBytes = (size_t)W*3;
+        for (group = 6; group > 0 && streamFixed(&png, faceSize, group) + rowBytes > budget; --group)
+            ;
+        if (!group) {
+            fprintf(stderr, "Error: -budget %g is below the %zu MB needed for one face\n",
+                    budgetMB, ((streamFixed(&png, faceSize, 1) + rowBytes) >> 20) + 1);
+            pngClose(&png);
+            return 1;
+        }
+        rows = (budget - streamFixed(&png, faceSize, group)) / rowBytes;
+        if (rows > (size_t)H) rows = H;
+        printf("Streaming %dx%d in %zu-row bands, %d face%s per pass\n",
+               W, H, rows, group, group > 1 ? "s" : "");
+    }
+    SkyJob job = { .pan = pan, .W = W, .H = H, .faceSize = faceSize,
+                   .tilesPerFace = (faceSize + TILE_ROWS-1) / TILE_ROWS };
+    job.faces = malloc((size_t)group*facePx*3);
+    job.map   = malloc((size_t)group*facePx*sizeof(uint32_t));
+    if (!job.faces || !job.map || (size_t)W*H > UINT32_MAX) {
         fprintf(stderr, "Error: out of memory\n");
+        free(job.faces); free(job.map);
         stbi_image_free(pan);
+        pngClose(&png);
         return 1;
     }
+    job.gather = gather_scalar;
+#ifdef SKY_X86
+    // gather offsets are 32-bit signed byte offsets
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && (size_t)W*H*3 < INT32_MAX)
+        job.gather = gather_avx2;
+#endif
 
     // swap .cel.0 <-> .cel.1 in the filename map
     int faceMap[6] = { 1, 0, 2, 3, 4, 5 };
 
-    // generate all 6 faces
     for (int f = 0; f < 6; ++f) {
-        for (int y = 0; y < faceSize; ++y) {
-            for (int x = 0; x < faceSize; ++x) {
-                // NDC → [-1..1]
-                float U = 2.0f*(x+0.5f)/faceSize - 1.0f;
-                float V = 2.0f*(y+0.5f)/faceSize - 1.0f;
-                // build direction
-                float d[3];
-                switch(f) {
-                  case 0: d[0]=-1; d[1]=-V; d[2]= U; break; // left
-                  case 1: d[0]=+1; d[1]=-V; d[2]=-U; break; // right
-                  case 2: d[0]= U; d[1]=+1; d[2]= V; break; // top
-                  case 3: d[0]= U; d[1]=-1; d[2]=-V; break; // bottom
-                  case 4: d[0]= U; d[1]=-V; d[2]=+1; break; // front
-                  default:d[0]=-U; d[1]=-V; d[2]=-1; break; // back
-                }
-                normalize3(d);
-
-                // spherical coords
-                float theta = atan2f(d[2], d[0]);
-                float phi   = asinf(d[1]);
-                float eu = (theta + M_PI)/(2.0f*M_PI);
-                float ev = (phi   + M_PI/2.0f)/M_PI;
-                // flip V for image row-0=top
-                float sampleV = 1.0f - ev;
-
-                for (int c = 0; c < 3; ++c) {
-                    face[(y*faceSize + x)*3 + c] =
-                      fetchEquirect(pan, W,H,3, eu, sampleV, c);
-                }
-            }
-        }
+        snprintf(job.path[f], sizeof(job.path[f]),
+                 "%s/%s.cel.%d.png", base, base, faceMap[f]);
+    }
 
-        // determine output index and path
-        int outF = faceMap[f];
-        char path[512];
-        snprintf(path, sizeof(path),
-                 "%s/%s.cel.%d.png", base, base, outF);
+    // sampling map: from the cache when possible, else computed (and stored)
+    char mapPath[512], mapTmp[600];
+    FILE *mapIn = NULL, *mapOut = NULL;
+    int mapOk = 1;
+    if (cacheDir) {
+        cachePath(mapPath, sizeof(mapPath), cacheDir, W, H, faceSize);
+        snprintf(mapTmp, sizeof(mapTmp), "%s.tmp", mapPath);
+        if ((mapIn = openMap(mapPath, &job)) != NULL)
+            printf("Using cached map: %s\n", mapPath);
+        else if ((MKDIR(cacheDir) != 0 && errno != EEXIST)
+              || (mapOut = createMap(mapTmp, &job)) == NULL)
+            fprintf(stderr, "Warning: could not cache map in “%s”\n", cacheDir);
+    }
 
-        if (!stbi_write_png(path, faceSize, faceSize, 3, face, faceSize*3)) {
-            fprintf(stderr, "Error: failed to write “%s”\n", path);
+    // gather each group, then compress its faces concurrently
+    // (one at a time when streaming, to stay inside the budget)
+    int failed = 0;
+    for (int f0 = 0; f0 < 6; f0 += group) {
+        job.face0  = f0;
+        job.nfaces = 6 - f0 < group ? 6 - f0 : group;
+        job.count  = (size_t)job.nfaces*facePx;
+        for (int f = 0; f < job.nfaces; ++f)
+            job.face[f] = job.faces + (size_t)f*facePx*3;
+
+        if (!mapIn || !loadMap(mapIn, &job))
+            workpool_run((size_t)job.nfaces*job.tilesPerFace, threads, mapTile, &job);
+        if (mapOut && mapOk)
+            mapOk = fwrite(job.map, sizeof(uint32_t), job.count, mapOut) == job.count;
+
+        if (streaming) {
+            int ok = (f0 == 0 || (pngOpen(&png, infile) && png.W == W && png.H == H))
+                  && streamBands(&png, &job, rows, threads);
+            pngClose(&png);
+            if (!ok) {
+                fprintf(stderr, "Error: failed to decode “%s”\n", infile);
+                failed = 1;
+                break;
+            }
         } else {
-            printf("Wrote: %s\n", path);
+            workpool_run(((size_t)job.nfaces*faceSize + TILE_ROWS-1) / TILE_ROWS,
+                         threads, gatherTile, &job);
+        }
+        workpool_run(job.nfaces, streaming ? 1 : threads, writeFace, &job);
+
+        for (int f = f0; f < f0 + job.nfaces; ++f) {
+            if (!job.ok[f]) {
+                fprintf(stderr, "Error: failed to write “%s”\n", job.path[f]);
+                failed = 1;
+            } else {
+                printf("Wrote: %s\n", job.path[f]);
+            }
         }
     }
 
-    free(face);
+    if (mapIn) fclose(mapIn);
+    if (mapOut && !commitMap(mapOut, mapOk && !failed, mapTmp, mapPath))
+        fprintf(stderr, "Warning: could not cache map in “%s”\n", cacheDir);
+    free(job.faces);
+    free(job.map);
     stbi_image_free(pan);
-    return 0;
+    return failed;
 }
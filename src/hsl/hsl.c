@@ -0,0 +1,164 @@
+// hsl.c - batch HSL adjustment (see include/hsl.h)
+
+#include <math.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "hsl.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HSL_X86 1
+#include <immintrin.h>
+#endif
+
+#define HSL_TINY 1e-20f
+
+typedef void (*HslKernel)(const HslShift *t, const uint8_t *src, uint8_t *dst,
+                          size_t n, int stride);
+
+static inline float clamp01(float v) { return v < 0 ? 0 : (v > 1 ? 1 : v); }
+
+static inline uint8_t to_byte(float v) {
+    v = v * 255.0f + 0.5f;
+    return (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+//―――― Scalar kernel ―――――――――――――――――――――――――――
+
+static void apply_scalar(const HslShift *t, const uint8_t *src, uint8_t *dst,
+                         size_t n, int stride) {
+    for (size_t i = 0; i < n; i++, src += stride, dst += stride) {
+        float r = src[0] / 255.0f, g = src[1] / 255.0f, b = src[2] / 255.0f;
+        float mx = fmaxf(fmaxf(r, g), b), mn = fminf(fminf(r, g), b);
+        float d = mx - mn, l = (mx + mn) * 0.5f;
+        float inv = 1.0f / fmaxf(d, HSL_TINY);
+        float s = d > 0 ? d / fmaxf(1.0f - fabsf(2.0f*l - 1.0f), HSL_TINY) : 0;
+
+        // hue in sextants [0,6)
+        float h = mx == r ? (g - b)*inv + (g < b ? 6.0f : 0.0f)
+                : mx == g ? (b - r)*inv + 2.0f
+                :           (r - g)*inv + 4.0f;
+        if (!(d > 0)) h = 0;
+
+        h = h * 60.0f + t->hue;
+        h -= 360.0f * floorf(h * (1.0f/360.0f));
+        s = clamp01(s * t->sat);
+        l = clamp01(l * t->light);
+
+        float a = s * fminf(l, 1.0f - l);
+        static const float off[3] = { 0.0f, 8.0f, 4.0f };
+        for (int c = 0; c < 3; c++) {
+            float k = off[c] + h * (1.0f/30.0f);
+            k -= 12.0f * floorf(k * (1.0f/12.0f));
+            float m = fmaxf(-1.0f, fminf(fminf(k - 3.0f, 9.0f - k), 1.0f));
+            dst[c] = to_byte(l - a*m);
+        }
+        if (stride == 4) dst[3] = src[3];
+    }
+}
+
+#ifdef HSL_X86
+
+//―――― AVX2 kernel (8 pixels per register) ――――――――――――――――
+
+__attribute__((target("avx2")))
+static void apply_avx2(const HslShift *t, const uint8_t *src, uint8_t *dst,
+                       size_t n, int stride) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 tiny = _mm256_set1_ps(HSL_TINY), absm = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 hue = _mm256_set1_ps(t->hue), sat = _mm256_set1_ps(t->sat), light = _mm256_set1_ps(t->light);
+    const __m256 k255 = _mm256_set1_ps(255.0f), inv255 = _mm256_set1_ps(1.0f/255.0f);
+
+    for (size_t i = 0; i < n; i += 8) {
+        int cnt = n - i < 8 ? (int)(n - i) : 8;
+        float fr[8] = { 0 }, fg[8] = { 0 }, fb[8] = { 0 };
+        const uint8_t *p = src + i*stride;
+        for (int j = 0; j < cnt; j++, p += stride) { fr[j] = p[0]; fg[j] = p[1]; fb[j] = p[2]; }
+
+        __m256 r = _mm256_mul_ps(_mm256_loadu_ps(fr), inv255);
+        __m256 g = _mm256_mul_ps(_mm256_loadu_ps(fg), inv255);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(fb), inv255);
+        __m256 mx = _mm256_max_ps(_mm256_max_ps(r, g), b);
+        __m256 mn = _mm256_min_ps(_mm256_min_ps(r, g), b);
+        __m256 d  = _mm256_sub_ps(mx, mn);
+        __m256 l  = _mm256_mul_ps(_mm256_add_ps(mx, mn), _mm256_set1_ps(0.5f));
+        __m256 has = _mm256_cmp_ps(d, zero, _CMP_GT_OQ);
+        __m256 inv = _mm256_div_ps(one, _mm256_max_ps(d, tiny));
+        __m256 den = _mm256_sub_ps(one, _mm256_and_ps(absm,
+                         _mm256_sub_ps(_mm256_add_ps(l, l), one)));
+        __m256 s = _mm256_and_ps(has, _mm256_div_ps(d, _mm256_max_ps(den, tiny)));
+
+        __m256 hr = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(g, b), inv),
+                        _mm256_and_ps(_mm256_cmp_ps(g, b, _CMP_LT_OQ), _mm256_set1_ps(6.0f)));
+        __m256 hg = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(b, r), inv), _mm256_set1_ps(2.0f));
+        __m256 hb = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(r, g), inv), _mm256_set1_ps(4.0f));
+        __m256 h = _mm256_blendv_ps(hb, hg, _mm256_cmp_ps(mx, g, _CMP_EQ_OQ));
+        h = _mm256_blendv_ps(h, hr, _mm256_cmp_ps(mx, r, _CMP_EQ_OQ));
+        h = _mm256_and_ps(has, h);
+
+        h = _mm256_add_ps(_mm256_mul_ps(h, _mm256_set1_ps(60.0f)), hue);
+        h = _mm256_sub_ps(h, _mm256_mul_ps(_mm256_set1_ps(360.0f),
+                _mm256_floor_ps(_mm256_mul_ps(h, _mm256_set1_ps(1.0f/360.0f)))));
+        s = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(s, sat), zero), one);
+        l = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(l, light), zero), one);
+
+        __m256 a  = _mm256_mul_ps(s, _mm256_min_ps(l, _mm256_sub_ps(one, l)));
+        __m256 h30 = _mm256_mul_ps(h, _mm256_set1_ps(1.0f/30.0f));
+        static const float off[3] = { 0.0f, 8.0f, 4.0f };
+        int32_t out[3][8];
+        for (int c = 0; c < 3; c++) {
+            __m256 k = _mm256_add_ps(_mm256_set1_ps(off[c]), h30);
+            k = _mm256_sub_ps(k, _mm256_mul_ps(_mm256_set1_ps(12.0f),
+                    _mm256_floor_ps(_mm256_mul_ps(k, _mm256_set1_ps(1.0f/12.0f)))));
+            __m256 m = _mm256_min_ps(_mm256_sub_ps(k, _mm256_set1_ps(3.0f)),
+                                     _mm256_sub_ps(_mm256_set1_ps(9.0f), k));
+            m = _mm256_max_ps(_mm256_set1_ps(-1.0f), _mm256_min_ps(m, one));
+            __m256 v = _mm256_sub_ps(l, _mm256_mul_ps(a, m));
+            v = _mm256_add_ps(_mm256_mul_ps(v, k255), _mm256_set1_ps(0.5f));
+            v = _mm256_min_ps(_mm256_max_ps(v, zero), k255);
+            _mm256_storeu_si256((__m256i*)out[c], _mm256_cvttps_epi32(v));
+        }
+
+        const uint8_t *ps = src + i*stride;
+        uint8_t *pd = dst + i*stride;
+        for (int j = 0; j < cnt; j++, ps += stride, pd += stride) {
+            uint8_t alpha = stride == 4 ? ps[3] : 0;
+            pd[0] = (uint8_t)out[0][j];
+            pd[1] = (uint8_t)out[1][j];
+            pd[2] = (uint8_t)out[2][j];
+            if (stride == 4) pd[3] = alpha;
+        }
+    }
+}
+
+#endif
+
+//―――― Dispatch ―――――――――――――――――――――――――――――
+
+// picked on first use, possibly by several workpool workers at once: each
+// computes the same answer, and kernel_isa is set before kernel publishes it
+static _Atomic(HslKernel)   kernel;
+static _Atomic(const char *) kernel_isa;
+
+static HslKernel pick_kernel(void) {
+    HslKernel k = atomic_load(&kernel);
+    if (k) return k;
+    k = apply_scalar;
+    const char *isa = "scalar";
+#ifdef HSL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { k = apply_avx2; isa = "avx2"; }
+#endif
+    atomic_store(&kernel_isa, isa);
+    atomic_store(&kernel, k);
+    return k;
+}
+
+void hsl_apply(const HslShift *t, const uint8_t *src, uint8_t *dst,
+               size_t n, int stride) {
+    pick_kernel()(t, src, dst, n, stride);
+}
+
+const char *hsl_isa(void) {
+    pick_kernel();
+    return atomic_load(&kernel_isa);
+}
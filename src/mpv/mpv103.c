@@ -16,12 +16,14 @@
 //   .raw3/.raw4  (as .txt containing 0xRRGGBB or 0xRRGGBBAA lines)
 //   .aco          Adobe Color Swatch v1
 //   .h            C header with static const uint8_t …[256][3]
-//   .png/.pcx     16×16 indexed preview via stb_image.h
+//   .png/.bmp/.gif 16×16 preview
+//   .lut          cubegen binary LUT
+// Formats are recognised by content (palio), so the extension doesn't matter.
 //
 // Build (MinGW/WSL):
-// x86_64-w64-mingw32-gcc -std=c99 -O2 -DSTB_IMAGE_IMPLEMENTATION MPV102.c     -Iinclude -Llib -lfreeglut -lopengl32 -lglu32 -lm -o mpv.exe multipaletteviewer.res
+// x86_64-w64-mingw32-gcc -std=c99 -O2 MPV102.c ../palio/palio.c     -Iinclude -I../../include -Llib -lfreeglut -lopengl32 -lglu32 -lm -o mpv.exe multipaletteviewer.res
 //
-// Place stb_image.h alongside MPV.c.
+// stb_image.h must be on the include path for palio.c.
 // --------------------------------------------------
 
 #include <stdio.h>
@@ -30,179 +32,17 @@
 #include <string.h>
 #include <ctype.h>
 #include <GL/freeglut.h>
-#include "stb_image.h"   // STB_IMAGE_IMPLEMENTATION defined at compile time
-
-#ifndef _GNU_SOURCE
-char *strcasestr(const char *hay, const char *needle) {
-    if (!*needle) return (char*)hay;
-    for (; *hay; hay++) {
-        const char *h=hay, *n=needle;
-        while (*h && *n && tolower((unsigned char)*h)==tolower((unsigned char)*n)) { h++; n++; }
-        if (!*n) return (char*)hay;
-        hay++;
-    }
-    return NULL;
-}
-#endif
+#include "palio.h"
 
 static uint8_t palette[256][3];
 
-// scale 6→8 bit if needed
-static void scale6to8(){
-    uint8_t mx=0;
-    for(int i=0;i<256;i++)for(int c=0;c<3;c++) if(palette[i][c]>mx) mx=palette[i][c];
-    if(mx<=63) for(int i=0;i<256;i++)for(int c=0;c<3;c++) palette[i][c]<<=2;
-}
-
-// ── 768-byte binary loader (.act, .lmp, raw .PAL) ─────────
-static int load_binary(const char *fn){
-    FILE *f=fopen(fn,"rb"); if(!f) return 0;
-    if(fread(palette,1,768,f)!=768){ fclose(f); return 0; }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── JASC .pal ASCII ────────────────────────────────────────
-static int load_jasc(const char *fn){
-    FILE *f=fopen(fn,"r"); if(!f) return 0;
-    char buf[128];
-    if(!fgets(buf,sizeof(buf),f)||strncmp(buf,"JASC-PAL",8)){ fclose(f); return 0; }
-    fgets(buf,sizeof(buf),f); fgets(buf,sizeof(buf),f);
-    for(int i=0;i<256;i++){
-        int r,g,b;
-        if(fscanf(f,"%d %d %d",&r,&g,&b)!=3){ fclose(f); return 0; }
-        palette[i][0]=r; palette[i][1]=g; palette[i][2]=b;
-    }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── GIMP .gpl ASCII ────────────────────────────────────────
-static int load_gpl(const char *fn){
-    FILE *f=fopen(fn,"r"); if(!f) return 0;
-    char buf[128];
-    while(fgets(buf,sizeof(buf),f)&&buf[0]!='#');
-    for(int i=0;i<256;i++){
-        int r,g,b;
-        if(fscanf(f,"%d %d %d",&r,&g,&b)!=3){ fclose(f); return 0; }
-        palette[i][0]=r; palette[i][1]=g; palette[i][2]=b;
-        fgets(buf,sizeof(buf),f);
-    }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── Txt grid .txt ───────────────────────────────────────────
-static int load_txtgrid(const char *fn){
-    FILE *f=fopen(fn,"r"); if(!f) return 0;
-    char buf[128];
-    for(int i=0;i<6;i++) if(!fgets(buf,sizeof(buf),f)){ fclose(f); return 0; }
-    for(int i=0;i<256;i++){
-        int r,g,b;
-        if(!fgets(buf,sizeof(buf),f)||sscanf(buf,"R: %d, G: %d, B: %d",&r,&g,&b)!=3){
-            fclose(f); return 0;
-        }
-        palette[i][0]=r; palette[i][1]=g; palette[i][2]=b;
-    }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── Raw3 .txt (0xRRGGBB) ────────────────────────────────────
-static int load_raw3(const char *fn){
-    FILE *f=fopen(fn,"r"); if(!f) return 0;
-    char buf[128];
-    for(int i=0;i<256;i++){
-        if(!fgets(buf,sizeof(buf),f)){ fclose(f); return 0; }
-        unsigned r,g,b;
-        if(sscanf(buf,"0x%2x%2x%2x",&r,&g,&b)!=3){ fclose(f); return 0; }
-        palette[i][0]=r; palette[i][1]=g; palette[i][2]=b;
-    }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── Raw4 .txt (0xRRGGBBAA) ──────────────────────────────────
-static int load_raw4(const char *fn){
-    FILE *f=fopen(fn,"r"); if(!f) return 0;
-    char buf[128];
-    for(int i=0;i<256;i++){
-        if(!fgets(buf,sizeof(buf),f)){ fclose(f); return 0; }
-        unsigned r,g,b,a;
-        if(sscanf(buf,"0x%2x%2x%2x%2x",&r,&g,&b,&a)!=4){ fclose(f); return 0; }
-        palette[i][0]=r; palette[i][1]=g; palette[i][2]=b;
-    }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── ACO v1 ───────────────────────────────────────────────────
-static int load_aco(const char *fn){
-    FILE *f=fopen(fn,"rb"); if(!f) return 0;
-    uint16_t ver,cnt; fread(&ver,2,1,f); fread(&cnt,2,1,f);
-    ver=(ver<<8)|(ver>>8); cnt=(cnt<<8)|(cnt>>8);
-    if(ver!=1||cnt<256){ fclose(f); return 0; }
-    for(int i=0;i<256;i++){
-        uint16_t sp,r,g,b,p;
-        fread(&sp,2,1,f); fread(&r,2,1,f);
-        fread(&g,2,1,f); fread(&b,2,1,f);
-        fread(&p,2,1,f);
-        r=(r<<8)|(r>>8); g=(g<<8)|(g>>8); b=(b<<8)|(b>>8);
-        palette[i][0]=r>>8; palette[i][1]=g>>8; palette[i][2]=b>>8;
-    }
-    fclose(f); scale6to8(); return 1;
-}
-
-// ── C header .h ─────────────────────────────────────────────
-static int load_c_header(const char *fn){
-    FILE *f=fopen(fn,"r"); if(!f) return 0;
-    fseek(f,0,SEEK_END); size_t sz=ftell(f); rewind(f);
-    char *buf=malloc(sz+1); fread(buf,1,sz,f); buf[sz]=0; fclose(f);
-    char *p=strchr(buf,'{'); if(!p){ free(buf); return 0; }
-    p++;
-    int vals[768],cnt=0;
-    while(cnt<768 && *p){
-        while(*p && !isdigit((unsigned char)*p)) p++;
-        if(!*p) break;
-        vals[cnt++]=strtol(p,&p,10);
-    }
-    free(buf); if(cnt<768) return 0;
-    for(int i=0;i<256;i++){
-        palette[i][0]=vals[i*3+0];
-        palette[i][1]=vals[i*3+1];
-        palette[i][2]=vals[i*3+2];
-    }
-    scale6to8(); return 1;
-}
-
-// ── PNG/PCX via stb_image (16×16 preview) ───────────────────
-static int load_image16(const char *fn){
-    int w,h,c; unsigned char *img=stbi_load(fn,&w,&h,&c,3);
-    if(!img||w!=16||h!=16){ if(img) stbi_image_free(img); return 0; }
-    for(int i=0;i<256;i++){
-        palette[i][0]=img[i*3+0];
-        palette[i][1]=img[i*3+1];
-        palette[i][2]=img[i*3+2];
-    }
-    stbi_image_free(img); scale6to8(); return 1;
-}
-
-// ── dispatch loader ─────────────────────────────────────────
+// any format palio knows, detected from the content
 static int load_palette(const char *fn){
-    const char *ext=strrchr(fn,'.'); if(!ext) return 0;
-    if(!strcasecmp(ext,".act")||!strcasecmp(ext,".lmp")) return load_binary(fn);
-    if(!strcasecmp(ext,".pal")){
-        // try JASC first, then raw .PAL binary
-        if(load_jasc(fn)) return 1;
-        return load_binary(fn);
-    }
-    if(!strcasecmp(ext,".gpl"))    return load_gpl(fn);
-    if(!strcasecmp(ext,".txt")){
-        FILE *f=fopen(fn,"r"); if(!f) return 0;
-        char buf[64]; fgets(buf,sizeof(buf),f); fclose(f);
-        if(!strncmp(buf,"ROWS",4))             return load_txtgrid(fn);
-        if(strcasestr(buf,"0x")&&strchr(buf,'A')) return load_raw4(fn);
-        if(strcasestr(buf,"0x"))               return load_raw3(fn);
-        return 0;
-    }
-    if(!strcasecmp(ext,".aco"))    return load_aco(fn);
-    if(!strcasecmp(ext,".h"))      return load_c_header(fn);
-    if(!strcasecmp(ext,".png")||!strcasecmp(ext,".pcx")) return load_image16(fn);
-    return 0;
+    Palette pal;
+    if(!palio_load(fn,&pal)) return 0;
+    memcpy(palette,pal.rgb,768);
+    printf("%s: %s palette%s\n",fn,palio_format_name(pal.format),pal.scaled?" (6-bit, scaled)":"");
+    return 1;
 }
 
 // print help
@@ -215,7 +55,9 @@ static void print_help(const char *p){
            "  .txt          grid or raw-hex\n"
            "  .aco          Adobe Color Swatch v1\n"
            "  .h            C header [256][3]\n"
-           "  .png, .pcx    16×16 preview\n");
+           "  .png, .bmp    16×16 preview\n"
+           "  .lut          cubegen binary LUT\n"
+           "(recognised by content, not extension)\n");
 }
 
 // prevent resizing
@@ -1,4 +1,4 @@
-// x86_64-w64-mingw32-gcc -std=c11 -O2 objtool100.c -I. -o objtool.exe objtool.res
+// x86_64-w64-mingw32-gcc -std=c11 -O2 objtool100.c ../palquant/palquant.c ../dither/dither.c ../workpool/workpool.c ../pngidx/pngidx.c ../palio/palio.c ../chasmpal/chasmpal.c -I. -I../../include -o objtool.exe objtool.res
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -17,9 +17,11 @@
 #endif
 
 #define STB_IMAGE_IMPLEMENTATION
-#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
-#include "stb_image_write.h"
+#include "palquant.h"
+#include "dither.h"
+#include "pngidx.h"
+#include "palio.h"
 
 #pragma pack(push,1)
 typedef struct {
@@ -27,17 +29,16 @@ typedef struct {
 } FrameHeader;
 #pragma pack(pop)
 
-// load 256-color Chasm palette
+// load 256-color Chasm palette (built in unless -palette is given)
 static uint8_t palette[256][3];
+static const char *pal_file;
 static int load_palette(void) {
-    FILE *f = fopen("chasmpalette.act","rb");
-    if (!f) { fprintf(stderr,"ERROR: missing chasmpalette.act\n"); return 0; }
-    if (fread(palette,3,256,f) != 256) {
-        fprintf(stderr,"ERROR: bad palette size\n");
-        fclose(f);
+    Palette pal;
+    if (!palio_load(pal_file, &pal)) {
+        fprintf(stderr,"ERROR: missing or unreadable palette %s\n", pal_file);
         return 0;
     }
-    fclose(f);
+    memcpy(palette, pal.rgb, sizeof(palette));
     return 1;
 }
 
@@ -94,33 +95,22 @@ static int do_export(const char *obj_path) {
         uint8_t *raw=malloc(np);
         fread(raw,1,np,f);
 
-        uint8_t *rgb=malloc(np*3);
-        for(unsigned y=0;y<H;y++)for(unsigned x=0;x<w;x++){
-            size_t src=(H-1-y)+(size_t)x*H;
-            uint8_t c=raw[src];
-            size_t dst=(y*w+x)*3;
-            rgb[dst+0]=palette[c][0];
-            rgb[dst+1]=palette[c][1];
-            rgb[dst+2]=palette[c][2];
-        }
-        uint8_t *r2=malloc(np*3);
-        for(unsigned y=0;y<H;y++)for(unsigned x=0;x<w;x++){
-            size_t s=(y*w+x)*3;
-            size_t d=((H-1-y)*w+(w-1-x))*3;
-            r2[d+0]=rgb[s+0]; r2[d+1]=rgb[s+1]; r2[d+2]=rgb[s+2];
-        }
+        // OBJ frames are stored column by column
+        uint8_t *img=malloc(np);
+        for(unsigned y=0;y<H;y++)for(unsigned x=0;x<w;x++)
+            img[(H-1-y)*w+(w-1-x)]=raw[(H-1-y)+(size_t)x*H];
 
         char png[700];
         snprintf(png,sizeof(png),"%s%s%s_%u.png",
                  base,PATHSEP,base,(unsigned)i);
-        stbi_write_png(png,w,H,3,r2,w*3);
+        pngidx_write(png,img,w,H,w,palette,NULL);
         printf("Wrote %s\n",png);
 
         fprintf(mf,"%s%s%s_%u.png,%u,%u,%u\n",
                 base,PATHSEP,base,(unsigned)i,
                 w,H,(unsigned)h.x_center);
 
-        free(raw); free(rgb); free(r2);
+        free(raw); free(img);
     }
     fclose(mf);
     fclose(f);
@@ -149,24 +139,19 @@ static int do_dummy(int w,int H,int o,int frames,int pidx){
         fwrite(&hdr,sizeof(hdr),1,f);
         fwrite(buf,1,np,f);
     }
-    free(buf); fclose(f);
+    fclose(f);
     printf("Wrote blank.obj (%dx%d, origin=%d, %d frames, idx=%d)\n",
            w,H,o,frames,pidx);
 
     MKDIR("blank");
-    uint8_t *rgb=malloc(np*3);
-    for(size_t p=0;p<np;p++){
-        rgb[p*3+0]=palette[pidx][0];
-        rgb[p*3+1]=palette[pidx][1];
-        rgb[p*3+2]=palette[pidx][2];
-    }
+    memset(buf,(uint8_t)pidx,np);
     for(int i=0;i<frames;i++){
         char path[200];
         snprintf(path,sizeof(path),"blank%sblank_%d.png",PATHSEP,i);
-        stbi_write_png(path,w,H,3,rgb,w*3);
+        pngidx_write(path,buf,w,H,w,palette,NULL);
         printf("Wrote %s\n",path);
     }
-    free(rgb);
+    free(buf);
 
     FILE *mf=fopen("blank.txt","w");
     for(int i=0;i<frames;i++){
@@ -179,13 +164,14 @@ static int do_dummy(int w,int H,int o,int frames,int pidx){
 }
 
 // ---------------------------------------------------------------------------
-// -create <manifest.txt> <new.obj>
-// (unchanged)
+// -create <manifest.txt> <new.obj> [-dither <mode>]
 // ---------------------------------------------------------------------------
-static int do_create(const char *manifest,const char *outpath){
+static int do_create(const char *manifest,const char *outpath,DitherMode dither){
     if(!load_palette())return 1;
+    static PalQuant quant;
+    if(!palquant_init(&quant,palette)){fprintf(stderr,"Out of memory\n");return 1;}
     FILE *mf=fopen(manifest,"r");
-    if(!mf){perror("fopen manifest");return 1;}
+    if(!mf){perror("fopen manifest");palquant_free(&quant);return 1;}
 
     typedef struct{ char fn[512]; unsigned w,H,o; } E;
     E *ents=NULL; size_t n=0;
@@ -207,7 +193,7 @@ static int do_create(const char *manifest,const char *outpath){
     fclose(mf);
 
     FILE *out=fopen(outpath,"wb");
-    if(!out){perror("fopen new.obj");free(ents);return 1;}
+    if(!out){perror("fopen new.obj");free(ents);palquant_free(&quant);return 1;}
     uint16_t cnt=(uint16_t)n; fwrite(&cnt,2,1,out);
 
     for(size_t i=0;i<n;i++){
@@ -218,34 +204,33 @@ static int do_create(const char *manifest,const char *outpath){
 
         int iw,ih,ic;
         uint8_t *img =
-          stbi_load(ents[i].fn,&iw,&ih,&ic,3);
+          stbi_load(ents[i].fn,&iw,&ih,&ic,4);
         if(!img||iw!=(int)ents[i].w||
            ih!=(int)ents[i].H)
         {
             fprintf(stderr,"Fail load %s\n",ents[i].fn);
             if(img)stbi_image_free(img);
-            free(ents); fclose(out);
+            free(ents); fclose(out); palquant_free(&quant);
             return 1;
         }
+        // nearest palette colour (exact matches keep their first index),
+        // one dithered row at a time; OBJ frames are stored column-major
         size_t np=(size_t)iw*ih;
-        uint8_t *raw=malloc(np);
+        uint8_t *raw=malloc(np), *row=malloc(iw);
+        DitherStream ds;
+        if(!raw||!row||!dither_begin(&ds,&quant,dither,iw)){
+            fprintf(stderr,"Out of memory\n");
+            free(raw); free(row); stbi_image_free(img);
+            free(ents); fclose(out); palquant_free(&quant);
+            return 1;
+        }
         for(unsigned y=0;y<ents[i].H;y++){
-            for(unsigned x=0;x<ents[i].w;x++){
-              uint8_t r=img[(y*ents[i].w+x)*3+0],
-                      g=img[(y*ents[i].w+x)*3+1],
-                      b=img[(y*ents[i].w+x)*3+2],
-                      best=0;
-              for(int pi=0;pi<256;pi++){
-                if(palette[pi][0]==r&&
-                   palette[pi][1]==g&&
-                   palette[pi][2]==b)
-                {
-                  best=(uint8_t)pi;break;
-                }
-              }
-              raw[y+(size_t)x*ents[i].H]=best;
-            }
+            dither_row(&ds,img+(size_t)y*iw*4,row);
+            for(unsigned x=0;x<ents[i].w;x++)
+              raw[y+(size_t)x*ents[i].H]=row[x];
         }
+        dither_end(&ds);
+        free(row);
         stbi_image_free(img);
         fwrite(raw,1,np,out);
         free(raw);
@@ -253,6 +238,7 @@ static int do_create(const char *manifest,const char *outpath){
     }
     free(ents);
     fclose(out);
+    palquant_free(&quant);
     printf("Wrote new OBJ: %s (%u frames)\n",
            outpath,(unsigned)cnt);
     return 0;
@@ -306,13 +292,16 @@ static int do_manifest(const char *folder) {
 
 // ---------------------------------------------------------------------------
 int main(int argc, char **argv) {
+    pal_file = palio_option(&argc, argv, pal_file);
     if (argc < 2) {
         fprintf(stderr,
           "Usage:\n"
           "  %s -export   <sprite.obj>\n"
           "  %s -dummy    <w> <h> <origin> <frames> <palette_idx>\n"
-          "  %s -create   <manifest.txt> <new.obj>\n"
-          "  %s -manifest <folder>\n",
+          "  %s -create   <manifest.txt> <new.obj> [-dither <mode>]\n"
+          "  %s -manifest <folder>\n"
+          "Options:\n"
+          "  -palette <file>  instead of the built-in palette (" PALIO_FORMATS ")\n",
           argv[0],argv[0],argv[0],argv[0]);
         return 1;
     }
@@ -325,7 +314,15 @@ int main(int argc, char **argv) {
           atoi(argv[6])
         );
     if (!strcmp(argv[1],"-create") && argc==4)
-        return do_create(argv[2],argv[3]);
+        return do_create(argv[2],argv[3],DITHER_NONE);
+    if (!strcmp(argv[1],"-create") && argc==6 && !strcmp(argv[4],"-dither")) {
+        int mode = dither_parse(argv[5]);
+        if (mode < 0) {
+            fprintf(stderr,"Unknown dither mode %s (none, fs, sierra, bayer4, bayer8, noise, atkinson)\n",argv[5]);
+            return 1;
+        }
+        return do_create(argv[2],argv[3],(DitherMode)mode);
+    }
     if (!strcmp(argv[1],"-manifest") && argc==3)
         return do_manifest(argv[2]);
 
@@ -1,16 +1,19 @@
-// x86_64-w64-mingw32-gcc objviewer100.c   -o objviewer.exe   -Iinclude   -Llib   -lfreeglut   -lopengl32   -lglu32   -lwinmm objviewer.res
+// x86_64-w64-mingw32-gcc objviewer100.c ../paltex/paltex.c ../palio/palio.c ../chasmpal/chasmpal.c   -o objviewer.exe   -Iinclude -I../../include   -Llib   -lfreeglut   -lglew32   -lopengl32   -lglu32   -lwinmm objviewer.res
 
 #ifdef _WIN32
   #define WIN32_LEAN_AND_MEAN
   #include <windows.h>
 #endif
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include "paltex.h"
+#include "palio.h"
 
 #pragma pack(push,1)
 // Frame header in Chasm OBJ sprite
@@ -25,7 +28,7 @@ typedef struct {
 static uint8_t      palette[256][3];
 static uint8_t     *frame_data    = NULL;
 static FrameHeader *headers       = NULL;
-static GLuint      *textures      = NULL;
+static PalTex      *textures      = NULL;   // index maps, palette on the GPU
 static unsigned     frame_count   = 0;
 static unsigned     max_h         = 0;
 static unsigned     current_frame = 0;
@@ -41,11 +44,11 @@ int window_height = 600;
 const int MIN_WIN_W = 200;
 const int MIN_WIN_H = 150;
 
-int load_palette(void) {
-    FILE *f = fopen("chasmpalette.act", "rb");
-    if (!f) return 0;
-    if (fread(palette,3,256,f) != 256) { fclose(f); return 0; }
-    fclose(f);
+// built-in palette unless a -palette file is given
+int load_palette(const char *path) {
+    Palette pal;
+    if (!palio_load(path, &pal)) return 0;
+    memcpy(palette, pal.rgb, sizeof(palette));
     return 1;
 }
 
@@ -75,11 +78,17 @@ int load_objsprite(const char *path) {
     return 1;
 }
 
-void create_textures(void) {
-    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-    if(textures){ glDeleteTextures(frame_count,textures); free(textures); }
-    textures = malloc(sizeof(GLuint)*frame_count);
-    glGenTextures(frame_count, textures);
+// palette + mask; the frame textures are never rebuilt
+void upload_palette(void) {
+    uint8_t alpha[256];
+    for(int c=0;c<256;c++) alpha[c]=(mask_transparent && c==255)?0:255;
+    paltex_palette(palette,alpha);
+}
+
+int create_textures(void) {
+    upload_palette();
+    textures = calloc(frame_count,sizeof(PalTex));
+    if(!textures) return 0;
     size_t off=0;
     for(unsigned i=0;i<frame_count;i++){
         unsigned w=headers[i].size_x, h=headers[i].size_y;
@@ -88,37 +97,12 @@ void create_textures(void) {
         uint8_t *idx = malloc(sz);
         for(unsigned y=0;y<h;y++) for(unsigned x=0;x<w;x++)
             idx[y*w+x] = src[(h-1-y) + x*h];
-        if(mask_transparent){
-            uint8_t *rgba=malloc(sz*4);
-            for(size_t p=0;p<sz;p++){
-                uint8_t c=idx[p];
-                rgba[p*4+0]=palette[c][0];
-                rgba[p*4+1]=palette[c][1];
-                rgba[p*4+2]=palette[c][2];
-                rgba[p*4+3]=(c==255?0:255);
-            }
-            glBindTexture(GL_TEXTURE_2D,textures[i]);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-            glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,w,h,0,GL_RGBA,GL_UNSIGNED_BYTE,rgba);
-            free(rgba);
-        } else {
-            uint8_t *rgb=malloc(sz*3);
-            for(size_t p=0;p<sz;p++){
-                uint8_t c=idx[p];
-                rgb[p*3+0]=palette[c][0];
-                rgb[p*3+1]=palette[c][1];
-                rgb[p*3+2]=palette[c][2];
-            }
-            glBindTexture(GL_TEXTURE_2D,textures[i]);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-            glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,w,h,0,GL_RGB,GL_UNSIGNED_BYTE,rgb);
-            free(rgb);
-        }
+        int ok = paltex_create(&textures[i],idx,w,h);
         free(idx);
+        if(!ok) return 0;
         off+=sz;
     }
+    return 1;
 }
 
 void draw_text(int x,int y,const char *s){
@@ -164,13 +148,14 @@ void display(void){
     float px=window_width*0.5f - pivot*zoom;
     float py=baseline;
     glColor3f(1,1,1);
-    glBindTexture(GL_TEXTURE_2D,textures[i]);
+    paltex_bind(&textures[i]);
     glBegin(GL_QUADS);
       glTexCoord2f(0,0); glVertex2f(px,   py);
       glTexCoord2f(1,0); glVertex2f(px+w, py);
       glTexCoord2f(1,1); glVertex2f(px+w, py+h);
       glTexCoord2f(0,1); glVertex2f(px,   py+h);
     glEnd();
+    paltex_unbind();
 
     // Thumbnails
     int total_w=0;
@@ -188,13 +173,14 @@ void display(void){
             glEnd();
             glColor3f(1,1,1);
         }
-        glBindTexture(GL_TEXTURE_2D,textures[j]);
+        paltex_bind(&textures[j]);
         glBegin(GL_QUADS);
           glTexCoord2f(0,0); glVertex2f(x,   y);
           glTexCoord2f(1,0); glVertex2f(x+tw,y);
           glTexCoord2f(1,1); glVertex2f(x+tw,y+th);
           glTexCoord2f(0,1); glVertex2f(x,   y+th);
         glEnd();
+        paltex_unbind();
         x+=tw;
     }
 
@@ -224,7 +210,7 @@ void keyboard(unsigned char key,int x,int y){
       case '+': zoom*=1.1f; break;
       case '-': zoom=(zoom>1?zoom/1.1f:1.0f); break;
       case ' ': playing=!playing; break;
-      case 127: mask_transparent=!mask_transparent; create_textures(); break;
+      case 127: mask_transparent=!mask_transparent; upload_palette(); break;
       case 27:  // ESC
         zoom = 1.0f;
         playing = true;
@@ -232,7 +218,7 @@ void keyboard(unsigned char key,int x,int y){
         fps = default_fps;
         current_frame = 0;
         mask_transparent = false;
-        create_textures();
+        upload_palette();
         break;
     }
 }
@@ -249,14 +235,16 @@ void special(int key,int x,int y){
 }
 
 int main(int argc,char**argv){
-    if(argc<2||argc>3){ fprintf(stderr,"Usage: %s <sprite.obj> [fps]\n",argv[0]); return 1; }
+    const char *pal_file=palio_option(&argc,argv,NULL);
+    if(argc<2||argc>3){ fprintf(stderr,"Usage: %s <sprite.obj> [fps] [-palette <file>]\n",argv[0]); return 1; }
     if(argc==3) fps=default_fps=atoi(argv[2]);
-    if(!load_palette()||!load_objsprite(argv[1])) return 2;
+    if(!load_palette(pal_file)||!load_objsprite(argv[1])) return 2;
     glutInit(&argc,argv); glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGB);
     glutInitWindowSize(window_width,window_height);
     glutCreateWindow("Chasm The Rift OBJ Viewer V1.0 by SMR9000");
     glClearColor(0,0,0,1);
-    create_textures();
+    if(glewInit()==GLEW_OK) paltex_init();
+    if(!create_textures()){ fprintf(stderr,"Out of memory\n"); return 2; }
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutTimerFunc(1000/fps,timer,0);
@@ -1,7 +1,8 @@
 // --------------------------------------------------
 // Verion 1.0.1 (105)
 // --------------------------------------------------
-// Reads a 768-byte .PAL and emits into ./ChasmPalette/:
+// Reads a palette (768-byte .PAL, or any format palio detects) and emits
+// into ./ChasmPalette/:
 //   • Photoshop_<base>_transparent.act   (scaled 6→8-bit if needed)
 //   • Photoshop_<base>_pink.act          (index 255 = #FC00C8)
 //   • Quake_<base>.lmp                   (raw 768-byte pink palette)
@@ -15,212 +16,222 @@
 //   • ACO_<base>.aco                     (Adobe Color Swatch v1, pink palette)
 //   • Code_<base>.h                      (C header with pink palette array)
 //   • Cube_<base>.cube                   (3D LUT size 16 mapping original palette)
+// Every export is built in memory and written with a single unbuffered
+// fwrite, so each output file costs one open, one write and one close.
 // Usage:
-//   x86_64-w64-mingw32-gcc -std=c99 -O2 -o pal2all.exe pal2all105.c
+//   x86_64-w64-mingw32-gcc -std=c99 -O2 -o pal2all.exe pal2all105.c ../workpool/workpool.c ../pngidx/pngidx.c ../palio/palio.c ../chasmpal/chasmpal.c ../filelist/filelist.c -I../../include
 //   ./pal2all.exe input.pal
+//   ./pal2all.exe -batch <dir|list.txt|palette> [...] [-threads N]
 // --------------------------------------------------
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 #include <ctype.h>
+#include <sys/stat.h>
+#include "workpool.h"
+#include "pngidx.h"
+#include "palio.h"
+#include "filelist.h"
 
 #ifdef _WIN32
   #include <direct.h>
   #define MKDIR(dir) _mkdir(dir)
 #else
-  #include <sys/stat.h>
   #define MKDIR(dir) mkdir(dir,0755)
 #endif
 
-// Portable big-endian converters
-static uint16_t to_be16(uint16_t v) {
-    return (uint16_t)((v << 8) | (v >> 8));
-}
-static uint32_t to_be32(uint32_t v) {
-    return ((v >> 24) & 0x000000FF) |
-           ((v >>  8) & 0x0000FF00) |
-           ((v <<  8) & 0x00FF0000) |
-           ((v << 24) & 0xFF000000);
-}
+#define OUT_DIR "ChasmPalette"
+#define ERR_LEN 600     // room for a message around a 512-byte output path
 
-// PNG / zlib helpers
-static uint32_t crc_table[256];
-static int crc_ready = 0;
-static void make_crc_table(void) {
-    for (int n = 0; n < 256; n++) {
-        uint32_t c = (uint32_t)n;
-        for (int k = 0; k < 8; k++)
-            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
-        crc_table[n] = c;
-    }
-    crc_ready = 1;
+// In-memory output file
+typedef struct {
+    uint8_t *p;
+    size_t   len, cap;
+    int      oom;
+} Buf;
+
+static void buf_reserve(Buf *b, size_t n) {
+    if (b->len + n <= b->cap) return;
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < b->len + n) cap *= 2;
+    uint8_t *p = realloc(b->p, cap);
+    if (!p) { b->oom = 1; return; }
+    b->p = p;
+    b->cap = cap;
 }
-static uint32_t update_crc(uint32_t crc, const uint8_t *buf, size_t len) {
-    if (!crc_ready) make_crc_table();
-    crc ^= 0xFFFFFFFFu;
-    for (size_t i = 0; i < len; i++)
-        crc = crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
-    return crc ^ 0xFFFFFFFFu;
+static void buf_put(Buf *b, const void *data, size_t n) {
+    buf_reserve(b, n);
+    if (b->oom) return;
+    memcpy(b->p + b->len, data, n);
+    b->len += n;
 }
-static uint32_t adler32(const uint8_t *data, size_t len) {
-    const uint32_t MOD = 65521;
-    uint32_t s1 = 1, s2 = 0;
-    for (size_t i = 0; i < len; i++) {
-        s1 = (s1 + data[i]) % MOD;
-        s2 = (s2 + s1)      % MOD;
-    }
-    return (s2 << 16) | s1;
+static void buf_printf(Buf *b, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    char line[256];
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n < sizeof(line)) { buf_put(b, line, n); return; }
+    buf_reserve(b, (size_t)n + 1);
+    if (b->oom) return;
+    va_start(ap, fmt);
+    vsnprintf((char*)b->p + b->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    b->len += n;
 }
-static void w32(FILE *f, uint32_t v) {
-    fputc((v >> 24) & 0xFF, f);
-    fputc((v >> 16) & 0xFF, f);
-    fputc((v >>  8) & 0xFF, f);
-    fputc((v      ) & 0xFF, f);
+
+// Big-endian stores
+static void buf_be16(Buf *b, uint16_t v) {
+    uint8_t d[2] = { (uint8_t)(v >> 8), (uint8_t)v };
+    buf_put(b, d, 2);
 }
-static void write_png_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t len) {
-    w32(f, len);
-    fwrite(type, 1, 4, f);
-    if (len) fwrite(data, 1, len, f);
-    uint8_t *buf = malloc(4 + len);
-    memcpy(buf, type, 4);
-    if (len) memcpy(buf + 4, data, len);
-    uint32_t crc = update_crc(0, buf, 4 + len);
-    free(buf);
-    w32(f, crc);
+static void buf_be32(Buf *b, uint32_t v) {
+    uint8_t d[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+    buf_put(b, d, 4);
 }
 
-// Write a 16×16 indexed PNG
-static void write_png(const char *fn, uint8_t pal[256][3]) {
-    const int W = 16, H = 16;
-    size_t raw_len = H * (1 + W);
-    uint8_t *raw = malloc(raw_len);
-    for (int y = 0; y < H; y++) {
-        raw[y*(W+1) + 0] = 0;
-        for (int x = 0; x < W; x++)
-            raw[y*(W+1) + 1 + x] = (uint8_t)(y*W + x);
+// Writes b to OUT_DIR/<prefix><base><suffix> and empties it for the next
+// export.  text selects "w" so line endings stay native, as before.  Once
+// an earlier export failed (ok == 0) b is only emptied.
+static int buf_save(Buf *b, int ok, const char *prefix, const char *base,
+                    const char *suffix, int text, char *err, size_t errlen) {
+    char fn[512];
+    snprintf(fn, sizeof(fn), OUT_DIR "/%s%s%s", prefix, base, suffix);
+    if (ok && b->oom) {
+        ok = 0;
+        snprintf(err, errlen, "out of memory building %s", fn);
+    } else if (ok) {
+        FILE *f = fopen(fn, text ? "w" : "wb");
+        if (!f) {
+            ok = 0;
+            snprintf(err, errlen, "cannot create %s", fn);
+        } else {
+            setvbuf(f, NULL, _IONBF, 0);
+            ok = fwrite(b->p, 1, b->len, f) == b->len;
+            if (fclose(f) != 0) ok = 0;
+            if (!ok) snprintf(err, errlen, "failed writing %s", fn);
+        }
     }
-    uint8_t zhdr[2] = {0x78, 0x01};
-    uint16_t blen = (uint16_t)raw_len;
-    uint8_t dhdr[5] = {
-        0x01,
-        (uint8_t)( blen        &0xFF),
-        (uint8_t)((blen >> 8) &0xFF),
-        (uint8_t)(~blen        &0xFF),
-        (uint8_t)((~blen >> 8)&0xFF)
-    };
-    uint32_t adl = adler32(raw, raw_len);
-    size_t idat_len = 2 + 5 + raw_len + 4;
-    uint8_t *idat = malloc(idat_len);
-    size_t off = 0;
-    memcpy(idat+off, zhdr, 2); off += 2;
-    memcpy(idat+off, dhdr, 5); off += 5;
-    memcpy(idat+off, raw, raw_len); off += raw_len;
-    idat[off++] = (adl >> 24) & 0xFF;
-    idat[off++] = (adl >> 16) & 0xFF;
-    idat[off++] = (adl >>  8) & 0xFF;
-    idat[off++] =  adl        & 0xFF;
-
-    FILE *f = fopen(fn, "wb");
-    if (!f) { perror("PNG fopen"); exit(1); }
-    const uint8_t sig[8] = {137,80,78,71,13,10,26,10};
-    fwrite(sig, 1, 8, f);
-    uint8_t ihdr[13] = {0,0,0,W, 0,0,0,H, 8,3,0,0,0};
-    write_png_chunk(f, "IHDR", ihdr, 13);
-    write_png_chunk(f, "PLTE", &pal[0][0], 256*3);
-    write_png_chunk(f, "IDAT", idat, (uint32_t)idat_len);
-    write_png_chunk(f, "IEND", NULL, 0);
-    fclose(f);
-    free(raw);
-    free(idat);
+    b->len = 0;
+    b->oom = 0;
+    return ok;
 }
 
-// Write grid TXT
-static void write_txt_grid(const char *fn, uint8_t pal[256][3]) {
-    FILE *f = fopen(fn, "w");
-    if (!f) { perror("txt"); exit(1); }
-    fprintf(f,
+// 16×16 indexed PNG, one entry per pixel
+static void put_png(Buf *b, uint8_t pal[256][3]) {
+    uint8_t idx[256];
+    for (int i = 0; i < 256; i++) idx[i] = (uint8_t)i;
+    size_t len;
+    uint8_t *png = pngidx_encode(idx, 16, 16, 16, pal, NULL, &len);
+    if (!png) { b->oom = 1; return; }
+    buf_put(b, png, len);
+    free(png);
+}
+
+// Grid TXT
+static void put_txt_grid(Buf *b, uint8_t pal[256][3]) {
+    buf_printf(b,
         "ROWS 16\nCOLS 16\nWIDTH 16\nHEIGHT 16\n"
         "TEXTHEIGHT 0\nSPACING 1\n");
-    for (int i = 0; i < 256; i++) {
-        fprintf(f,
-            "R: %03d, G: %03d, B: %03d\n",
-            pal[i][0], pal[i][1], pal[i][2]);
-    }
-    fclose(f);
+    for (int i = 0; i < 256; i++)
+        buf_printf(b, "R: %03d, G: %03d, B: %03d\n", pal[i][0], pal[i][1], pal[i][2]);
 }
 
-// Write raw hex TXT
-static void write_raw_hex(const char *fn3, const char *fn4, uint8_t pal[256][3]) {
-    FILE *f3 = fopen(fn3, "w");
-    FILE *f4 = fopen(fn4, "w");
-    if (!f3||!f4) { perror("raw hex"); exit(1); }
+// Raw hex TXT, 3 or 4 bytes per entry
+static void put_raw_hex(Buf *b, uint8_t pal[256][3], int with_alpha) {
     for (int i = 0; i < 256; i++) {
-        fprintf(f3, "0x%02X%02X%02X\n",   pal[i][0], pal[i][1], pal[i][2]);
-        fprintf(f4, "0x%02X%02X%02X%02X\n", pal[i][0], pal[i][1], pal[i][2], 0xFF);
+        if (with_alpha)
+            buf_printf(b, "0x%02X%02X%02X%02X\n", pal[i][0], pal[i][1], pal[i][2], 0xFF);
+        else
+            buf_printf(b, "0x%02X%02X%02X\n", pal[i][0], pal[i][1], pal[i][2]);
     }
-    fclose(f3); fclose(f4);
 }
 
-// Corrected ACO writer (v1 only)
-static void write_aco(const char *fn, uint8_t pal[256][3]) {
-    FILE *f = fopen(fn, "wb");
-    if (!f) { perror("aco fopen"); exit(1); }
-    uint16_t ver = to_be16(1), count = to_be16(256);
-    fwrite(&ver,2,1,f);
-    fwrite(&count,2,1,f);
+// ACO (v1 only)
+static void put_aco(Buf *b, uint8_t pal[256][3]) {
+    buf_be16(b, 1);
+    buf_be16(b, 256);
     for (int i = 0; i < 256; i++) {
-        uint16_t space = to_be16(0);
-        uint16_t r     = to_be16(pal[i][0]*257);
-        uint16_t g     = to_be16(pal[i][1]*257);
-        uint16_t b     = to_be16(pal[i][2]*257);
-        uint16_t pad   = to_be16(0);
-        fwrite(&space,2,1,f);
-        fwrite(&r,    2,1,f);
-        fwrite(&g,    2,1,f);
-        fwrite(&b,    2,1,f);
-        fwrite(&pad,  2,1,f);
+        buf_be16(b, 0);                 // RGB colour space
+        buf_be16(b, pal[i][0]*257);
+        buf_be16(b, pal[i][1]*257);
+        buf_be16(b, pal[i][2]*257);
+        buf_be16(b, 0);
     }
-    fclose(f);
 }
 
-// Corrected ASE writer
-static void write_ase(const char *fn, uint8_t pal[256][3]) {
-    FILE *f = fopen(fn, "wb");
-    if (!f) { perror("ase fopen"); exit(1); }
-    fwrite("ASEF",1,4,f);
-    uint16_t major = to_be16(1), minor = to_be16(0);
-    fwrite(&major,2,1,f);
-    fwrite(&minor,2,1,f);
-    uint32_t nblocks = to_be32(256);
-    fwrite(&nblocks,4,1,f);
+// ASE
+static void put_ase(Buf *b, uint8_t pal[256][3]) {
+    buf_put(b, "ASEF", 4);
+    buf_be16(b, 1);
+    buf_be16(b, 0);
+    buf_be32(b, 256);
     for (int i = 0; i < 256; i++) {
-        uint16_t type = to_be16(1);
         char name[16];
         snprintf(name,sizeof(name),"Color%03d",i);
         uint16_t namelen = (uint16_t)(strlen(name)+1);
-        uint16_t nl_be   = to_be16(namelen);
-        uint32_t dlen    = 2 + namelen*2 + 4 + 12 + 2;
-        uint32_t dlen_be = to_be32(dlen);
-        fwrite(&type,2,1,f);
-        fwrite(&dlen_be,4,1,f);
-        fwrite(&nl_be,2,1,f);
-        for(int j=0;j<namelen;j++){
-            uint16_t uc = to_be16(j<(int)strlen(name)?name[j]:0);
-            fwrite(&uc,2,1,f);
-        }
-        fwrite("RGB ",1,4,f);
+        buf_be16(b, 1);                 // colour entry
+        buf_be32(b, 2 + namelen*2 + 4 + 12 + 2);
+        buf_be16(b, namelen);
+        for(int j=0;j<namelen;j++)
+            buf_be16(b, (uint16_t)name[j]);     // includes the terminating 0
+        buf_put(b, "RGB ", 4);
         for(int c=0;c<3;c++){
             float fv = pal[i][c]/255.0f;
             uint32_t bits; memcpy(&bits,&fv,4);
-            bits = to_be32(bits);
-            fwrite(&bits,4,1,f);
+            buf_be32(b, bits);
         }
-        uint16_t ct = to_be16(0);
-        fwrite(&ct,2,1,f);
+        buf_be16(b, 0);                 // global colour type
+    }
+}
+
+// C header
+static void put_header(Buf *b, const char *base, uint8_t pal[256][3]) {
+    char guard[300];
+    snprintf(guard,sizeof(guard),"%s_PALETTE_H",base);
+    for(char *p=guard; *p; ++p) *p = isalpha((unsigned char)*p)? toupper((unsigned char)*p): '_';
+    buf_printf(b,
+        "#ifndef %s\n#define %s\n\n#include <stdint.h>\n\n"
+        "static const uint8_t %s_palette[256][3] = {\n",
+        guard,guard,base);
+    for(int i=0;i<256;i++)
+        buf_printf(b,"    { %3d, %3d, %3d }%s\n",
+                   pal[i][0],pal[i][1],pal[i][2], i<255?",":"");
+    buf_printf(b,"};\n\n#endif /* %s */\n",guard);
+}
+
+// 3D LUT (.cube) mapping every grid point to its nearest palette entry
+static void put_cube(Buf *b, const char *base, uint8_t pal_full[256][3]) {
+    const int N = 16;
+    double pal_f[256][3];
+    for(int i=0;i<256;i++){
+      pal_f[i][0] = pal_full[i][0]/255.0;
+      pal_f[i][1] = pal_full[i][1]/255.0;
+      pal_f[i][2] = pal_full[i][2]/255.0;
+    }
+    buf_printf(b,"TITLE \"%s\"\nLUT_3D_SIZE %d\nDOMAIN_MIN 0.0 0.0 0.0\nDOMAIN_MAX 1.0 1.0 1.0\n",base,N);
+    for(int bz=0;bz<N;bz++){
+      double bl=(double)bz/(N-1);
+      for(int gy=0;gy<N;gy++){
+        double g=(double)gy/(N-1);
+        for(int rx=0;rx<N;rx++){
+          double r=(double)rx/(N-1);
+          int best=0; double bestd=1e9;
+          for(int i=0;i<256;i++){
+            double dr=pal_f[i][0]-r, dg=pal_f[i][1]-g, db=pal_f[i][2]-bl;
+            double d=dr*dr+dg*dg+db*db;
+            if(d<bestd){ bestd=d; best=i; }
+          }
+          buf_printf(b,"%.6f %.6f %.6f\n",
+                     pal_f[best][0],pal_f[best][1],pal_f[best][2]);
+        }
+      }
     }
-    fclose(f);
 }
 
 // Utility: split basename
@@ -233,37 +244,21 @@ static void split_base(const char *path, char *out) {
     if (fn) fn++; else fn = path;
     const char *dot = strrchr(fn,'.');
     size_t len = dot ? (size_t)(dot-fn) : strlen(fn);
+    if (len > 255) len = 255;
     memcpy(out,fn,len);
     out[len] = '\0';
 }
-static void die(const char *msg) {
-    fprintf(stderr,"%s\n",msg);
-    exit(1);
-}
 
-int main(int argc, char **argv) {
-    if (argc != 2) {
-        fprintf(stderr,"Usage: %s input.pal\n", argv[0]);
-        return 1;
-    }
-    MKDIR("ChasmPalette");
+// Writes every format for one palette.  *scaled reports a 6-bit input.
+static int export_palette(const char *path, int *scaled, char *err, size_t errlen) {
     char base[256];
-    split_base(argv[1], base);
-
-    // Load palette
-    FILE *fin = fopen(argv[1],"rb");
-    if (!fin) die("opening .PAL");
-    uint8_t pal_full[256][3];
-    if (fread(pal_full,1,768,fin) != 768) die(".PAL must be 768 bytes");
-    fclose(fin);
-
-    // Detect & scale 6→8-bit
-    uint8_t mx = 0;
-    for(int i=0;i<256;i++) for(int c=0;c<3;c++)
-        if(pal_full[i][c] > mx) mx = pal_full[i][c];
-    if(mx <= 63)
-        for(int i=0;i<256;i++) for(int c=0;c<3;c++)
-            pal_full[i][c] <<= 2;
+    split_base(path, base);
+
+    // Load palette (6→8-bit scaling done by palio)
+    Palette pal;
+    if (!palio_load(path, &pal)) { snprintf(err, errlen, "not a readable palette"); return 0; }
+    uint8_t (*pal_full)[3] = pal.rgb;
+    *scaled = pal.scaled;
 
     // Pink override
     uint8_t pal_pink[256][3];
@@ -272,111 +267,198 @@ int main(int argc, char **argv) {
     pal_pink[255][1] = 0x00;
     pal_pink[255][2] = 0xC8;
 
+    Buf b = { 0 };
+    int ok = 1;
+
     // 1) Photoshop ACTs
-    char fn1[512], fn2[512];
-    snprintf(fn1,sizeof(fn1),"ChasmPalette/Photoshop_%s_transparent.act",base);
-    snprintf(fn2,sizeof(fn2),"ChasmPalette/Photoshop_%s_pink.act",       base);
-    { FILE*f=fopen(fn1,"wb"); fwrite(pal_full,1,768,f); fclose(f); }
-    { FILE*f=fopen(fn2,"wb"); fwrite(pal_pink,1,768,f); fclose(f); }
+    buf_put(&b, pal_full, 768);
+    ok = buf_save(&b, ok, "Photoshop_", base, "_transparent.act", 0, err, errlen);
+    buf_put(&b, pal_pink, 768);
+    ok = buf_save(&b, ok, "Photoshop_", base, "_pink.act", 0, err, errlen);
 
     // 2) Quake lump
-    char fn_q[512]; snprintf(fn_q,sizeof(fn_q),"ChasmPalette/Quake_%s.lmp",base);
-    { FILE*f=fopen(fn_q,"wb"); fwrite(pal_pink,1,768,f); fclose(f); }
+    buf_put(&b, pal_pink, 768);
+    ok = buf_save(&b, ok, "Quake_", base, ".lmp", 0, err, errlen);
 
     // 3) JASC-PAL
-    char fn_j[512]; snprintf(fn_j,sizeof(fn_j),"ChasmPalette/Jasc_%s.pal",base);
-    { FILE*f=fopen(fn_j,"w");
-      fprintf(f,"JASC-PAL\n0100\n256\n");
-      for(int i=0;i<256;i++)
-        fprintf(f,"%d %d %d\n",
-                pal_pink[i][0],pal_pink[i][1],pal_pink[i][2]);
-      fclose(f);
-    }
+    buf_printf(&b,"JASC-PAL\n0100\n256\n");
+    for(int i=0;i<256;i++)
+        buf_printf(&b,"%d %d %d\n", pal_pink[i][0],pal_pink[i][1],pal_pink[i][2]);
+    ok = buf_save(&b, ok, "Jasc_", base, ".pal", 1, err, errlen);
 
     // 4) GIMP GPL
-    char fn_g[512]; snprintf(fn_g,sizeof(fn_g),"ChasmPalette/Gimp_%s.gpl",base);
-    { FILE*f=fopen(fn_g,"w");
-      fprintf(f,"GIMP Palette\nName: %s\nColumns: 16\n#\n",base);
-      for(int i=0;i<256;i++)
-        fprintf(f,"%3d %3d %3d\tColor%03d\n",
-                pal_pink[i][0],pal_pink[i][1],pal_pink[i][2],i);
-      fclose(f);
-    }
+    buf_printf(&b,"GIMP Palette\nName: %s\nColumns: 16\n#\n",base);
+    for(int i=0;i<256;i++)
+        buf_printf(&b,"%3d %3d %3d\tColor%03d\n",
+                   pal_pink[i][0],pal_pink[i][1],pal_pink[i][2],i);
+    ok = buf_save(&b, ok, "Gimp_", base, ".gpl", 1, err, errlen);
 
     // 5) PNG preview
-    char fn_p[512]; snprintf(fn_p,sizeof(fn_p),"ChasmPalette/PNG_%s.png",base);
-    write_png(fn_p, pal_pink);
+    put_png(&b, pal_pink);
+    ok = buf_save(&b, ok, "PNG_", base, ".png", 0, err, errlen);
 
     // 6) Txt grid
-    char fn_t[512]; snprintf(fn_t,sizeof(fn_t),"ChasmPalette/Txt_%s.txt",base);
-    write_txt_grid(fn_t, pal_pink);
+    put_txt_grid(&b, pal_pink);
+    ok = buf_save(&b, ok, "Txt_", base, ".txt", 1, err, errlen);
 
     // 7) Raw hex
-    char fn_r3[512], fn_r4[512];
-    snprintf(fn_r3,sizeof(fn_r3),"ChasmPalette/Raw3_%s.txt",base);
-    snprintf(fn_r4,sizeof(fn_r4),"ChasmPalette/Raw4_%s.txt",base);
-    write_raw_hex(fn_r3, fn_r4, pal_pink);
+    put_raw_hex(&b, pal_pink, 0);
+    ok = buf_save(&b, ok, "Raw3_", base, ".txt", 1, err, errlen);
+    put_raw_hex(&b, pal_pink, 1);
+    ok = buf_save(&b, ok, "Raw4_", base, ".txt", 1, err, errlen);
 
     // 8) ASE
-    char fn_ase[512]; snprintf(fn_ase,sizeof(fn_ase),"ChasmPalette/ASE_%s.ase",base);
-    write_ase(fn_ase, pal_pink);
+    put_ase(&b, pal_pink);
+    ok = buf_save(&b, ok, "ASE_", base, ".ase", 0, err, errlen);
 
     // 9) ACO
-    char fn_aco[512]; snprintf(fn_aco,sizeof(fn_aco),"ChasmPalette/ACO_%s.aco",base);
-    write_aco(fn_aco, pal_pink);
+    put_aco(&b, pal_pink);
+    ok = buf_save(&b, ok, "ACO_", base, ".aco", 0, err, errlen);
 
     // 10) C header
-    char fn_c[512], guard[300];
-    snprintf(guard,sizeof(guard),"%s_PALETTE_H",base);
-    for(char *p=guard; *p; ++p) *p = isalpha(*p)? toupper(*p): '_';
-    snprintf(fn_c,sizeof(fn_c),"ChasmPalette/Code_%s.h",base);
-    { FILE*f=fopen(fn_c,"w");
-      fprintf(f,
-        "#ifndef %s\n#define %s\n\n#include <stdint.h>\n\n"
-        "static const uint8_t %s_palette[256][3] = {\n",
-        guard,guard,base);
-      for(int i=0;i<256;i++){
-        fprintf(f,"    { %3d, %3d, %3d }%s\n",
-                pal_pink[i][0],pal_pink[i][1],pal_pink[i][2],
-                i<255?",":"");
-      }
-      fprintf(f,"};\n\n#endif /* %s */\n",guard);
-      fclose(f);
-    }
+    put_header(&b, base, pal_pink);
+    ok = buf_save(&b, ok, "Code_", base, ".h", 1, err, errlen);
 
     // 11) 3D LUT (.cube)
-    const int N = 16;
-    double pal_f[256][3];
-    for(int i=0;i<256;i++){
-      pal_f[i][0] = pal_full[i][0]/255.0;
-      pal_f[i][1] = pal_full[i][1]/255.0;
-      pal_f[i][2] = pal_full[i][2]/255.0;
+    if (ok) put_cube(&b, base, pal_full);
+    ok = buf_save(&b, ok, "Cube_", base, ".cube", 1, err, errlen);
+
+    free(b.p);
+    return ok;
+}
+
+//―――― Batch mode ―――――――――――――――――――――――――
+
+typedef struct {
+    FileList *files;
+    char    (*errors)[ERR_LEN];
+    int      *ok;
+} BatchJob;
+
+// explicit arguments with these endings are palettes, anything else a list
+static int is_palette_name(const char *name) {
+    static const char *ext[] = { ".pal", ".act", ".lmp", ".gpl", ".aco", ".h", ".lut" };
+    for (size_t i = 0; i < sizeof(ext)/sizeof(ext[0]); i++)
+        if (filelist_endswith(name, ext[i])) return 1;
+    return 0;
+}
+
+// 1 if a path component of path is OUT_DIR
+static int in_out_dir(const char *path) {
+    size_t n = strlen(OUT_DIR);
+    for (const char *p = path; (p = strstr(p, OUT_DIR)); p += n) {
+        int start = p == path || p[-1] == '/' || p[-1] == '\\';
+        int end = p[n] == '/' || p[n] == '\\';
+        if (start && end) return 1;
     }
-    char fn_cube[512];
-    snprintf(fn_cube,sizeof(fn_cube),"ChasmPalette/Cube_%s.cube",base);
-    FILE *fc = fopen(fn_cube,"w");
-    if(!fc) die("creating .cube");
-    fprintf(fc,"TITLE \"%s\"\nLUT_3D_SIZE %d\nDOMAIN_MIN 0.0 0.0 0.0\nDOMAIN_MAX 1.0 1.0 1.0\n",base,N);
-    for(int bz=0;bz<N;bz++){
-      double b=(double)bz/(N-1);
-      for(int gy=0;gy<N;gy++){
-        double g=(double)gy/(N-1);
-        for(int rx=0;rx<N;rx++){
-          double r=(double)rx/(N-1);
-          int best=0; double bestd=1e9;
-          for(int i=0;i<256;i++){
-            double dr=pal_f[i][0]-r, dg=pal_f[i][1]-g, db=pal_f[i][2]-b;
-            double d=dr*dr+dg*dg+db*db;
-            if(d<bestd){ bestd=d; best=i; }
-          }
-          fprintf(fc,"%.6f %.6f %.6f\n",
-                  pal_f[best][0],pal_f[best][1],pal_f[best][2]);
+    return 0;
+}
+
+// our own output folder holds Jasc_*.pal: drop what a scan of dir found
+// in it (entries from first on, each starting with dir)
+static void skip_outputs(FileList *l, size_t first, size_t dirlen) {
+    size_t kept = first;
+    for (size_t i = first; i < l->count; i++) {
+        if (in_out_dir(l->path[i] + dirlen)) free(l->path[i]);
+        else l->path[kept++] = l->path[i];
+    }
+    l->count = kept;
+}
+
+static void batch_item(void *ctx, size_t i, int worker) {
+    BatchJob *job = ctx;
+    const char *path = job->files->path[i];
+    int scaled;
+    (void)worker;
+    if (job->ok[i] < 0) return;         // rejected as a duplicate
+    job->ok[i] = export_palette(path, &scaled, job->errors[i], sizeof(job->errors[i]));
+    if (job->ok[i]) printf("%s (6→8-bit scaled: %s)\n", path, scaled ? "yes" : "no");
+}
+
+static int run_batch(int argc, char *argv[]) {
+    FileList files = { 0 };
+    int threads = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "-threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            continue;
+        }
+        size_t first = files.count;
+        int ok, scanned = filelist_is_dir(argv[i]);
+        if (scanned)                        ok = filelist_scan_dir(&files, argv[i], ".pal");
+        else if (is_palette_name(argv[i]))  ok = filelist_add(&files, argv[i]);
+        else                                ok = filelist_read_list(&files, argv[i]);
+        if (!ok) {
+            fprintf(stderr, "Out of memory\n");
+            filelist_free(&files);
+            return EXIT_FAILURE;
+        }
+        if (scanned) skip_outputs(&files, first, strlen(argv[i]));
+    }
+    if (!files.count) {
+        fprintf(stderr, "No palettes found\n");
+        return EXIT_FAILURE;
+    }
+
+    BatchJob job = { &files, calloc(files.count, sizeof(*job.errors)), calloc(files.count, sizeof(int)) };
+    if (!job.errors || !job.ok) {
+        fprintf(stderr, "Out of memory\n");
+        free(job.errors); free(job.ok);
+        filelist_free(&files);
+        return EXIT_FAILURE;
+    }
+    // outputs are named after the base name only; two palettes sharing one
+    // would overwrite each other's files from different threads
+    for (size_t i = 1; i < files.count; i++) {
+        char bi[256], bj[256];
+        split_base(files.path[i], bi);
+        for (size_t j = 0; j < i; j++) {
+            split_base(files.path[j], bj);
+            if (strcmp(bi, bj)) continue;
+            snprintf(job.errors[i], sizeof(job.errors[i]), "same output names as %s", files.path[j]);
+            job.ok[i] = -1;
+            break;
         }
-      }
     }
-    fclose(fc);
 
-    printf("All exports written to ChasmPalette/ (6→8-bit scaled: %s)\n",
-           mx<=63?"yes":"no");
+    MKDIR(OUT_DIR);
+    int used = workpool_run(files.count, threads, batch_item, &job);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < files.count; i++) {
+        if (job.ok[i] != 1) {
+            fprintf(stderr, "Error: %s: %s\n", files.path[i], job.errors[i]);
+            failed++;
+        }
+    }
+    printf("Exported %zu of %zu palettes to " OUT_DIR "/ (%d threads)\n",
+           files.count - failed, files.count, used);
+
+    filelist_free(&files);
+    free(job.errors);
+    free(job.ok);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    int batch = argc >= 3 && !strcmp(argv[1], "-batch");
+    if (argc != 2 && !batch) {
+        fprintf(stderr,"Usage: %s input.pal\n"
+                       "       %s -batch <dir|list.txt|palette> [...] [-threads N]\n"
+                       "Palettes: " PALIO_FORMATS "\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+    if (batch) return run_batch(argc, argv);
+
+    MKDIR(OUT_DIR);
+    char err[ERR_LEN];
+    int scaled;
+    if (!export_palette(argv[1], &scaled, err, sizeof(err))) {
+        fprintf(stderr,"%s: %s\n", argv[1], err);
+        return 1;
+    }
+    printf("All exports written to " OUT_DIR "/ (6→8-bit scaled: %s)\n",
+           scaled?"yes":"no");
     return 0;
 }
@@ -1,15 +1,31 @@
 // Paledit101.cpp (v111)
-// x86_64-w64-mingw32-g++ paledit111.cpp   -I. -ISTB -Llib -lfreeglut -lopengl32 -lglu32 -lm   -static-libstdc++ -static-libgcc   -o PALEDIT2.exe paledit.res
+// x86_64-w64-mingw32-gcc -c ../paltex/paltex.c ../carfile/carfile.c ../hsl/hsl.c ../palquant/palquant.c ../workpool/workpool.c ../filelist/filelist.c -I. -I../../include
+// x86_64-w64-mingw32-g++ paledit111.cpp paltex.o carfile.o hsl.o palquant.o workpool.o filelist.o   -I. -I../../include -ISTB -Llib -lfreeglut -lglew32 -lopengl32 -lglu32 -lm   -static-libstdc++ -static-libgcc   -o PALEDIT2.exe paledit.res
+// PALEDIT2.exe [model.car | sprite.cel | FLOORS.XX ...]   assets to preview live
+// PALEDIT2.exe -batch (-to new.pal | -hsl H S L) [-threads N] <png|dir|list.txt> [...]
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "STB/stb_image_write.h"
+#define STB_IMAGE_IMPLEMENTATION
+#include "STB/stb_image.h"
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <cstdio>
 #include <cstdint>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+#include <cctype>
 #include <algorithm>
+#include <string>
+#include <vector>
+#include "paltex.h"
+#include "carfile.h"
+#include "hsl.h"
+#include "palquant.h"
+#include "workpool.h"
+#include "filelist.h"
 
 static uint8_t base_palette[256][3], disp_palette[256][3];
 static bool    selected[256], changed[256];
@@ -19,22 +35,44 @@ static float   hue_shift   = 0.0f,
                lightness   = 1.0f;
 
 static const int PREV_W = 512, PREV_H = 512, TEXT_H = 64;
-static const int WIN_W  = PREV_W, WIN_H  = PREV_H + TEXT_H;
+static const int ASSET_W = 512;   // preview panel right of the grid
+static int       WIN_W  = PREV_W;
+static const int WIN_H  = PREV_H + TEXT_H;
+
+// assets re-rendered through the edited palette; each one is an index
+// texture, so an edit costs one palette upload however many are loaded
+#define MAX_ASSETS 16
+struct Asset { char name[64]; PalTex tex; };
+static Asset assets[MAX_ASSETS];
+static int   asset_count = 0, cur_asset = 0;
+
+// right-button drag: hue across, lightness (Shift: saturation) up/down,
+// applied to the palette as it was when the drag started
+static bool    hsl_drag = false, hsl_drag_sat = false;
+static int     hsl_x0, hsl_y0;
+static uint8_t drag_base[256][3];
 
 //── Palette I/O ────────────────────────────────────────────────
 
-void load_chasm(const char *fn){
+// 768 bytes of 6-bit RGB
+static bool read_pal6(const char *fn,uint8_t pal[256][3]){
     FILE *f=fopen(fn,"rb");
-    if(!f){ perror(fn); exit(1); }
-    if(fread(base_palette,1,768,f)!=768){
+    if(!f){ perror(fn); return false; }
+    if(fread(pal,1,768,f)!=768){
         fprintf(stderr,"Error: %s is not 768 bytes\n",fn);
-        fclose(f); exit(1);
+        fclose(f); return false;
     }
     fclose(f);
+    return true;
+}
+
+static inline uint8_t expand6(uint8_t v){ return (v<<2)|(v>>4); }
+
+void load_chasm(const char *fn){
+    if(!read_pal6(fn,base_palette)) exit(1);
     for(int i=0;i<256;i++){
         for(int c=0;c<3;c++){
-            uint8_t v=base_palette[i][c];
-            disp_palette[i][c] = (v<<2)|(v>>4);
+            disp_palette[i][c] = expand6(base_palette[i][c]);
         }
         selected[i]=changed[i]=false;
     }
@@ -52,36 +90,6 @@ void save_chasm(const char *fn){
     printf("Saved %s\n",fn);
 }
 
-//── Color conversions ──────────────────────────────────────────
-
-void rgb2hsl(uint8_t r,uint8_t g,uint8_t b,float &h,float &s,float &l){
-    float fr=r/255.0f, fg=g/255.0f, fb=b/255.0f;
-    float mx=fmaxf(fmaxf(fr,fg),fb), mn=fminf(fminf(fr,fg),fb);
-    l=(mx+mn)*0.5f;
-    if(mx==mn){ h=s=0; return; }
-    float d=mx-mn;
-    s = l>0.5f ? d/(2-mx-mn) : d/(mx+mn);
-    if(mx==fr)      h=fmodf((fg-fb)/d + (fg<fb?6:0),6)*60.0f;
-    else if(mx==fg) h=((fb-fr)/d +2)*60.0f;
-    else            h=((fr-fg)/d +4)*60.0f;
-}
-
-void hsl2rgb(float h,float s,float l,uint8_t &r,uint8_t &g,uint8_t &b){
-    float c=(1-fabsf(2*l-1))*s;
-    float hp=fmodf(h,360.0f)/60.0f;
-    float x=c*(1-fabsf(fmodf(hp,2)-1));
-    float m=l-c/2, r1,g1,b1;
-    if(hp<1){ r1=c; g1=x; b1=0; }
-    else if(hp<2){ r1=x; g1=c; b1=0; }
-    else if(hp<3){ r1=0; g1=c; b1=x; }
-    else if(hp<4){ r1=0; g1=x; b1=c; }
-    else if(hp<5){ r1=x; g1=0; b1=c; }
-    else         { r1=c; g1=0; b1=x; }
-    r=(uint8_t)((r1+m)*255);
-    g=(uint8_t)((g1+m)*255);
-    b=(uint8_t)((b1+m)*255);
-}
-
 //── Helpers ────────────────────────────────────────────────────
 
 void drawText(int x,int y,const char *s){
@@ -89,26 +97,124 @@ void drawText(int x,int y,const char *s){
     while(*s) glutBitmapCharacter(GLUT_BITMAP_HELVETICA_10, *s++);
 }
 
-void apply_hsl(){
-    for(int i=0;i<256;i++){
-        if(!selected[i]) continue;
-        float h,s,l; rgb2hsl(disp_palette[i][0],disp_palette[i][1],disp_palette[i][2],h,s,l);
-        h = fmodf(h + hue_shift + 360.0f,360.0f);
-        s = std::clamp(s * saturation, 0.0f,1.0f);
-        l = std::clamp(l * lightness,  0.0f,1.0f);
-        hsl2rgb(h,s,l,
-          disp_palette[i][0],
-          disp_palette[i][1],
-          disp_palette[i][2]);
-        changed[i] = true;
+void upload_palette(){
+    if(asset_count) paltex_palette(disp_palette, NULL);
+}
+
+// selected entries of src, shifted by the current H/S/L, into disp_palette
+void apply_hsl_from(const uint8_t src[256][3]){
+    uint8_t buf[256][3];
+    int idx[256], n=0;
+    for(int i=0;i<256;i++) if(selected[i]){
+        memcpy(buf[n],src[i],3);
+        idx[n++]=i;
+    }
+    HslShift t={hue_shift,saturation,lightness};
+    hsl_apply(&t,buf[0],buf[0],n,3);
+    for(int k=0;k<n;k++){
+        memcpy(disp_palette[idx[k]],buf[k],3);
+        changed[idx[k]]=true;
     }
+}
+
+void apply_hsl(){
+    apply_hsl_from(disp_palette);
     hue_shift=0; saturation=1; lightness=1;
 }
 
+//── Preview assets ─────────────────────────────────────────────
+
+static bool endswith(const char *s,const char *suffix){
+    size_t sl=strlen(s), su=strlen(suffix);
+    if(sl<su) return false;
+    for(size_t i=0;i<su;i++)
+        if(tolower((unsigned char)s[sl-su+i])!=tolower((unsigned char)suffix[i])) return false;
+    return true;
+}
+
+// CAR: the 64 x N skin
+static bool load_car(const char *fn,PalTex *t){
+    CARFile car;
+    if(!car_open(&car,fn)){ fprintf(stderr,"%s: %s\n",fn,car.error); return false; }
+    bool ok = car.tex_height>0 && paltex_create(t,car.texture,car.tex_width,car.tex_height);
+    car_close(&car);
+    return ok;
+}
+
+// Autodesk Animator CEL: 32-byte header, 6-bit palette, pixels
+static bool load_cel(const char *fn,PalTex *t){
+    FILE *f=fopen(fn,"rb");
+    if(!f){ perror(fn); return false; }
+    uint8_t hdr[32];
+    bool ok = fread(hdr,1,32,f)==32 && (hdr[0]|hdr[1]<<8)==0x9119;
+    int w=hdr[2]|hdr[3]<<8, h=hdr[4]|hdr[5]<<8;
+    uint8_t *px = ok && w && h ? (uint8_t*)malloc((size_t)w*h) : NULL;
+    ok = px && fseek(f,32+768,SEEK_SET)==0 && fread(px,1,(size_t)w*h,f)==(size_t)w*h
+      && paltex_create(t,px,w,h);
+    if(!ok) fprintf(stderr,"%s: not a readable CEL\n",fn);
+    free(px); fclose(f);
+    return ok;
+}
+
+// FLOORS.XX: the 64 base tiles as an 8 x 8 sheet
+static bool load_floors(const char *fn,PalTex *t){
+    const int TS=64, HDR=64, TILE=64*64+32*32+16*16+8*8+64;
+    FILE *f=fopen(fn,"rb");
+    if(!f){ perror(fn); return false; }
+    uint8_t *tile=(uint8_t*)malloc(TS*TS), *sheet=(uint8_t*)malloc(8*TS*8*TS);
+    bool ok = tile && sheet;
+    for(int i=0;i<64&&ok;i++){
+        ok = fseek(f,HDR+(long)i*TILE,SEEK_SET)==0 && fread(tile,1,TS*TS,f)==(size_t)TS*TS;
+        for(int y=0;y<TS&&ok;y++)
+            memcpy(sheet+((i/8)*TS+y)*8*TS+(i%8)*TS, tile+y*TS, TS);
+    }
+    ok = ok && paltex_create(t,sheet,8*TS,8*TS);
+    if(!ok) fprintf(stderr,"%s: not a readable floor file\n",fn);
+    free(tile); free(sheet); fclose(f);
+    return ok;
+}
+
+void load_asset(const char *fn){
+    if(asset_count==MAX_ASSETS){ fprintf(stderr,"%s: only %d assets\n",fn,MAX_ASSETS); return; }
+    Asset *a=&assets[asset_count];
+    bool ok = endswith(fn,".car") ? load_car(fn,&a->tex)
+            : endswith(fn,".cel") ? load_cel(fn,&a->tex)
+            :                       load_floors(fn,&a->tex);
+    if(!ok) return;
+    const char *b=strrchr(fn,'/'), *b2=strrchr(fn,'\\');
+    if(b2 && (!b || b2>b)) b=b2;
+    snprintf(a->name,sizeof(a->name),"%s",b?b+1:fn);
+    asset_count++;
+}
+
+// current asset, fitted into the panel right of the grid
+void draw_asset(){
+    glColor3ub(24,24,24);
+    glRectf(PREV_W,0,WIN_W,PREV_H);
+    if(!asset_count) return;
+    const Asset *a=&assets[cur_asset];
+    float z=std::min((ASSET_W-16)/(float)a->tex.w,(PREV_H-16)/(float)a->tex.h);
+    if(z>=1) z=floorf(z);
+    float w=a->tex.w*z, h=a->tex.h*z;
+    float x0=PREV_W+(ASSET_W-w)*0.5f, y0=(PREV_H-h)*0.5f;
+    glColor3f(1,1,1);
+    glEnable(GL_TEXTURE_2D);
+    paltex_bind(&a->tex);
+    glBegin(GL_QUADS);
+      glTexCoord2f(0,1); glVertex2f(x0,  y0);
+      glTexCoord2f(1,1); glVertex2f(x0+w,y0);
+      glTexCoord2f(1,0); glVertex2f(x0+w,y0+h);
+      glTexCoord2f(0,0); glVertex2f(x0,  y0+h);
+    glEnd();
+    paltex_unbind();
+    glDisable(GL_TEXTURE_2D);
+}
+
 //── GLUT callbacks ─────────────────────────────────────────────
 
 void display(){
     glClear(GL_COLOR_BUFFER_BIT);
+    if(asset_count) draw_asset();
 
     const float gap=1.0f;
     const float cw=(PREV_W - 15*gap)/16.0f;
@@ -163,6 +269,14 @@ void display(){
     drawText(10, y0-14, "Q/A Hue+/-   W/S Saturation+/-   E/D Lightness+/-");
     drawText(10, y0-28, "R Reload All   T Reset Selected   F5 Select All   F6 Deselect All");
     drawText(10, y0-42, "F12 Save   Esc Quit");
+    if(asset_count){
+        const Asset *a=&assets[cur_asset];
+        char info[128];
+        snprintf(info,sizeof(info),"%d/%d %s (%dx%d)",cur_asset+1,asset_count,a->name,a->tex.w,a->tex.h);
+        drawText(PREV_W+10, y0,    info);
+        drawText(PREV_W+10, y0-14, "PgUp/PgDn Asset");
+        drawText(PREV_W+10, y0-28, "Right-drag Hue/Lightness   Shift+Right-drag Hue/Saturation");
+    }
 
     glutSwapBuffers();
 }
@@ -196,6 +310,7 @@ void keyboard(unsigned char k,int,int){
         break;
       case 27: exit(0);
     }
+    upload_palette();
     glutPostRedisplay();
 }
 
@@ -206,6 +321,12 @@ void special(int key,int,int){
     else if(key==GLUT_KEY_F6){
         for(int i=0;i<256;i++) selected[i]=false;
     }
+    else if(key==GLUT_KEY_PAGE_UP && asset_count){
+        cur_asset=(cur_asset+1)%asset_count;
+    }
+    else if(key==GLUT_KEY_PAGE_DOWN && asset_count){
+        cur_asset=(cur_asset+asset_count-1)%asset_count;
+    }
     else if(key==GLUT_KEY_F12){
         save_chasm("CHASM2_OUT.pal");
         static uint8_t img[256*3];
@@ -225,6 +346,19 @@ static int  drag0=0;
 static bool dragModeSelect=true;
 
 void mouse(int b,int s,int x,int y){
+    if(b==GLUT_RIGHT_BUTTON){
+        if(s==GLUT_DOWN){
+            memcpy(drag_base,disp_palette,sizeof(drag_base));
+            hsl_drag=true;
+            hsl_drag_sat=glutGetModifiers()&GLUT_ACTIVE_SHIFT;
+            hsl_x0=x; hsl_y0=y;
+        } else {
+            hsl_drag=false;
+            hue_shift=0; saturation=1; lightness=1;
+            glutPostRedisplay();
+        }
+        return;
+    }
     if(b!=GLUT_LEFT_BUTTON) return;
     int yy=WIN_H - y;
     const float gap=1, cw=(PREV_W-15*gap)/16, ch=(PREV_H-15*gap)/16;
@@ -239,6 +373,15 @@ void mouse(int b,int s,int x,int y){
 }
 
 void motion(int x,int y){
+    if(hsl_drag){
+        hue_shift=(x-hsl_x0)*0.5f;
+        float v=std::max(0.0f,1.0f+(hsl_y0-y)*0.005f);
+        if(hsl_drag_sat) saturation=v; else lightness=v;
+        apply_hsl_from(drag_base);
+        upload_palette();
+        glutPostRedisplay();
+        return;
+    }
     if(!dragging) return;
     int yy=WIN_H - y;
     const float gap=1, cw=(PREV_W-15*gap)/16, ch=(PREV_H-15*gap)/16;
@@ -256,14 +399,128 @@ void motion(int x,int y){
     glutPostRedisplay();
 }
 
+//── Batch recolouring ──────────────────────────────────────────
+//
+// -to:  each pixel is matched to its nearest CHASM2.PAL entry and takes
+//       that entry's colour from new.pal (e.g. CHASM2_OUT.pal saved by F12)
+// -hsl: the shift is applied to the pixels directly
+// Writes <name>.remap.png next to each input; transparent pixels are kept.
+
+struct BatchJob {
+    std::vector<std::string> files, errors;
+    PalQuant quant;            // CHASM2.PAL, prepared so threads can share it
+    uint8_t  to[256][3];
+    bool     use_hsl;
+    HslShift shift;
+};
+
+static bool is_input(const char *name){
+    return endswith(name,".png") && !endswith(name,".remap.png");
+}
+
+static void batch_item(void *ctx,size_t i,int){
+    BatchJob *job=(BatchJob*)ctx;
+    const std::string &in=job->files[i];
+    int w,h,ch;
+    uint8_t *img=stbi_load(in.c_str(),&w,&h,&ch,4);
+    if(!img){ job->errors[i]="cannot read image"; return; }
+    size_t n=(size_t)w*h;
+    if(job->use_hsl){
+        hsl_apply(&job->shift,img,img,n,4);
+    } else {
+        // runs of one colour are common in palette art: reuse the last match
+        uint32_t last=0xFFFFFFFF; const uint8_t *to=NULL;
+        for(size_t p=0;p<n;p++){
+            uint8_t *px=img+4*p;
+            if(!px[3]) continue;
+            uint32_t key=px[0]|px[1]<<8|px[2]<<16;
+            if(key!=last){
+                to=job->to[palquant_nearest(&job->quant,px[0],px[1],px[2])];
+                last=key;
+            }
+            memcpy(px,to,3);
+        }
+    }
+    std::string out=in.substr(0,in.size()-4)+".remap.png";
+    if(!stbi_write_png(out.c_str(),w,h,4,img,w*4)) job->errors[i]="failed to write PNG";
+    else printf("%s\n",out.c_str());
+    stbi_image_free(img);
+}
+
+static int run_batch(int argc,char**argv){
+    static BatchJob job;
+    const char *to=NULL;
+    int threads=0;
+    FileList inputs={};
+    for(int i=2;i<argc;i++){
+        if(!strcmp(argv[i],"-to") && i+1<argc) to=argv[++i];
+        else if(!strcmp(argv[i],"-hsl") && i+3<argc){
+            job.use_hsl=true;
+            job.shift={(float)atof(argv[i+1]),(float)atof(argv[i+2]),(float)atof(argv[i+3])};
+            i+=3;
+        }
+        else if(!strcmp(argv[i],"-threads") && i+1<argc) threads=atoi(argv[++i]);
+        else if(!filelist_add_arg(&inputs,argv[i],".png")){
+            fprintf(stderr,"Out of memory\n");
+            filelist_free(&inputs);
+            return 1;
+        }
+    }
+    // list entries and our own outputs are filtered here, so every input
+    // has the .png suffix the output name replaces
+    for(size_t i=0;i<inputs.count;i++){
+        const char *path=inputs.path[i];
+        if(is_input(path)) job.files.push_back(path);
+        else if(!endswith(path,".remap.png")) fprintf(stderr,"Skipped %s: not a .png\n",path);
+    }
+    filelist_free(&inputs);
+    if(!to==!job.use_hsl){
+        fprintf(stderr,"-batch needs either -to <new.pal> or -hsl <H> <S> <L>\n");
+        return 1;
+    }
+    if(job.files.empty()){ fprintf(stderr,"No .png files found\n"); return 1; }
+    if(to){
+        uint8_t from[256][3];
+        if(!read_pal6("CHASM2.PAL",from) || !read_pal6(to,job.to)) return 1;
+        for(int i=0;i<256;i++) for(int c=0;c<3;c++){
+            from[i][c]=expand6(from[i][c]);
+            job.to[i][c]=expand6(job.to[i][c]);
+        }
+        if(!palquant_init(&job.quant,from) || !palquant_prepare(&job.quant)){
+            fprintf(stderr,"Out of memory\n");
+            return 1;
+        }
+    }
+
+    job.errors.resize(job.files.size());
+    int used=workpool_run(job.files.size(),threads,batch_item,&job);
+    size_t failed=0;
+    for(size_t i=0;i<job.files.size();i++){
+        if(job.errors[i].empty()) continue;
+        fprintf(stderr,"Error: %s: %s\n",job.files[i].c_str(),job.errors[i].c_str());
+        failed++;
+    }
+    printf("Recoloured %zu of %zu images (%d threads, %s)\n",
+           job.files.size()-failed,job.files.size(),used,
+           job.use_hsl ? hsl_isa() : job.quant.isa);
+    return failed ? 1 : 0;
+}
+
 int main(int argc,char**argv){
+    if(argc>=2 && !strcmp(argv[1],"-batch")) return run_batch(argc,argv);
     load_chasm("CHASM2.PAL");
     glutInit(&argc,argv);
+    if(argc>1) WIN_W=PREV_W+ASSET_W;
     glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGBA);
     glutInitWindowSize(WIN_W,WIN_H);
     glutCreateWindow("Chasm The Rift CHASM2.PAL Editor v1.0.1 by SMR9000");
 
     glClearColor(0,0,0,1);
+    if(argc>1){
+        if(glewInit()==GLEW_OK) paltex_init();
+        paltex_palette(disp_palette, NULL);
+        for(int i=1;i<argc;i++) load_asset(argv[i]);
+    }
 
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
@@ -0,0 +1,344 @@
+// palio.c - palette loading shared by the tools (see include/palio.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "palio.h"
+#include "chasmpal.h"
+
+// 16x16 previews only; keep the decoder private to this file
+#if __has_include("stb_image.h")
+#define PALIO_IMAGES
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#define STBI_ONLY_BMP
+#define STBI_ONLY_GIF
+#include "stb_image.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+#define PALIO_MAX_FILE (4 << 20)    // no palette source is anywhere near this
+
+//―――― Detection ――――――――――――――――――――――――――――
+
+static unsigned be16(const uint8_t *p) { return (unsigned)p[0] << 8 | p[1]; }
+
+static int starts(const uint8_t *d, size_t len, const char *magic) {
+    size_t n = strlen(magic);
+    return len >= n && !memcmp(d, magic, n);
+}
+
+PalioFormat palio_detect(const void *data, size_t len) {
+    const uint8_t *d = data;
+    if (len >= 8 + 768 && starts(d, len, "CLUT")) return PALIO_CLUT;
+    // binary palettes have no magic; no text or image source is this small
+    if (len == 768 || len == 772)                return PALIO_RAW;
+    if (starts(d, len, "\x89PNG") || starts(d, len, "GIF8") || starts(d, len, "BM"))
+        return PALIO_IMAGE;
+    if (starts(d, len, "JASC-PAL"))              return PALIO_JASC;
+    if (starts(d, len, "GIMP Palette"))          return PALIO_GPL;
+    if (starts(d, len, "ROWS"))                  return PALIO_TXTGRID;
+    if (len >= 4 + 256*10 && be16(d) == 1 && be16(d + 2) >= 256 && len >= 4 + be16(d + 2)*10u)
+        return PALIO_ACO;
+
+    size_t i = 0;
+    while (i < len && isspace(d[i])) i++;
+    if (i + 2 < len && d[i] == '0' && (d[i+1] == 'x' || d[i+1] == 'X')) {
+        size_t n = 0;
+        for (i += 2; i < len && isxdigit(d[i]); i++) n++;
+        if (n == 6) return PALIO_RAW3;
+        if (n == 8) return PALIO_RAW4;
+        return PALIO_UNKNOWN;
+    }
+    if (memchr(d, '{', len))                     return PALIO_CHEADER;
+    return PALIO_UNKNOWN;
+}
+
+const char *palio_format_name(PalioFormat f) {
+    switch (f) {
+    case PALIO_RAW:     return "binary";
+    case PALIO_JASC:    return "JASC-PAL";
+    case PALIO_GPL:     return "GIMP";
+    case PALIO_TXTGRID: return "Txt grid";
+    case PALIO_RAW3:    return "Raw3 hex";
+    case PALIO_RAW4:    return "Raw4 hex";
+    case PALIO_ACO:     return "ACO";
+    case PALIO_CHEADER: return "C header";
+    case PALIO_IMAGE:   return "16x16 image";
+    case PALIO_CLUT:    return "cubegen LUT";
+    default:            return "unknown";
+    }
+}
+
+//―――― Text parsers (NUL-terminated copy) ――――――――――――――――
+
+// cuts the next line out of *p; NULL at the end
+static char *next_line(char **p) {
+    if (!**p) return NULL;
+    char *s = *p, *e = s + strcspn(s, "\n");
+    *p = *e ? e + 1 : e;
+    *e = '\0';
+    return s;
+}
+
+// n integers separated by whitespace; returns how many were read
+static int read_ints(char **p, int *v, int n) {
+    int k = 0;
+    while (k < n) {
+        char *e;
+        long x = strtol(*p, &e, 10);
+        if (e == *p) break;
+        v[k++] = (int)x;
+        *p = e;
+    }
+    return k;
+}
+
+static void put(Palette *out, int i, int r, int g, int b) {
+    out->rgb[i][0] = (uint8_t)r;
+    out->rgb[i][1] = (uint8_t)g;
+    out->rgb[i][2] = (uint8_t)b;
+}
+
+static int parse_jasc(char *s, Palette *out) {
+    for (int i = 0; i < 3; i++) if (!next_line(&s)) return 0;
+    int v[768];
+    if (read_ints(&s, v, 768) != 768) return 0;
+    for (int i = 0; i < 256; i++) put(out, i, v[3*i], v[3*i+1], v[3*i+2]);
+    return 1;
+}
+
+// header lines ("GIMP Palette", "Name:", "Columns:", "#") are skipped;
+// every line starting with a number is an entry
+static int parse_gpl(char *s, Palette *out) {
+    int i = 0;
+    char *line;
+    while (i < 256 && (line = next_line(&s))) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (!isdigit((unsigned char)*line)) continue;
+        int v[3];
+        if (read_ints(&line, v, 3) != 3) return 0;
+        put(out, i++, v[0], v[1], v[2]);
+    }
+    return i == 256;
+}
+
+static int parse_txtgrid(char *s, Palette *out) {
+    int i = 0;
+    char *line;
+    while (i < 256 && (line = next_line(&s))) {
+        int r, g, b;
+        if (sscanf(line, "R: %d, G: %d, B: %d", &r, &g, &b) == 3) put(out, i++, r, g, b);
+    }
+    return i == 256;
+}
+
+// 0xRRGGBB or 0xRRGGBBAA (alpha ignored)
+static int parse_hex(char *s, Palette *out, int digits) {
+    int i = 0;
+    char *line;
+    while (i < 256 && (line = next_line(&s))) {
+        while (isspace((unsigned char)*line)) line++;
+        if (!*line) continue;
+        if (line[0] != '0' || (line[1] != 'x' && line[1] != 'X')) return 0;
+        char *e;
+        unsigned long v = strtoul(line + 2, &e, 16);
+        if (e - (line + 2) != digits) return 0;
+        if (digits == 8) v >>= 8;
+        put(out, i++, (int)(v >> 16) & 0xFF, (int)(v >> 8) & 0xFF, (int)v & 0xFF);
+    }
+    return i == 256;
+}
+
+// the first 768 numbers after the opening brace, decimal or 0x hex
+static int parse_cheader(char *s, Palette *out) {
+    char *p = strchr(s, '{');
+    if (!p) return 0;
+    p++;
+    int v[768], n = 0;
+    while (n < 768 && *p) {
+        while (*p && !isdigit((unsigned char)*p)) p++;
+        if (!*p) break;
+        int hex = p[0] == '0' && (p[1] == 'x' || p[1] == 'X');
+        v[n++] = (int)strtol(hex ? p + 2 : p, &p, hex ? 16 : 10);
+    }
+    if (n < 768) return 0;
+    for (int i = 0; i < 256; i++) put(out, i, v[3*i], v[3*i+1], v[3*i+2]);
+    return 1;
+}
+
+//―――― Binary parsers ――――――――――――――――――――――――――
+
+static int parse_aco(const uint8_t *d, Palette *out) {
+    // 10-byte records: colour space, then three 16-bit channels and a pad
+    for (int i = 0; i < 256; i++) {
+        const uint8_t *rec = d + 4 + i*10;
+        put(out, i, rec[2], rec[4], rec[6]);
+    }
+    return 1;
+}
+
+static int parse_image(const uint8_t *d, size_t len, Palette *out) {
+#ifndef PALIO_IMAGES
+    (void)d; (void)len; (void)out;
+    return 0;
+#else
+    int w, h, c;
+    uint8_t *img = stbi_load_from_memory(d, (int)len, &w, &h, &c, 3);
+    if (!img) return 0;
+    int ok = w == 16 && h == 16;
+    if (ok) memcpy(out->rgb, img, 768);
+    stbi_image_free(img);
+    return ok;
+#endif
+}
+
+int palio_parse(const void *data, size_t len, Palette *out) {
+    const uint8_t *d = data;
+    PalioFormat f = palio_detect(d, len);
+    int ok = 0;
+    memset(out, 0, sizeof(*out));
+
+    switch (f) {
+    case PALIO_RAW:   memcpy(out->rgb, d, 768); ok = 1; break;
+    case PALIO_CLUT:  memcpy(out->rgb, d + 8, 768); ok = 1; break;
+    case PALIO_ACO:   ok = parse_aco(d, out); break;
+    case PALIO_IMAGE: ok = parse_image(d, len, out); break;
+    case PALIO_UNKNOWN: break;
+    default: {
+        char *text = malloc(len + 1);
+        if (!text) return 0;
+        memcpy(text, d, len);
+        text[len] = '\0';
+        switch (f) {
+        case PALIO_JASC:    ok = parse_jasc(text, out); break;
+        case PALIO_GPL:     ok = parse_gpl(text, out); break;
+        case PALIO_TXTGRID: ok = parse_txtgrid(text, out); break;
+        case PALIO_RAW3:    ok = parse_hex(text, out, 6); break;
+        case PALIO_RAW4:    ok = parse_hex(text, out, 8); break;
+        case PALIO_CHEADER: ok = parse_cheader(text, out); break;
+        default: break;
+        }
+        free(text);
+    }
+    }
+    if (!ok) return 0;
+    out->format = f;
+
+    // VGA 6-bit; the LUT always stores 8-bit
+    if (f != PALIO_CLUT) {
+        uint8_t mx = 0;
+        for (int i = 0; i < 256; i++)
+            for (int c = 0; c < 3; c++)
+                if (out->rgb[i][c] > mx) mx = out->rgb[i][c];
+        if (mx <= 63) {
+            for (int i = 0; i < 256; i++)
+                for (int c = 0; c < 3; c++)
+                    out->rgb[i][c] <<= 2;
+            out->scaled = 1;
+        }
+    }
+    return 1;
+}
+
+//―――― Files and the cache ―――――――――――――――――――――――――
+
+typedef struct Cached {
+    char          *path;
+    long long      size, mtime;
+    Palette        pal;
+    struct Cached *next;
+} Cached;
+
+static Cached     *cache;
+static atomic_flag cache_lock = ATOMIC_FLAG_INIT;
+
+static void lock(void)   { while (atomic_flag_test_and_set(&cache_lock)) ; }
+static void unlock(void) { atomic_flag_clear(&cache_lock); }
+
+static int load_file(const char *path, Palette *out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = len > 0 && len <= PALIO_MAX_FILE ? malloc(len) : NULL;
+    int ok = buf && fread(buf, 1, len, f) == (size_t)len && palio_parse(buf, len, out);
+    free(buf);
+    fclose(f);
+    return ok;
+}
+
+int palio_load(const char *path, Palette *out) {
+    if (!path) {
+        memcpy(out->rgb, chasmpal_rgb, sizeof(out->rgb));
+        out->format = PALIO_RAW;
+        out->scaled = 0;
+        return 1;
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+
+    lock();
+    for (Cached *c = cache; c; c = c->next) {
+        if (strcmp(c->path, path)) continue;
+        if (c->size == (long long)st.st_size && c->mtime == (long long)st.st_mtime) {
+            *out = c->pal;
+            unlock();
+            return 1;
+        }
+        break;
+    }
+    unlock();
+
+    Palette pal;
+    if (!load_file(path, &pal)) return 0;
+    *out = pal;
+
+    lock();
+    Cached *c = cache;
+    while (c && strcmp(c->path, path)) c = c->next;
+    if (!c && (c = calloc(1, sizeof(*c)))) {
+        if ((c->path = strdup(path))) {
+            c->next = cache;
+            cache = c;
+        } else {
+            free(c);
+            c = NULL;
+        }
+    }
+    if (c) {
+        c->size  = (long long)st.st_size;
+        c->mtime = (long long)st.st_mtime;
+        c->pal   = pal;
+    }
+    unlock();
+    return 1;
+}
+
+const char *palio_option(int *argc, char **argv, const char *def) {
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], "-palette")) continue;
+        if (i + 1 == *argc) {
+            fprintf(stderr, "%s: -palette needs a palette file\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+        const char *path = argv[i + 1];
+        memmove(argv + i, argv + i + 2, (size_t)(*argc - i - 2) * sizeof(char*));
+        *argc -= 2;
+        argv[*argc] = NULL;
+        return path;
+    }
+    return def;
+}
@@ -0,0 +1,230 @@
+// palquant.c - exact nearest-palette-colour lookup (see include/palquant.h)
+
+#include <stdlib.h>
+#include <string.h>
+#include "palquant.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALQUANT_X86 1
+#include <immintrin.h>
+#endif
+
+//―――― Scalar kernels ―――――――――――――――――――――――――
+
+static int search_scalar(const PalQuant *q, int r, int g, int b) {
+    int best = 0, bd = INT_MAX;
+    for (int p = 0; p < 256; p++) {
+        int dr = r - q->pal[p][0];
+        int dg = g - q->pal[p][1];
+        int db = b - q->pal[p][2];
+        int d = dr*dr + dg*dg + db*db;
+        if (d < bd) { bd = d; best = p; if (d == 0) break; }
+    }
+    return best;
+}
+
+static void box_scalar(const PalQuant *q, const int lo[3], const int hi[3],
+                       int32_t dmin[256], int32_t dmax[256]) {
+    for (int p = 0; p < 256; p++) {
+        int mn = 0, mx = 0;
+        for (int c = 0; c < 3; c++) {
+            int v = q->pal[p][c], l = lo[c], h = hi[c];
+            int near = v < l ? l - v : (v > h ? v - h : 0);
+            int far  = v - l > h - v ? v - l : h - v;
+            mn += near * near;
+            mx += far * far;
+        }
+        dmin[p] = mn; dmax[p] = mx;
+    }
+}
+
+#ifdef PALQUANT_X86
+
+//―――― SSE4.1 kernels (4 entries per register) ―――――――――――――
+
+// lowest index among lanes holding the minimum distance
+__attribute__((target("sse4.1")))
+static int reduce_sse41(__m128i bd, __m128i bi) {
+    int32_t d[4], i[4];
+    _mm_storeu_si128((__m128i*)d, bd);
+    _mm_storeu_si128((__m128i*)i, bi);
+    int best = i[0], m = d[0];
+    for (int k = 1; k < 4; k++)
+        if (d[k] < m || (d[k] == m && i[k] < best)) { m = d[k]; best = i[k]; }
+    return best;
+}
+
+__attribute__((target("sse4.1")))
+static int search_sse41(const PalQuant *q, int r, int g, int b) {
+    const __m128i qrg = _mm_set1_epi32((g << 16) | r);
+    const __m128i qb  = _mm_set1_epi32(b);
+    const __m128i four = _mm_set1_epi32(4);
+    __m128i idx = _mm_setr_epi32(0, 1, 2, 3);
+    __m128i bd  = _mm_set1_epi32(INT_MAX);
+    __m128i bi  = _mm_setzero_si128();
+    for (int p = 0; p < 256; p += 16) {
+        for (int k = 0; k < 16; k += 4) {
+            __m128i drg = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)q->rg[p+k]), qrg);
+            __m128i db  = _mm_sub_epi16(_mm_loadu_si128((const __m128i*)q->bz[p+k]), qb);
+            __m128i d   = _mm_add_epi32(_mm_madd_epi16(drg, drg), _mm_madd_epi16(db, db));
+            __m128i lt  = _mm_cmplt_epi32(d, bd);
+            bd  = _mm_blendv_epi8(bd, d, lt);
+            bi  = _mm_blendv_epi8(bi, idx, lt);
+            idx = _mm_add_epi32(idx, four);
+        }
+        // exact match: nothing later can win the tie
+        if (!_mm_testz_si128(_mm_cmpeq_epi32(bd, _mm_setzero_si128()),
+                             _mm_set1_epi32(-1))) break;
+    }
+    return reduce_sse41(bd, bi);
+}
+
+__attribute__((target("sse4.1")))
+static void box_sse41(const PalQuant *q, const int lo[3], const int hi[3],
+                      int32_t dmin[256], int32_t dmax[256]) {
+    const __m128i lrg = _mm_set1_epi32((lo[1] << 16) | lo[0]);
+    const __m128i hrg = _mm_set1_epi32((hi[1] << 16) | hi[0]);
+    const __m128i lb  = _mm_set1_epi32(lo[2]);
+    const __m128i hb  = _mm_set1_epi32(hi[2]);
+    const __m128i z   = _mm_setzero_si128();
+    for (int p = 0; p < 256; p += 4) {
+        __m128i vrg = _mm_loadu_si128((const __m128i*)q->rg[p]);
+        __m128i vb  = _mm_loadu_si128((const __m128i*)q->bz[p]);
+        __m128i arg = _mm_sub_epi16(lrg, vrg), brg = _mm_sub_epi16(vrg, hrg);
+        __m128i ab  = _mm_sub_epi16(lb, vb),   bb  = _mm_sub_epi16(vb, hb);
+        __m128i nrg = _mm_max_epi16(_mm_max_epi16(arg, brg), z);
+        __m128i nb  = _mm_max_epi16(_mm_max_epi16(ab, bb), z);
+        __m128i frg = _mm_max_epi16(_mm_sub_epi16(vrg, lrg), _mm_sub_epi16(hrg, vrg));
+        __m128i fb  = _mm_max_epi16(_mm_sub_epi16(vb, lb), _mm_sub_epi16(hb, vb));
+        _mm_storeu_si128((__m128i*)(dmin + p),
+            _mm_add_epi32(_mm_madd_epi16(nrg, nrg), _mm_madd_epi16(nb, nb)));
+        _mm_storeu_si128((__m128i*)(dmax + p),
+            _mm_add_epi32(_mm_madd_epi16(frg, frg), _mm_madd_epi16(fb, fb)));
+    }
+}
+
+//―――― AVX2 kernels (8 entries per register, 32 per step) ―――――――――
+
+__attribute__((target("avx2")))
+static int search_avx2(const PalQuant *q, int r, int g, int b) {
+    const __m256i qrg = _mm256_set1_epi32((g << 16) | r);
+    const __m256i qb  = _mm256_set1_epi32(b);
+    const __m256i eight = _mm256_set1_epi32(8);
+    __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i bd  = _mm256_set1_epi32(INT_MAX);
+    __m256i bi  = _mm256_setzero_si256();
+    for (int p = 0; p < 256; p += 32) {
+        for (int k = 0; k < 32; k += 8) {
+            __m256i drg = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)q->rg[p+k]), qrg);
+            __m256i db  = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*)q->bz[p+k]), qb);
+            __m256i d   = _mm256_add_epi32(_mm256_madd_epi16(drg, drg), _mm256_madd_epi16(db, db));
+            __m256i lt  = _mm256_cmpgt_epi32(bd, d);
+            bd  = _mm256_blendv_epi8(bd, d, lt);
+            bi  = _mm256_blendv_epi8(bi, idx, lt);
+            idx = _mm256_add_epi32(idx, eight);
+        }
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(bd, _mm256_setzero_si256()))) break;
+    }
+    // fold 8 lanes to 4, keeping the lower index on equal distance
+    __m128i dl = _mm256_castsi256_si128(bd), dh = _mm256_extracti128_si256(bd, 1);
+    __m128i il = _mm256_castsi256_si128(bi), ih = _mm256_extracti128_si256(bi, 1);
+    __m128i take = _mm_or_si128(_mm_cmplt_epi32(dh, dl),
+                                _mm_and_si128(_mm_cmpeq_epi32(dh, dl), _mm_cmplt_epi32(ih, il)));
+    return reduce_sse41(_mm_blendv_epi8(dl, dh, take), _mm_blendv_epi8(il, ih, take));
+}
+
+__attribute__((target("avx2")))
+static void box_avx2(const PalQuant *q, const int lo[3], const int hi[3],
+                     int32_t dmin[256], int32_t dmax[256]) {
+    const __m256i lrg = _mm256_set1_epi32((lo[1] << 16) | lo[0]);
+    const __m256i hrg = _mm256_set1_epi32((hi[1] << 16) | hi[0]);
+    const __m256i lb  = _mm256_set1_epi32(lo[2]);
+    const __m256i hb  = _mm256_set1_epi32(hi[2]);
+    const __m256i z   = _mm256_setzero_si256();
+    for (int p = 0; p < 256; p += 8) {
+        __m256i vrg = _mm256_loadu_si256((const __m256i*)q->rg[p]);
+        __m256i vb  = _mm256_loadu_si256((const __m256i*)q->bz[p]);
+        __m256i arg = _mm256_sub_epi16(lrg, vrg), brg = _mm256_sub_epi16(vrg, hrg);
+        __m256i ab  = _mm256_sub_epi16(lb, vb),   bb  = _mm256_sub_epi16(vb, hb);
+        __m256i nrg = _mm256_max_epi16(_mm256_max_epi16(arg, brg), z);
+        __m256i nb  = _mm256_max_epi16(_mm256_max_epi16(ab, bb), z);
+        __m256i frg = _mm256_max_epi16(_mm256_sub_epi16(vrg, lrg), _mm256_sub_epi16(hrg, vrg));
+        __m256i fb  = _mm256_max_epi16(_mm256_sub_epi16(vb, lb), _mm256_sub_epi16(hb, vb));
+        _mm256_storeu_si256((__m256i*)(dmin + p),
+            _mm256_add_epi32(_mm256_madd_epi16(nrg, nrg), _mm256_madd_epi16(nb, nb)));
+        _mm256_storeu_si256((__m256i*)(dmax + p),
+            _mm256_add_epi32(_mm256_madd_epi16(frg, frg), _mm256_madd_epi16(fb, fb)));
+    }
+}
+
+#endif // PALQUANT_X86
+
+//―――― Table ―――――――――――――――――――――――――
+
+int palquant_init(PalQuant *q, const uint8_t pal[256][3]) {
+    memset(q, 0, sizeof(*q));
+    memcpy(q->pal, pal, sizeof(q->pal));
+    for (int i = 0; i < 256; i++) {
+        q->rg[i][0] = pal[i][0]; q->rg[i][1] = pal[i][1];
+        q->bz[i][0] = pal[i][2]; q->bz[i][1] = 0;
+    }
+    // later duplicates can never win (tie -> lowest index), drop them early
+    for (int i = 0; i < 256; i++)
+        for (int j = 0; j < i; j++)
+            if (!memcmp(pal[i], pal[j], 3)) { q->dup[i] = 1; break; }
+
+    q->isa = "scalar"; q->search = search_scalar; q->box = box_scalar;
+#ifdef PALQUANT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        q->isa = "avx2"; q->search = search_avx2; q->box = box_avx2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        q->isa = "sse4.1"; q->search = search_sse41; q->box = box_sse41;
+    }
+#endif
+
+    q->cand_cap = 8 * 1024;
+    q->cand = malloc(q->cand_cap);
+    return q->cand != NULL;
+}
+
+void palquant_free(PalQuant *q) {
+    free(q->cand);
+    q->cand = NULL;
+    q->cand_len = q->cand_cap = 0;
+}
+
+int palquant_build_cell(PalQuant *q, unsigned ci) {
+    int lo[3] = { (int)(ci >> 10) << 3, (int)((ci >> 5) & 31) << 3, (int)(ci & 31) << 3 };
+    int hi[3] = { lo[0] + 7, lo[1] + 7, lo[2] + 7 };
+    int32_t dmin[256], dmax[256];
+    q->box(q, lo, hi, dmin, dmax);
+
+    // an entry is a candidate if its closest approach to the cell is no
+    // further than the best worst-case distance of any entry
+    int32_t bound = INT_MAX;
+    for (int p = 0; p < 256; p++)
+        if (dmax[p] < bound) bound = dmax[p];
+
+    if (q->cand_len + 256 > q->cand_cap) {
+        size_t cap = q->cand_cap * 2;
+        uint8_t *nc = realloc(q->cand, cap);
+        if (!nc) return 0;
+        q->cand = nc; q->cand_cap = cap;
+    }
+    uint8_t *out = q->cand + q->cand_len;
+    int n = 0;
+    for (int p = 0; p < 256; p++)
+        if (!q->dup[p] && dmin[p] <= bound) out[n++] = (uint8_t)p;
+
+    q->cell[ci].off = (uint32_t)q->cand_len;
+    q->cell[ci].n   = (uint16_t)n;
+    q->cand_len += n;
+    return 1;
+}
+
+int palquant_prepare(PalQuant *q) {
+    for (unsigned ci = 0; ci < PALQUANT_CELLS; ci++)
+        if (!q->cell[ci].n && !palquant_build_cell(q, ci)) return 0;
+    return 1;
+}
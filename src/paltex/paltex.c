@@ -0,0 +1,193 @@
+// paltex.c - palette-indexed textures (see include/paltex.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "paltex.h"
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+static const char *lookupFS =
+    "#version 110\n"
+    PALTEX_GLSL
+    "void main(){\n"
+    "    gl_FragColor = paltex(gl_TexCoord[0].st) * gl_Color;\n"
+    "}\n";
+
+static int      active;
+static GLuint   palTex, prog;
+static uint8_t  pal[256][4];
+static PalTex  *fallback;       // every live texture when !active
+
+int paltex_active(void) { return active; }
+
+static GLuint compile(GLenum type, const char *src) {
+    GLuint s = glCreateShader(type);
+    glShaderSource(s, 1, &src, NULL);
+    glCompileShader(s);
+    GLint ok = 0;
+    glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[512];
+        glGetShaderInfoLog(s, sizeof(log), NULL, log);
+        fprintf(stderr, "paltex: shader compile failed: %s\n", log);
+        glDeleteShader(s);
+        return 0;
+    }
+    return s;
+}
+
+int paltex_init(void) {
+    if (active) return 1;
+    if (!GLEW_VERSION_2_0) return 0;
+
+    GLuint fs = compile(GL_FRAGMENT_SHADER, lookupFS);
+    if (!fs) return 0;
+    prog = glCreateProgram();
+    glAttachShader(prog, fs);
+    glLinkProgram(prog);
+    glDeleteShader(fs);
+    GLint ok = 0;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(prog);
+        prog = 0;
+        return 0;
+    }
+
+    glGenTextures(1, &palTex);
+    glBindTexture(GL_TEXTURE_2D, palTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pal);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    active = 1;
+    return 1;
+}
+
+//―――― Fallback: RGBA expanded on the CPU ―――――――――――――――――
+
+static void upload_rgba(PalTex *t, int x, int y, int w, int h, int full) {
+    uint8_t *rgba = malloc((size_t)w * h * 4);
+    if (!rgba) return;
+    for (int j = 0; j < h; j++) {
+        const uint8_t *src = t->idx + (size_t)(y + j) * t->w + x;
+        uint8_t *dst = rgba + (size_t)j * w * 4;
+        for (int i = 0; i < w; i++) memcpy(dst + 4*i, pal[src[i]], 4);
+    }
+    glBindTexture(GL_TEXTURE_2D, t->tex);
+    if (full)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    free(rgba);
+}
+
+//―――― Palette and textures ――――――――――――――――――――――――
+
+void paltex_palette(const uint8_t rgb[256][3], const uint8_t *alpha) {
+    for (int i = 0; i < 256; i++) {
+        memcpy(pal[i], rgb[i], 3);
+        pal[i][3] = alpha ? alpha[i] : 255;
+    }
+    if (active) {
+        glBindTexture(GL_TEXTURE_2D, palTex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, pal);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+    for (PalTex *t = fallback; t; t = t->next)
+        upload_rgba(t, 0, 0, t->w, t->h, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+int paltex_create(PalTex *t, const uint8_t *idx, int w, int h) {
+    memset(t, 0, sizeof(*t));
+    if (w <= 0 || h <= 0) return 0;
+    t->w = w;
+    t->h = h;
+    if (!active) {
+        t->idx = malloc((size_t)w * h);
+        if (!t->idx) return 0;
+        memcpy(t->idx, idx, (size_t)w * h);
+    }
+
+    GLint align;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &t->tex);
+    glBindTexture(GL_TEXTURE_2D, t->tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    if (active) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE8, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, idx);
+    } else {
+        upload_rgba(t, 0, 0, w, h, 1);
+        t->next  = fallback;
+        fallback = t;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+    return 1;
+}
+
+void paltex_update(PalTex *t, const uint8_t *idx, int x, int y, int w, int h) {
+    if (!t->tex || x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > t->w || y + h > t->h) return;
+    GLint align;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &align);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (active) {
+        glBindTexture(GL_TEXTURE_2D, t->tex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_LUMINANCE, GL_UNSIGNED_BYTE, idx);
+    } else {
+        for (int j = 0; j < h; j++)
+            memcpy(t->idx + (size_t)(y + j) * t->w + x, idx + (size_t)j * w, w);
+        upload_rgba(t, x, y, w, h, 0);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, align);
+}
+
+void paltex_filter(PalTex *t, int linear) {
+    t->linear = linear;
+    if (active || !t->tex) return;
+    glBindTexture(GL_TEXTURE_2D, t->tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+}
+
+void paltex_free(PalTex *t) {
+    if (t->tex) glDeleteTextures(1, &t->tex);
+    for (PalTex **p = &fallback; *p; p = &(*p)->next)
+        if (*p == t) { *p = t->next; break; }
+    free(t->idx);
+    memset(t, 0, sizeof(*t));
+}
+
+//―――― Binding ――――――――――――――――――――――――――――――
+
+void paltex_bind_program(const PalTex *t, GLuint program) {
+    if (!active) {
+        glBindTexture(GL_TEXTURE_2D, t->tex);
+        return;
+    }
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, palTex);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, t->tex);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "palIndex"), 0);
+    glUniform1i(glGetUniformLocation(program, "palColors"), 1);
+    glUniform2f(glGetUniformLocation(program, "palSize"), (float)t->w, (float)t->h);
+    glUniform1f(glGetUniformLocation(program, "palLinear"), t->linear ? 1.0f : 0.0f);
+}
+
+void paltex_bind(const PalTex *t) {
+    paltex_bind_program(t, prog);
+}
+
+void paltex_unbind(void) {
+    if (active) glUseProgram(0);
+}
@@ -0,0 +1,188 @@
+// pngidx.c - 8-bit indexed PNG writer (see include/pngidx.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "pngidx.h"
+
+// only the deflate compressor is used; keep the rest private to this file
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#endif
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#define PNGIDX_LEVEL 8      // stb's default PNG compression level
+
+//―――― CRC-32, slice-by-8 ――――――――――――――――――――――――
+
+static uint32_t   crc_tab[8][256];
+static atomic_int crc_state;        // 0 = empty, 1 = building, 2 = ready
+
+static void crc_init(void) {
+    if (atomic_load(&crc_state) == 2) return;
+    int expect = 0;
+    if (!atomic_compare_exchange_strong(&crc_state, &expect, 1)) {
+        while (atomic_load(&crc_state) != 2) ;
+        return;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+        crc_tab[0][n] = c;
+    }
+    for (int t = 1; t < 8; t++)
+        for (int n = 0; n < 256; n++)
+            crc_tab[t][n] = (crc_tab[t-1][n] >> 8) ^ crc_tab[0][crc_tab[t-1][n] & 0xFF];
+    atomic_store(&crc_state, 2);
+}
+
+uint32_t pngidx_crc32(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = data;
+    crc_init();
+    crc = ~crc;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t lo = crc ^ (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+        uint32_t hi =        p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+        crc = crc_tab[7][lo & 0xFF] ^ crc_tab[6][(lo >> 8) & 0xFF] ^
+              crc_tab[5][(lo >> 16) & 0xFF] ^ crc_tab[4][lo >> 24] ^
+              crc_tab[3][hi & 0xFF] ^ crc_tab[2][(hi >> 8) & 0xFF] ^
+              crc_tab[1][(hi >> 16) & 0xFF] ^ crc_tab[0][hi >> 24];
+    }
+    while (len--) crc = crc_tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+//―――― Filtering ――――――――――――――――――――――――――――
+
+static uint8_t paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return (uint8_t)(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+}
+
+// row filtered with type ft into out[1..w]; prev is NULL on the first row
+static void filter_row(uint8_t *out, const uint8_t *row, const uint8_t *prev, int w, int ft) {
+    out[0] = (uint8_t)ft;
+    for (int x = 0; x < w; x++) {
+        int a = x ? row[x-1] : 0;
+        int b = prev ? prev[x] : 0;
+        int c = x && prev ? prev[x-1] : 0;
+        int pred = ft == 1 ? a : ft == 2 ? b : ft == 3 ? (a + b) >> 1 : ft == 4 ? paeth(a, b, c) : 0;
+        out[1 + x] = (uint8_t)(row[x] - pred);
+    }
+}
+
+static unsigned row_cost(const uint8_t *f, int w) {
+    unsigned s = 0;
+    for (int x = 1; x <= w; x++) s += abs((int8_t)f[x]);
+    return s;
+}
+
+//―――― Encoder ――――――――――――――――――――――――――――――
+
+static void put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);  p[3] = (uint8_t)v;
+}
+
+static uint8_t *chunk(uint8_t *p, const char *type, const uint8_t *data, uint32_t len) {
+    put32(p, len);
+    memcpy(p + 4, type, 4);
+    if (len) memcpy(p + 8, data, len);
+    put32(p + 8 + len, pngidx_crc32(0, p + 4, 4 + len));
+    return p + 12 + len;
+}
+
+uint8_t *pngidx_encode(const uint8_t *idx, int w, int h, int stride,
+                       const uint8_t pal[256][3], const uint8_t *alpha,
+                       size_t *len) {
+    if (w <= 0 || h <= 0 || stride < w) return NULL;
+    size_t rowlen = (size_t)w + 1, rawlen = rowlen * h;
+    if (rawlen > 0x7FFFFFFF) return NULL;   // stb's compressor takes an int
+
+    // PLTE always carries all 256 entries so editors keep the full palette;
+    // tRNS stops at the last non-opaque entry referenced
+    int used = 0, ntrns = 0;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            if (idx[(size_t)y * stride + x] >= used) used = idx[(size_t)y * stride + x] + 1;
+    if (alpha)
+        for (int i = 0; i < used; i++)
+            if (alpha[i] != 255) ntrns = i + 1;
+
+    uint8_t *plain = malloc(rawlen), *adapt = malloc(rawlen), *trial = malloc(rowlen);
+    if (!plain || !adapt || !trial) { free(plain); free(adapt); free(trial); return NULL; }
+    int any_filtered = 0;
+    for (int y = 0; y < h; y++) {
+        const uint8_t *row  = idx + (size_t)y * stride;
+        const uint8_t *prev = y ? row - stride : NULL;
+        uint8_t *out = adapt + (size_t)y * rowlen;
+        filter_row(plain + (size_t)y * rowlen, row, prev, w, 0);
+        memcpy(out, plain + (size_t)y * rowlen, rowlen);
+        unsigned best = row_cost(out, w);
+        for (int ft = 1; ft <= 4 && best; ft++) {
+            filter_row(trial, row, prev, w, ft);
+            unsigned cost = row_cost(trial, w);
+            if (cost < best) { best = cost; memcpy(out, trial, rowlen); }
+        }
+        any_filtered |= out[0];
+    }
+    free(trial);
+
+    int zlen = 0, zlen2 = 0;
+    uint8_t *z = stbi_zlib_compress(plain, (int)rawlen, &zlen, PNGIDX_LEVEL);
+    if (z && any_filtered) {
+        uint8_t *z2 = stbi_zlib_compress(adapt, (int)rawlen, &zlen2, PNGIDX_LEVEL);
+        if (z2 && zlen2 < zlen) { STBIW_FREE(z); z = z2; zlen = zlen2; }
+        else STBIW_FREE(z2);
+    }
+    free(plain);
+    free(adapt);
+    if (!z) return NULL;
+
+    size_t total = 8 + (12 + 13) + (12 + 3 * 256) + (ntrns ? 12 + ntrns : 0) + (12 + zlen) + 12;
+    uint8_t *png = malloc(total);
+    if (!png) { STBIW_FREE(z); return NULL; }
+
+    static const uint8_t sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    uint8_t ihdr[13] = { 0 };
+    put32(ihdr, (uint32_t)w);
+    put32(ihdr + 4, (uint32_t)h);
+    ihdr[8] = 8;        // bit depth
+    ihdr[9] = 3;        // indexed colour
+
+    uint8_t *p = png;
+    memcpy(p, sig, 8);
+    p = chunk(p + 8, "IHDR", ihdr, 13);
+    p = chunk(p, "PLTE", &pal[0][0], 3 * 256);
+    if (ntrns) p = chunk(p, "tRNS", alpha, ntrns);
+    p = chunk(p, "IDAT", z, (uint32_t)zlen);
+    p = chunk(p, "IEND", NULL, 0);
+    STBIW_FREE(z);
+    *len = total;
+    return png;
+}
+
+int pngidx_write(const char *fn, const uint8_t *idx, int w, int h, int stride,
+                 const uint8_t pal[256][3], const uint8_t *alpha) {
+    size_t len;
+    uint8_t *png = pngidx_encode(idx, w, h, stride, pal, alpha, &len);
+    if (!png) return 0;
+    FILE *f = fopen(fn, "wb");
+    int ok = 0;
+    if (f) {
+        setvbuf(f, NULL, _IONBF, 0);
+        ok = fwrite(png, 1, len, f) == len;
+        if (fclose(f) != 0) ok = 0;
+    }
+    free(png);
+    return ok;
+}
@@ -8,6 +8,7 @@
   #include <sys/stat.h>  // mkdir
 #endif
 
+#include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,6 +16,10 @@
 #include <stdbool.h>
 #include <string.h>
 #include <limits.h>
+#include "palquant.h"
+#include "dither.h"
+#include "paltex.h"
+#include "palio.h"
 
 // STB Image Write & Read
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -24,12 +29,14 @@
 
 // Forward declarations
 void create_textures(void);
+void upload_palette(void);
 void import_manifest(void);
 
 // Globals
 static uint8_t  palette[256][3];    // ACT palette
+static PalQuant quant;              // nearest-colour table for import
 static uint8_t *frame_data = NULL;  // raw indices
-static GLuint  *textures   = NULL;  // GL textures
+static PalTex  *textures   = NULL;  // index maps, palette on the GPU
 static unsigned frame_count   = 0;
 static unsigned width_px      = 0;
 static unsigned height_px     = 0;
@@ -39,6 +46,7 @@ static const int default_fps  = 12;
 static float    zoom          = 5.0f;
 static bool     mask_transparent = false;
 static uint8_t  bg_index      = 2; // default background index
+static DitherMode import_dither = DITHER_NONE; // F9 reimport dither
 
 // Paths
 static char spr_path[512]    = "";
@@ -58,13 +66,12 @@ static void make_dir(const char *p) {
 #endif
 }
 
-// Load ACT palette
-bool load_palette(void) {
-    FILE *f = fopen("chasmpalette.act","rb");
-    if (!f) return false;
-    if (fread(palette,3,256,f)!=256) { fclose(f); return false; }
-    fclose(f);
-    return true;
+// Built-in palette, or the -palette file
+bool load_palette(const char *path) {
+    Palette pal;
+    if (!palio_load(path, &pal)) return false;
+    memcpy(palette, pal.rgb, sizeof(palette));
+    return palquant_init(&quant, palette);
 }
 
 // Load SPR
@@ -120,20 +127,6 @@ void export_frames(void) {
     if (mf) { fclose(mf); printf("Manifest %s\n",manifest); }
 }
 
-// Nearest-palette lookup
-int find_palette_index(uint8_t r,uint8_t g,uint8_t b){
-    for (int p=0; p<256; ++p)
-        if (palette[p][0]==r && palette[p][1]==g && palette[p][2]==b)
-            return p;
-    int best=0, bestD=INT_MAX;
-    for (int p=0; p<256; ++p) {
-        int dr=(int)palette[p][0]-r, dg=(int)palette[p][1]-g, db=(int)palette[p][2]-b;
-        int d = dr*dr + dg*dg + db*db;
-        if (d < bestD) { bestD = d; best = p; }
-    }
-    return best;
-}
-
 // Import from manifest + save SPR
 void import_manifest(void){
     char manifest[512];
@@ -156,15 +149,15 @@ void import_manifest(void){
             continue;
         }
         uint8_t *dst = frame_data + i*fs;
-        for (int yy=0; yy<h; ++yy) {
-            for (int xx=0; xx<w; ++xx) {
-                int si = (yy*w + xx)*4;
-                uint8_t r=img[si], g=img[si+1], b=img[si+2];
-                int pi = find_palette_index(r,g,b);
-                int di = yy*w + xx;  // no flip here
-                dst[di] = (uint8_t)pi;
-            }
+        DitherStream ds;
+        if (!dither_begin(&ds, &quant, import_dither, w)) {
+            printf("Out of memory %s\n", imgf);
+            stbi_image_free(img);
+            continue;
         }
+        for (int yy=0; yy<h; ++yy)  // no flip here
+            dither_row(&ds, img + (size_t)yy*w*4, dst + (size_t)yy*w);
+        dither_end(&ds);
         stbi_image_free(img);
         printf("Reimported %u from %s\n", i+1, imgf);
     }
@@ -181,51 +174,30 @@ void import_manifest(void){
     glutPostRedisplay();
 }
 
-// Create GL textures from frame_data (flip vertically)
+// Upload frame_data as index maps (flipped vertically); once they exist
+// later calls replace their contents in place
 void create_textures(void){
-    glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-    if (textures) { glDeleteTextures(frame_count,textures); free(textures); }
-    textures = malloc(sizeof(GLuint)*frame_count);
-    glGenTextures(frame_count,textures);
     size_t fs = (size_t)width_px*height_px;
+    uint8_t *idx = malloc(fs);
+    if (!idx) return;
+    bool fresh = !textures;
+    if (fresh && !(textures = calloc(frame_count,sizeof(PalTex)))) { free(idx); return; }
     for (unsigned i=0; i<frame_count; ++i) {
         uint8_t *src = frame_data + i*fs;
-        uint8_t *idx = malloc(fs);
         // vertical flip for display
         for (unsigned y=0; y<height_px; ++y)
             memcpy(idx + y*width_px, src + (height_px-1-y)*width_px, width_px);
-        if (mask_transparent) {
-            uint8_t *buf = malloc(fs*4);
-            for (size_t p=0; p<fs; ++p) {
-                uint8_t c=idx[p];
-                buf[p*4+0]=palette[c][0];
-                buf[p*4+1]=palette[c][1];
-                buf[p*4+2]=palette[c][2];
-                buf[p*4+3]=(c==0?0:255);
-            }
-            glBindTexture(GL_TEXTURE_2D,textures[i]);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-            glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,width_px,height_px,0,
-                         GL_RGBA,GL_UNSIGNED_BYTE,buf);
-            free(buf);
-        } else {
-            uint8_t *buf = malloc(fs*3);
-            for (size_t p=0; p<fs; ++p) {
-                uint8_t c=idx[p];
-                buf[p*3+0]=palette[c][0];
-                buf[p*3+1]=palette[c][1];
-                buf[p*3+2]=palette[c][2];
-            }
-            glBindTexture(GL_TEXTURE_2D,textures[i]);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-            glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,width_px,height_px,0,
-                         GL_RGB,GL_UNSIGNED_BYTE,buf);
-            free(buf);
-        }
-        free(idx);
+        if (fresh) paltex_create(&textures[i],idx,width_px,height_px);
+        else       paltex_update(&textures[i],idx,0,0,width_px,height_px);
     }
+    free(idx);
+}
+
+// Palette + mask (index 0); toggling it touches no frame texture
+void upload_palette(void){
+    uint8_t alpha[256];
+    for (int c=0; c<256; ++c) alpha[c] = (mask_transparent && c==0) ? 0 : 255;
+    paltex_palette(palette,alpha);
 }
 
 // Resize
@@ -241,14 +213,14 @@ void draw_controls(void){
     const char *ctrls[]={
       "SPACE=Play/Pause","DEL=ToggleMask","PgUp=BG+","PgDn=BG-",
       "Up=FPS+","Down=FPS-","Left/Right=Prev/Next","ESC=Reset",
-      "F5=Export","F9=Reimport"
+      "F5=Export","F9=Reimport","D=ReimportDither"
     };
     float br=palette[bg_index][0]/255.0f,
           bg=palette[bg_index][1]/255.0f,
           bb=palette[bg_index][2]/255.0f;
     glColor3f(1-br,1-bg,1-bb);
     int y=window_height-15;
-    for(int i=0;i<10;++i){
+    for(int i=0;i<11;++i){
         glRasterPos2i(10,y-15*i);
         for(const char*c=ctrls[i];*c;++c)
             glutBitmapCharacter(GLUT_BITMAP_HELVETICA_12,*c);
@@ -284,7 +256,7 @@ void display(void){
     float w=width_px*zoom, h=height_px*zoom;
     float x0=(window_width-w)/2, y0=(window_height-h)/2;
     glColor3f(1,1,1);
-    glBindTexture(GL_TEXTURE_2D,textures[current_frame]);
+    paltex_bind(&textures[current_frame]);
     glBegin(GL_QUADS);
       glTexCoord2f(0,0); glVertex2f(x0,y0);
       glTexCoord2f(1,0); glVertex2f(x0+w,y0);
@@ -293,7 +265,7 @@ void display(void){
     glEnd();
     int tx=(window_width-frame_count*width_px)/2;
     for(unsigned i=0;i<frame_count;++i){
-        glBindTexture(GL_TEXTURE_2D,textures[i]);
+        paltex_bind(&textures[i]);
         glBegin(GL_QUADS);
           glTexCoord2f(0,0); glVertex2f(tx+i*width_px,0);
           glTexCoord2f(1,0); glVertex2f(tx+(i+1)*width_px,0);
@@ -301,6 +273,7 @@ void display(void){
           glTexCoord2f(0,1); glVertex2f(tx+i*width_px,height_px);
         glEnd();
     }
+    paltex_unbind();
     glColor3ub(palette[175][0],palette[175][1],palette[175][2]);
     float ax=tx+current_frame*width_px+width_px/2,
           ay=height_px+5;
@@ -309,8 +282,8 @@ void display(void){
     glEnd();
     draw_controls();
     char info[128];
-    snprintf(info,sizeof(info),"Frame %u/%u  Zoom:%.1fx  FPS:%d",
-             current_frame+1,frame_count,zoom,fps);
+    snprintf(info,sizeof(info),"Frame %u/%u  Zoom:%.1fx  FPS:%d  Dither:%s",
+             current_frame+1,frame_count,zoom,fps,dither_name(import_dither));
     draw_info(info);
     glutSwapBuffers();
 }
@@ -333,13 +306,17 @@ void keyboard(unsigned char key,int x,int y){
         break;
       case 127:
         mask_transparent=!mask_transparent;
-        create_textures(); glutPostRedisplay();
+        upload_palette(); glutPostRedisplay();
         break;
       case 27:
-        zoom=5.0f; mask_transparent=false;
+        zoom=5.0f; mask_transparent=false; upload_palette();
         bg_index=2; current_frame=0;
         fps=default_fps; glutTimerFunc(1000/fps,timer,0);
         break;
+      case 'd': case 'D':
+        import_dither=(import_dither+1)%DITHER_COUNT;
+        glutPostRedisplay();
+        break;
       case '+': zoom*=1.1f; glutPostRedisplay(); break;
       case '-': zoom/=1.1f; if(zoom<1)zoom=1; glutPostRedisplay(); break;
     }
@@ -351,9 +328,9 @@ void special(int key,int x,int y){
       case GLUT_KEY_F5: export_frames(); break;
       case GLUT_KEY_F9: import_manifest(); break;
       case GLUT_KEY_PAGE_UP:
-        bg_index=(bg_index+1)&0xFF; create_textures(); break;
+        bg_index=(bg_index+1)&0xFF; break;
       case GLUT_KEY_PAGE_DOWN:
-        bg_index=(bg_index-1)&0xFF; create_textures(); break;
+        bg_index=(bg_index-1)&0xFF; break;
       case GLUT_KEY_UP:    if(fps<30) fps++; break;
       case GLUT_KEY_DOWN:  if(fps>1) fps--; break;
       case GLUT_KEY_LEFT:
@@ -365,8 +342,9 @@ void special(int key,int x,int y){
 }
 
 int main(int argc,char **argv){
+    const char *pal_file=palio_option(&argc,argv,NULL);
     if(argc!=2){
-        fprintf(stderr,"Usage: %s <sprite.spr>\n",argv[0]);
+        fprintf(stderr,"Usage: %s <sprite.spr> [-palette <file>]\n",argv[0]);
         return 1;
     }
     // derive export_name
@@ -377,7 +355,7 @@ int main(int argc,char **argv){
     size_t ln=d?(size_t)(d-b):strlen(b);
     memcpy(export_name,b,ln); export_name[ln]='\0';
 
-    if(!load_spr(argv[1])||!load_palette()){
+    if(!load_spr(argv[1])||!load_palette(pal_file)){
         fprintf(stderr,"Load failed.\n"); return 2;
     }
     glutInit(&argc,argv);
@@ -385,6 +363,8 @@ int main(int argc,char **argv){
     glutInitWindowSize(window_width,window_height);
     glutCreateWindow("Chasm The Rift SPR Viewer v1.0.0 by SMR9000");
     reshape(window_width,window_height);
+    if(glewInit()==GLEW_OK) paltex_init();
+    upload_palette();
     create_textures();
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
@@ -0,0 +1,98 @@
+// workpool.c - minimal parallel-for (see include/workpool.h)
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "workpool.h"
+
+#ifdef _WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+#define WORKPOOL_MAX 64
+
+typedef struct {
+    WorkFn         fn;
+    void          *ctx;
+    size_t         count;
+    atomic_size_t  next;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int   id;
+} Worker;
+
+int workpool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    int n = (int)si.dwNumberOfProcessors;
+#else
+    int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n < 1 ? 1 : n;
+}
+
+static void drain(Pool *p, int id) {
+    for (;;) {
+        size_t i = atomic_fetch_add(&p->next, 1);
+        if (i >= p->count) break;
+        p->fn(p->ctx, i, id);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_main(LPVOID arg) {
+    Worker *w = arg;
+    drain(w->pool, w->id);
+    return 0;
+}
+#else
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    drain(w->pool, w->id);
+    return NULL;
+}
+#endif
+
+int workpool_run(size_t count, int threads, WorkFn fn, void *ctx) {
+    if (threads <= 0) threads = workpool_cpu_count();
+    if (threads > WORKPOOL_MAX) threads = WORKPOOL_MAX;
+    if ((size_t)threads > count) threads = count ? (int)count : 1;
+
+    Pool pool = { fn, ctx, count, 0 };
+    Worker w[WORKPOOL_MAX];
+#ifdef _WIN32
+    HANDLE th[WORKPOOL_MAX];
+#else
+    pthread_t th[WORKPOOL_MAX];
+#endif
+
+    // the calling thread is worker 0; start the rest, falling back to
+    // fewer workers if the OS refuses a thread
+    int started = 1;
+    for (int i = 1; i < threads; i++) {
+        w[i] = (Worker){ &pool, i };
+#ifdef _WIN32
+        th[i] = CreateThread(NULL, 0, worker_main, &w[i], 0, NULL);
+        if (!th[i]) break;
+#else
+        if (pthread_create(&th[i], NULL, worker_main, &w[i])) break;
+#endif
+        started++;
+    }
+    drain(&pool, 0);
+    for (int i = 1; i < started; i++) {
+#ifdef _WIN32
+        WaitForSingleObject(th[i], INFINITE);
+        CloseHandle(th[i]);
+#else
+        pthread_join(th[i], NULL);
+#endif
+    }
+    return started;
+}